@@ -0,0 +1,80 @@
+#ifndef SMPLX_ARENA_ALLOCATOR_HPP
+#define SMPLX_ARENA_ALLOCATOR_HPP
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "c10/core/Allocator.h"
+
+namespace smplx {
+// Caching CPU allocator for the temporaries of repeated forwards. Freed
+// blocks are kept in size buckets (4 per power of two, so at most 25% of
+// slack) and handed out again instead of going back to malloc, which for
+// large tensors means mmap/munmap and a page fault per touched page.
+//
+// It only serves the threads inside an ArenaGuard; tensors allocated there
+// may outlive both the guard and the arena, their blocks are then freed
+// normally. Thread-safe.
+//
+// Blocks are only handed out as DataPtrs whose context is not their data,
+// so c10's raw_allocate()/raw_deallocate() are not supported: raw_deleter()
+// is null, and raw_allocate() asserts rather than pair an arena block with
+// the system deleter.
+class ArenaAllocator final : public c10::Allocator {
+  public:
+    struct Stats {
+        int64_t hits{0};   // allocations served from the cache
+        int64_t misses{0}; // allocations that went to the system
+        size_t bytes_held{0};      // cached + in use
+        size_t bytes_in_use{0};
+        size_t peak_bytes_held{0};
+    };
+
+    // Blocks freed while more than max_bytes_held are held go back to the
+    // system instead of the cache.
+    explicit ArenaAllocator(size_t max_bytes_held = SIZE_MAX);
+    ~ArenaAllocator() override;
+    ArenaAllocator(const ArenaAllocator &) = delete;
+    auto operator=(const ArenaAllocator &) -> ArenaAllocator & = delete;
+
+    auto allocate(size_t n) -> c10::DataPtr override;
+    auto raw_deleter() const -> c10::DeleterFnPtr override { return nullptr; }
+    void copy_data(void *dest, const void *src, size_t count) const override;
+
+    auto stats() const -> Stats;
+    auto reset_stats() -> void;
+    // Frees every cached block.
+    auto release_cached() -> void;
+
+    // Bucket size of an n-byte request.
+    static auto bucket_size(size_t n) -> size_t;
+
+    // Free lists and statistics, referenced by every live block.
+    struct State;
+
+  private:
+    // Outlives the allocator while some of its blocks are alive.
+    std::shared_ptr<State> state_;
+};
+
+// Routes the CPU allocations of the current thread to arena for its scope.
+// Guards nest; a null arena makes the guard a no-op. The first guard
+// installs a process-wide CPU allocator that forwards to the previous one
+// on threads without a guard.
+//
+// That allocator keeps the raw_deleter() of the previous one, for the raw
+// allocations made outside a guard. Inside a guard, raw_allocate() on the
+// CPU allocator fails its data == context assertion (see ArenaAllocator);
+// code that needs raw CPU buffers has to run outside the guard.
+class ArenaGuard {
+  public:
+    explicit ArenaGuard(ArenaAllocator *arena);
+    ~ArenaGuard();
+    ArenaGuard(const ArenaGuard &) = delete;
+    auto operator=(const ArenaGuard &) -> ArenaGuard & = delete;
+
+  private:
+    ArenaAllocator *previous_;
+    bool active_;
+};
+} // namespace smplx
+#endif
@@ -0,0 +1,39 @@
+#ifndef SMPLX_BATCH_CHUNKING_HPP
+#define SMPLX_BATCH_CHUNKING_HPP
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace smplx {
+// Chunk sizes of SMPL::forward on large batches. The best size depends on
+// the machine (cache sizes, cores) and the model configuration, so it is
+// measured once and remembered in a small text file, one "<key> <chunk>"
+// line per configuration.
+
+// Batches from this size on trigger the autotune; smaller ones run whole.
+constexpr int64_t kAutoChunkMinBatch = 2048;
+
+// Chunk sizes tried by the autotune.
+extern const std::vector<int64_t> kChunkCandidates;
+
+// $SMPLX_CACHE_DIR, else $XDG_CACHE_HOME/smplx, else ~/.cache/smplx, with
+// batch_chunks.txt appended; empty if none of them is set.
+auto chunk_cache_path() -> std::string;
+
+auto load_chunk_size(const std::string &path, const std::string &key)
+    -> std::optional<int64_t>;
+
+// Replaces the line of key (written to a temporary file, then renamed).
+// Failures are reported and otherwise ignored.
+auto store_chunk_size(const std::string &path, const std::string &key,
+                      int64_t chunk_size) -> void;
+
+// The candidate with the lowest seconds_per_body, preferring smaller chunks
+// (less memory) within 3% of the best.
+auto autotune_chunk_size(const std::vector<int64_t> &candidates,
+                         const std::function<double(int64_t)> &seconds_per_body)
+    -> int64_t;
+} // namespace smplx
+#endif
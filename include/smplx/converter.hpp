@@ -8,89 +8,82 @@
 #include <string>
 #include <vector>
 
-template <typename T>
-torch::Tensor convertTensor(const cnpy::NpyArray &arr, torch::Dtype dtype) {
-    const T *data_ptr = arr.data<T>();
-    const auto &shape = arr.shape;
-
-    if (shape.size() < 2 || shape.size() > 3) {
-        throw std::runtime_error("Only 2D or 3D arrays are supported.");
-    }
-
-    std::vector<T> flat_data;
-    flat_data.reserve(arr.num_vals);
-
-    if (shape.size() == 2) {
-        size_t nrows = shape[0];
-        size_t ncols = shape[1];
-
-        if (arr.fortran_order) {
-            for (size_t i = 0; i < nrows; ++i) {
-                for (size_t j = 0; j < ncols; ++j) {
-                    flat_data.push_back(data_ptr[j * nrows + i]);
-                }
-            }
-        } else {
-            for (size_t i = 0; i < nrows; ++i) {
-                for (size_t j = 0; j < ncols; ++j) {
-                    flat_data.push_back(data_ptr[i * ncols + j]);
-                }
-            }
+// Torch dtype matching the elements stored in the npy array.
+inline torch::Dtype npyDtype(const cnpy::NpyArray &arr) {
+    switch (arr.type_code) {
+    case 'f':
+        switch (arr.word_size) {
+        case 2:
+            return torch::kFloat16;
+        case 4:
+            return torch::kFloat32;
+        case 8:
+            return torch::kFloat64;
         }
-        return torch::from_blob(
-                   flat_data.data(),
-                   {static_cast<int64_t>(nrows), static_cast<int64_t>(ncols)},
-                   torch::TensorOptions().dtype(dtype))
-            .clone();
-    } else {
-        size_t dim0 = shape[0];
-        size_t dim1 = shape[1];
-        size_t dim2 = shape[2];
-
-        if (arr.fortran_order) {
-            for (size_t i = 0; i < dim0; ++i) {
-                for (size_t j = 0; j < dim1; ++j) {
-                    for (size_t k = 0; k < dim2; ++k) {
-                        flat_data.push_back(
-                            data_ptr[k * dim1 * dim0 + j * dim0 + i]);
-                    }
-                }
-            }
-        } else {
-            for (size_t i = 0; i < dim0; ++i) {
-                for (size_t j = 0; j < dim1; ++j) {
-                    for (size_t k = 0; k < dim2; ++k) {
-                        flat_data.push_back(
-                            data_ptr[i * dim1 * dim2 + j * dim2 + k]);
-                    }
-                }
-            }
+        break;
+    case 'i':
+        switch (arr.word_size) {
+        case 1:
+            return torch::kInt8;
+        case 2:
+            return torch::kInt16;
+        case 4:
+            return torch::kInt32;
+        case 8:
+            return torch::kInt64;
         }
-        return torch::from_blob(flat_data.data(),
-                                {static_cast<int64_t>(dim0),
-                                 static_cast<int64_t>(dim1),
-                                 static_cast<int64_t>(dim2)},
-                                torch::TensorOptions().dtype(dtype))
-            .clone();
+        break;
+    case 'u':
+        switch (arr.word_size) {
+        case 1:
+            return torch::kUInt8;
+        case 2:
+            return torch::kUInt16;
+        case 4:
+            return torch::kUInt32;
+        case 8:
+            return torch::kUInt64;
+        }
+        break;
+    case 'b':
+        return torch::kBool;
     }
+    throw std::runtime_error("Unsupported npy type '" +
+                             std::string(1, arr.type_code) + "' with word size " +
+                             std::to_string(arr.word_size));
 }
 
+// Converts an npy array of any rank into a tensor of the requested dtype.
+//
+// The array is first wrapped (without copying) as a tensor of its *stored*
+// dtype, Fortran-ordered arrays through a strided view. If that is already
+// the requested dtype and layout the npy buffer is returned as is, otherwise
+// the final tensor is allocated once and filled by a single copy_, which
+// casts and reorders in one vectorized pass.
 inline torch::Tensor cnpyToTensor(const cnpy::NpyArray &arr,
                                   torch::Dtype dtype) {
-    switch (dtype) {
-    case torch::kFloat32:
-        return convertTensor<float>(arr, dtype);
-    case torch::kFloat64:
-        return convertTensor<double>(arr, dtype);
-    case torch::kInt32:
-        return convertTensor<int32_t>(arr, dtype);
-    case torch::kInt64:
-        return convertTensor<int64_t>(arr, dtype);
-    case torch::kUInt32:
-        return convertTensor<uint32_t>(arr, dtype);
-    default:
-        throw std::runtime_error("Unsupported dtype in cnpyToTensor.");
+    torch::Dtype stored = npyDtype(arr);
+
+    const auto ndim = arr.shape.size();
+    std::vector<int64_t> sizes(arr.shape.begin(), arr.shape.end());
+    std::vector<int64_t> strides(ndim);
+    int64_t stride = 1;
+    for (size_t i = 0; i < ndim; ++i) {
+        size_t d = arr.fortran_order ? i : ndim - 1 - i;
+        strides[d] = stride;
+        stride *= sizes[d];
+    }
+
+    // The deleter keeps the npy buffer alive as long as the tensor is.
+    auto holder = arr.data_holder;
+    auto src = torch::from_blob(
+        holder->data(), sizes, strides, [holder](void *) {},
+        torch::TensorOptions().dtype(stored));
+
+    if (stored == dtype && src.is_contiguous()) {
+        return src;
     }
+    return torch::empty(sizes, torch::TensorOptions().dtype(dtype)).copy_(src);
 }
 
 inline void dump_tensor(const torch::Tensor &tensor, const std::string &name) {
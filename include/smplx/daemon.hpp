@@ -0,0 +1,215 @@
+#ifndef SMPLX_DAEMON_HPP
+#define SMPLX_DAEMON_HPP
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include "executor.hpp"
+#include "smplx.hpp"
+
+// Local inference daemon (Linux): one process loads the models and serves
+// forwards to other processes on the machine.
+//
+// A client connects to a Unix domain socket and names a model; the daemon
+// answers with the model dimensions and a memfd that both map: a ring of
+// slots, each holding the parameters and outputs of one request. Only
+// fixed-size control messages (slot, rows, flags) go through the socket;
+// the daemon runs forwards straight on the mapped parameters and writes the
+// outputs into the slot. Requests of every client of a model go through a
+// shared Executor, so they are batched together.
+namespace smplx {
+namespace ipc {
+constexpr uint32_t kMagic = 0x534d504c; // "SMPL"
+constexpr uint32_t kVersion = 1;
+// Bounds on what a client may ask for; the daemon refuses larger rings.
+constexpr uint32_t kMaxRows = 4096;
+constexpr uint32_t kMaxSlots = 256;
+constexpr uint64_t kMaxRingBytes = uint64_t(4) << 30;
+// A client that has not sent its Hello by then is disconnected.
+constexpr std::chrono::seconds kHandshakeTimeout{5};
+
+struct Hello {
+    uint32_t magic{kMagic};
+    uint32_t version{kVersion};
+    char model[64]{};
+    uint32_t max_rows{0};
+    uint32_t num_slots{0};
+};
+
+// Followed by the memfd of the ring (SCM_RIGHTS) when status is 0.
+struct HelloReply {
+    int32_t status{0};
+    int32_t dtype{0}; // c10::ScalarType
+    int64_t num_betas{0};
+    int64_t num_vertices{0};
+    int64_t num_joints{0}; // joints per body in the outputs
+    uint64_t ring_bytes{0};
+    char error[128]{};
+};
+
+struct Request {
+    uint32_t slot{0};
+    uint32_t rows{0};
+    uint8_t pose2rot{1};
+    uint8_t return_verts{0};
+};
+
+struct Response {
+    uint32_t slot{0};
+    int32_t status{0};
+    char error[128]{};
+};
+
+// Byte offsets of the arrays of one slot, each sized for max_rows bodies
+// (poses for rotation matrices) and 64-byte aligned. Slot i starts at
+// i * bytes. make() throws if the sizes overflow; ring_bytes() gives the
+// size of num_slots slots, or nothing if that overflows or exceeds
+// kMaxRingBytes.
+struct SlotLayout {
+    size_t betas{0}, global_orient{0}, body_pose{0}, transl{0};
+    size_t vertices{0}, joints{0};
+    size_t bytes{0};
+
+    static auto make(int64_t max_rows, int64_t num_betas,
+                     int64_t num_vertices, int64_t num_joints,
+                     size_t element_size) -> SlotLayout;
+    auto ring_bytes(uint64_t num_slots) const -> std::optional<size_t>;
+};
+
+// Blocking I/O of whole messages, retried on EINTR; false on EOF or error.
+auto send_all(int fd, const void *data, size_t size) -> bool;
+auto recv_all(int fd, void *data, size_t size) -> bool;
+// One message with a file descriptor attached (SCM_RIGHTS); attached is -1
+// when none came with it.
+auto send_with_fd(int fd, const void *data, size_t size, int attached)
+    -> bool;
+auto recv_with_fd(int fd, void *data, size_t size, int *attached) -> bool;
+} // namespace ipc
+
+// Serves the models added before start() on socket_path.
+//
+// The socket is created with socket_mode (owner only by default), which is
+// what decides who may connect: any client can run forwards on the models
+// and has the daemon map a ring of up to kMaxRingBytes for it.
+//
+//   smplx::DaemonServer server("/tmp/smplx.sock");
+//   server.add_model("neutral", std::make_shared<const smplx::SMPL>(
+//                                   path, torch::kCPU, smplx::inference()));
+//   server.start();
+class DaemonServer {
+  public:
+    explicit DaemonServer(std::string socket_path,
+                          ExecutorOptions executor_options = {},
+                          mode_t socket_mode = 0600);
+    ~DaemonServer();
+    DaemonServer(const DaemonServer &) = delete;
+    auto operator=(const DaemonServer &) -> DaemonServer & = delete;
+
+    auto add_model(const std::string &name, std::shared_ptr<const SMPL> model)
+        -> void;
+    // Binds the socket (replacing a stale one) and accepts in the
+    // background.
+    auto start() -> void;
+    // Closes the socket and every session, after their queued requests.
+    auto stop() -> void;
+
+    auto stats(const std::string &name) const -> Executor::Stats;
+    auto num_sessions() const -> size_t;
+
+    struct Model {
+        std::shared_ptr<const SMPL> smpl;
+        std::unique_ptr<Executor> executor;
+        int64_t num_joints{0};
+    };
+    struct Session;
+
+  private:
+    auto accept_loop() -> void;
+
+    std::string socket_path_;
+    ExecutorOptions executor_options_;
+    mode_t socket_mode_;
+    std::map<std::string, Model> models_;
+    int listen_fd_{-1};
+    std::atomic<bool> running_{false};
+    std::thread acceptor_;
+    mutable std::mutex sessions_mutex_;
+    std::vector<std::shared_ptr<Session>> sessions_;
+};
+
+struct DaemonClientOptions {
+    // Bodies per request, and requests in flight (ring slots); at most
+    // ipc::kMaxRows and ipc::kMaxSlots.
+    int64_t max_rows{64};
+    int64_t num_slots{8};
+};
+
+// Client of a DaemonServer, with the forward() API of SMPL:
+//
+//   smplx::DaemonClient client("/tmp/smplx.sock", "neutral");
+//   auto out = client.forward(smplx::body_pose(pose), smplx::return_verts());
+//
+// Parameters are written into a free slot of the ring; the returned vertices
+// and joints are views of that slot, which is only reused once they are
+// released. Missing parameters are zero. submit() may be called from
+// several threads and blocks while every slot is in use.
+class DaemonClient {
+  public:
+    DaemonClient(const std::string &socket_path, const std::string &model,
+                 DaemonClientOptions options = {});
+    ~DaemonClient();
+    DaemonClient(const DaemonClient &) = delete;
+    auto operator=(const DaemonClient &) -> DaemonClient & = delete;
+
+    auto submit(const SMPLInput &input) -> std::future<SMPLOutput>;
+    auto forward(const SMPLInput &input) -> SMPLOutput {
+        return submit(input).get();
+    }
+
+    template <typename... Args,
+              typename = std::enable_if_t<
+                  !(std::is_same_v<std::decay_t<Args>, SMPLInput> || ...)>>
+    auto forward(Args &&...args) -> SMPLOutput {
+        internal::option opt;
+        if constexpr (sizeof...(Args) > 0) {
+            apply_option(opt, args...);
+        }
+        SMPLInput input;
+        input.betas = opt.betas;
+        input.global_orient = opt.global_orient;
+        input.body_pose = opt.body_pose;
+        input.transl = opt.transl;
+        input.pose2rot = opt.pose2rot;
+        input.return_verts = opt.return_verts;
+        input.return_full_pose = opt.return_full_pose;
+        return forward(input);
+    }
+
+    auto num_betas() const -> int64_t { return num_betas_; }
+    auto num_verts() const -> int64_t { return num_vertices_; }
+    auto compute_dtype() const -> torch::ScalarType { return dtype_; }
+
+    // Socket, mapping, free slots and pending requests; kept alive by the
+    // returned tensors.
+    struct State;
+
+  private:
+    auto receive_loop() -> void;
+
+    std::shared_ptr<State> state_;
+    int64_t num_betas_{0};
+    int64_t num_vertices_{0};
+    torch::ScalarType dtype_{torch::kFloat64};
+    std::thread receiver_;
+};
+} // namespace smplx
+#endif
@@ -0,0 +1,58 @@
+#ifndef SMPLX_EXECUTION_HPP
+#define SMPLX_EXECUTION_HPP
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+#include "c10/util/ParallelGuard.h"
+
+namespace smplx {
+// Where the forwards of one model run (see smplx::execution()).
+struct ExecutionSettings {
+    // Intra-op threads of a forward: 0 keeps the caller's LibTorch setting,
+    // 1 runs every op inline on the calling thread. Larger budgets need the
+    // OpenMP backend (the LibTorch default) and set the OpenMP thread count
+    // of the calling thread only; MKL keeps its own setting, and the native
+    // backend only has a process-wide pool, which is left as is.
+    int num_threads{0};
+    // CPUs a forward runs on (Linux only), empty to keep the affinity. The
+    // calling thread and, with the OpenMP backend, the threads of its
+    // OpenMP team are pinned for the forward and restored to the caller's
+    // previous mask after it. The native backend's pool is not pinned.
+    std::vector<int> cpu_affinity;
+    // Builds the model on a thread pinned to cpu_affinity, from private
+    // copies of the shared buffers, so that first touch places every buffer
+    // on the NUMA node of those CPUs.
+    bool numa_local{false};
+};
+
+// Applies settings to the calling thread (and its OpenMP team) for its
+// scope and restores the previous thread count and affinity on exit.
+// Default settings make it a no-op.
+class ExecutionGuard {
+  public:
+    explicit ExecutionGuard(const ExecutionSettings &settings);
+    ~ExecutionGuard();
+    ExecutionGuard(const ExecutionGuard &) = delete;
+    auto operator=(const ExecutionGuard &) -> ExecutionGuard & = delete;
+
+  private:
+    std::optional<c10::ParallelGuard> serial_;
+    int previous_threads_{0};
+    bool restore_affinity_{false};
+    bool pin_team_{false};
+    // cpu_set_t of the thread before the guard.
+    std::array<uint64_t, 16> previous_mask_{};
+};
+
+// Pins the calling thread to cpus; false if unsupported or refused.
+auto pin_current_thread(const std::vector<int> &cpus) -> bool;
+
+// Runs fn on a new thread pinned to cpus with intra-op parallelism off, so
+// that everything it allocates is first touched from those CPUs, and
+// rethrows its exception if any.
+auto run_on_cpus(const std::vector<int> &cpus, const std::function<void()> &fn)
+    -> void;
+} // namespace smplx
+#endif
@@ -0,0 +1,97 @@
+#ifndef SMPLX_EXECUTOR_HPP
+#define SMPLX_EXECUTOR_HPP
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "smplx.hpp"
+
+namespace smplx {
+struct ExecutorOptions {
+    // Worker threads, each running one coalesced forward at a time.
+    int num_workers{1};
+    // Bodies per coalesced forward; a single larger request still runs.
+    int64_t max_batch{64};
+    // How long the oldest pending request may wait for others to join it.
+    std::chrono::microseconds max_wait{500};
+    // Latencies kept for the percentiles (the most recent ones).
+    size_t latency_window{1 << 16};
+};
+
+// Dynamic batching in front of one model: submit() queues a request and
+// returns at once, workers coalesce pending requests into one forward of up
+// to max_batch bodies (or whatever arrived within max_wait) and hand every
+// request its own rows of the outputs.
+//
+//   smplx::Executor executor(model, {/*num_workers=*/2, /*max_batch=*/128});
+//   auto future = executor.submit(input);
+//   auto out = future.get();
+//
+// Requests coalesce when they give betas, global_orient, body_pose and
+// transl with the same dtype, device and widths and the same flags, each
+// with one row or the request's row count; a request relying on the
+// model's default parameters, or with row counts that do not broadcast,
+// runs on its own.
+// Forwards run without gradients. The destructor finishes every queued
+// request.
+class Executor {
+  public:
+    struct Stats {
+        uint64_t requests{0};
+        uint64_t batches{0};
+        double mean_batch_size{0};
+        // Submit to completion, over the latency window.
+        double p50_ms{0}, p90_ms{0}, p99_ms{0}, max_ms{0};
+        // Bodies per coalesced forward -> number of forwards.
+        std::map<int64_t, uint64_t> batch_sizes;
+    };
+
+    explicit Executor(std::shared_ptr<const SMPL> model,
+                      ExecutorOptions options = {});
+    ~Executor();
+    Executor(const Executor &) = delete;
+    auto operator=(const Executor &) -> Executor & = delete;
+
+    auto submit(SMPLInput input) -> std::future<SMPLOutput>;
+
+    auto stats() const -> Stats;
+    auto reset_stats() -> void;
+
+  private:
+    using Clock = std::chrono::steady_clock;
+    struct Request {
+        SMPLInput input;
+        std::promise<SMPLOutput> promise;
+        Clock::time_point submitted;
+        int64_t rows{0};
+        bool coalescable{false};
+    };
+
+    auto worker() -> void;
+    // Pending requests that can join the front one, with their rows.
+    auto compatible_rows(const Request &front) const -> int64_t;
+    auto run(std::vector<Request> &batch) -> void;
+    auto record(const std::vector<Request> &batch, int64_t rows) -> void;
+
+    std::shared_ptr<const SMPL> model_;
+    ExecutorOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<Request> queue_;
+    bool stop_{false};
+    std::vector<std::thread> workers_;
+
+    mutable std::mutex stats_mutex_;
+    Stats stats_;
+    uint64_t bodies_{0};
+    std::vector<double> latencies_ms_;
+    size_t next_latency_{0};
+};
+} // namespace smplx
+#endif
@@ -0,0 +1,39 @@
+#ifndef SMPLX_FORWARD_WORKSPACE_HPP
+#define SMPLX_FORWARD_WORKSPACE_HPP
+#include "common.hpp"
+
+namespace smplx {
+// Reusable buffers of SMPL::forward_into, sized for up to max_batch_size
+// (see SMPL::make_workspace). Every intermediate and output is written in
+// place: the tensors returned by forward_into are views into these buffers
+// and are overwritten by the next call. A workspace must not be shared
+// between concurrent calls.
+struct ForwardWorkspace {
+    int64_t max_batch_size{0};
+    // Flat buffers, laid out for the largest batch.
+    Tensor betas;        // max_batch x L
+    Tensor full_pose;    // max_batch x J x 9 (axis-angle uses J x 3)
+    Tensor v_shaped;     // max_batch x V x 3
+    Tensor rest_joints;  // max_batch x J x 3
+    Tensor rot_mats;     // max_batch x J x 9
+    Tensor pose_feature; // max_batch x 9 (J - 1)
+    Tensor low_rank;     // max_batch x r, low-rank posedirs only
+    Tensor v_posed;      // max_batch x V x 3
+    Tensor transforms;   // max_batch x J x 16
+    Tensor vertices;     // max_batch x V x 3
+    Tensor joints;       // max_batch x (J + K) x 3
+
+    // Views for the last call, only rebuilt when its batch size, vertex set
+    // or pose format changes; a steady stream of same-shaped calls does not
+    // allocate.
+    struct Views {
+        int64_t batch_size{-1};
+        int64_t num_vertices{-1};
+        bool pose2rot{true};
+        Tensor betas, full_pose, pose_vecs, rot_mats;
+        Tensor v_posed, transforms, vertices, joints, keypoints;
+    };
+    Views views;
+};
+} // namespace smplx
+#endif
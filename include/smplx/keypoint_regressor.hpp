@@ -0,0 +1,51 @@
+#ifndef SMPLX_KEYPOINT_REGRESSOR_HPP
+#define SMPLX_KEYPOINT_REGRESSOR_HPP
+#include <tuple>
+#include "common.hpp"
+
+namespace smplx::lbs {
+// Keypoints as sparse linear combinations of the vertices: a (K, V) matrix in
+// CSR form. Joint regressors only use a few dozen vertices per row and
+// vertex keypoints (nose, toes, fingertips) a single one, so any set of them
+// is regressed by one sparse-dense product.
+struct KeypointRegressor {
+    Tensor crow_indices; // (K + 1,) int64
+    Tensor col_indices;  // (nnz,) int64 vertex of each entry
+    Tensor row_indices;  // (nnz,) int64 keypoint of each entry
+    Tensor values;       // (nnz,)
+    int64_t num_vertices{0};
+
+    auto num_keypoints() const -> int64_t { return crow_indices.size(0) - 1; }
+    auto nnz() const -> int64_t { return values.size(0); }
+};
+
+// From a dense (K, V) regressor (e.g. J_regressor, or the OpenPose BODY_25 /
+// COCO-17 regressors); entries with |w| <= threshold are dropped.
+auto sparse_regressor(const Tensor &regressor, double threshold = 0)
+    -> KeypointRegressor;
+
+// One row per vertex of vertex_ids, selecting that vertex.
+auto vertex_regressor(const Tensor &vertex_ids, int64_t num_vertices,
+                      torch::Dtype dtype) -> KeypointRegressor;
+
+// The rows of top followed by the rows of bottom.
+auto stack_regressors(const KeypointRegressor &top,
+                      const KeypointRegressor &bottom) -> KeypointRegressor;
+
+// The vertices used by any row (sorted), and the same regressor with its
+// columns renumbered over those vertices only.
+auto compact_regressor(const KeypointRegressor &regressor)
+    -> std::tuple<Tensor, KeypointRegressor>;
+
+// (B, V, 3) -> (B, K, 3). On CPU without autograd this is a fused gather
+// kernel parallelized over batch x keypoints; otherwise an index_select +
+// index_add.
+auto regress_keypoints(const KeypointRegressor &regressor,
+                       const Tensor &vertices) -> Tensor;
+
+// CPU kernel of regress_keypoints() writing into out (B, K, 3), e.g. a view
+// into a larger joints buffer, without autograd.
+auto regress_keypoints_out(const KeypointRegressor &regressor,
+                           const Tensor &vertices, const Tensor &out) -> void;
+} // namespace smplx::lbs
+#endif
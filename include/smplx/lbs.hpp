@@ -2,16 +2,43 @@
 #define SMPLX_LBS_HPP
 #include "ATen/TensorIndexing.h"
 #include "ATen/ops/sqrt.h"
+#include <optional>
 #include "common.hpp"
+#include "keypoint_regressor.hpp"
+#include "pose_correctives.hpp"
+#include "skinning.hpp"
 #include "torch/torch.h"
 
 namespace smplx::lbs {
-inline auto vertices2joints(Tensor &J_regressor, Tensor &vertices) -> Tensor {
+inline auto vertices2joints(const Tensor &J_regressor, const Tensor &vertices)
+    -> Tensor {
     return torch::einsum("bik,ji->bjk", {vertices, J_regressor});
 }
-inline auto blend_shape(Tensor &betas, Tensor &shape_disps) -> Tensor {
+inline auto vertices2joints(const KeypointRegressor &J_regressor,
+                            const Tensor &vertices) -> Tensor {
+    return regress_keypoints(J_regressor, vertices);
+}
+// The blend shape bases may be stored in a lower precision than the compute
+// dtype (bfloat16, see SMPL's model_dtype option). The products are then
+// evaluated in the storage dtype, whose CPU GEMMs accumulate in float32, and
+// returned in the dtype of the coefficients.
+inline auto blend_shape(const Tensor &betas, const Tensor &shape_disps)
+    -> Tensor {
+    if (betas.scalar_type() != shape_disps.scalar_type()) {
+        return torch::einsum("bl,mkl->bmk",
+                             {betas.to(shape_disps.scalar_type()), shape_disps})
+            .to(betas.scalar_type());
+    }
     return torch::einsum("bl,mkl->bmk", {betas, shape_disps});
 }
+inline auto blend_pose(const Tensor &pose_feature, const Tensor &posedirs)
+    -> Tensor {
+    if (pose_feature.scalar_type() != posedirs.scalar_type()) {
+        return torch::matmul(pose_feature.to(posedirs.scalar_type()), posedirs)
+            .to(pose_feature.scalar_type());
+    }
+    return torch::matmul(pose_feature, posedirs);
+}
 
 inline auto rot_mat_to_euler(Tensor &rot_mats) -> Tensor {
     auto sy = torch::sqrt(rot_mats.index({Slice(None), 0, 0}) *
@@ -27,14 +54,137 @@ inline auto transform_mat(Tensor &&R, Tensor &&t) -> Tensor {
                        torch::pad(t, {0, 0, 0, 1}, "constant", 1)},
                       2);
 }
-auto batch_rodrigues(Tensor &&rot_vecs, float epsilon = 1e-8) -> Tensor;
-auto batch_rigid_transform(Tensor &rot_mats, Tensor &joints, Tensor &parents,
+// See rodrigues(); epsilon is no longer used, small angles are handled
+// exactly.
+auto batch_rodrigues(const Tensor &rot_vecs, float epsilon = 1e-8) -> Tensor;
+
+// Joints grouped by depth in the kinematic tree, so that the chain is
+// evaluated with one batched matmul per level instead of one per joint.
+// Built once from the parents (which are read on the host here only).
+struct KinematicTree {
+    Tensor parents; // (J,) int64, the root is its own parent
+    // levels[d] holds the joints at depth d + 1, level_parents[d] their
+    // parents; the root (depth 0) is not listed.
+    std::vector<Tensor> levels;
+    std::vector<Tensor> level_parents;
+
+    auto num_joints() const -> int64_t { return parents.size(0); }
+};
+
+// Expects parents[i] < i for every joint but the root (joint 0).
+auto build_kinematic_tree(const Tensor &parents) -> KinematicTree;
+
+auto batch_rigid_transform(const Tensor &rot_mats, const Tensor &joints,
+                           const KinematicTree &tree)
+    -> std::tuple<Tensor, Tensor>;
+auto batch_rigid_transform(const Tensor &rot_mats, const Tensor &joints,
+                           const Tensor &parents,
                            torch::Dtype dtype = torch::kFloat32)
     -> std::tuple<Tensor, Tensor>;
 
-auto lbs(Tensor &betas, Tensor &pose, Tensor &v_template, Tensor &shapedirs,
-         Tensor &posedirs, Tensor &J_regressor, Tensor &parents,
-         Tensor &lbs_weights, bool pose2rot) -> std::tuple<Tensor, Tensor>;
+// Derived model data computed once at construction. Every member is
+// optional: lbs() falls back to the plain buffers for those left unset.
+struct Precomputed {
+    // J_regressor folded into the shape space: the rest joints are
+    // J_template + J_shapedirs . betas, without going through v_shaped.
+    Tensor J_template;  // (J, 3)
+    Tensor J_shapedirs; // (J, 3, L)
+    // Used instead of lbs_weights when set.
+    std::optional<SparseWeights> sparse_weights;
+    // Used instead of parents when set.
+    std::optional<KinematicTree> kinematic_tree;
+    // Used instead of posedirs when set (at most one of the two).
+    std::optional<LowRankPosedirs> low_rank_posedirs;
+    std::optional<BlockSparsePosedirs> block_sparse_posedirs;
+};
+
+// Pose corrective offsets (B, V * 3) of pose_feature (B, P), through the
+// compressed posedirs of precomputed if any.
+inline auto pose_correctives(const Tensor &pose_feature, const Tensor &posedirs,
+                             const Precomputed &precomputed) -> Tensor {
+    if (precomputed.low_rank_posedirs.has_value()) {
+        const auto &low_rank = *precomputed.low_rank_posedirs;
+        return blend_pose(blend_pose(pose_feature, low_rank.left),
+                          low_rank.right);
+    }
+    if (precomputed.block_sparse_posedirs.has_value()) {
+        return block_sparse_correctives(pose_feature,
+                                        *precomputed.block_sparse_posedirs);
+    }
+    return blend_pose(pose_feature, posedirs);
+}
+
+auto regress_shape_joints(const Tensor &J_regressor, const Tensor &v_template,
+                          const Tensor &shapedirs) -> std::tuple<Tensor, Tensor>;
+
+inline auto shape_joints(const Tensor &betas, const Precomputed &precomputed)
+    -> Tensor {
+    return precomputed.J_template +
+           blend_shape(betas, precomputed.J_shapedirs);
+}
+
+// Model buffers restricted to a fixed set of vertices, for callers that only
+// need those vertices posed (e.g. the extra keypoints of
+// VertexJointSelector). posedirs keeps the (P, n * 3) layout.
+struct VertexSubset {
+    Tensor vertex_ids;
+    Tensor v_template;
+    Tensor shapedirs;
+    Tensor posedirs;
+    Tensor lbs_weights;
+    Precomputed precomputed;
+};
+
+auto select_vertices(const Tensor &vertex_ids, const Tensor &v_template,
+                     const Tensor &shapedirs, const Tensor &posedirs,
+                     const Tensor &lbs_weights, const Precomputed &precomputed)
+    -> VertexSubset;
+
+// If transl is given it is fused into the skinning pass and added to both
+// the vertices and the joints.
+auto lbs(const Tensor &betas, const Tensor &pose, const Tensor &v_template,
+         const Tensor &shapedirs, const Tensor &posedirs,
+         const Tensor &J_regressor, const Tensor &parents,
+         const Tensor &lbs_weights, bool pose2rot,
+         const std::optional<Tensor> &transl = std::nullopt,
+         const Precomputed &precomputed = Precomputed{})
+    -> std::tuple<Tensor, Tensor>;
+
+// The two halves of lbs(), for callers that reuse the shape stage across
+// poses. shape_blend() returns the shaped vertices and the rest joints;
+// pose_and_skin() broadcasts them over the batch of pose.
+auto shape_blend(const Tensor &betas, const Tensor &v_template,
+                 const Tensor &shapedirs, const Tensor &J_regressor,
+                 const Precomputed &precomputed = Precomputed{})
+    -> std::tuple<Tensor, Tensor>;
+
+auto pose_and_skin(const Tensor &v_shaped, const Tensor &rest_joints,
+                   const Tensor &pose, const Tensor &posedirs,
+                   const Tensor &parents, const Tensor &lbs_weights,
+                   bool pose2rot,
+                   const std::optional<Tensor> &transl = std::nullopt,
+                   const Precomputed &precomputed = Precomputed{})
+    -> std::tuple<Tensor, Tensor>;
+
+// lbs() over a vertex subset; the rest joints still come from the full
+// model through subset.precomputed, which must hold the shape regressor.
+auto lbs(const Tensor &betas, const Tensor &pose, const VertexSubset &subset,
+         const Tensor &parents, bool pose2rot,
+         const std::optional<Tensor> &transl = std::nullopt)
+    -> std::tuple<Tensor, Tensor>;
+
+// Same result as lbs(), recorded by autograd as a single node that only keeps
+// the rotations, the joint transforms, the rest joints and v_posed, instead
+// of every intermediate of the shape, pose and skinning stages. The backward
+// derives the rest analytically (first order only). precomputed must hold
+// the shape regressor and the kinematic tree.
+auto lbs_fused(const Tensor &betas, const Tensor &pose,
+               const Tensor &v_template, const Tensor &shapedirs,
+               const Tensor &posedirs, const Tensor &lbs_weights,
+               bool pose2rot,
+               const std::optional<Tensor> &transl = std::nullopt,
+               const Precomputed &precomputed = Precomputed{})
+    -> std::tuple<Tensor, Tensor>;
 
 auto vertices2landmarks(Tensor &vertices, Tensor &faces, Tensor &lmk_faces_idx,
                         Tensor &lmk_bary_coords) -> Tensor;
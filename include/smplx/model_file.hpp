@@ -0,0 +1,88 @@
+#ifndef SMPLX_MODEL_FILE_HPP
+#define SMPLX_MODEL_FILE_HPP
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "common.hpp"
+
+namespace smplx {
+
+// Native on-disk model format (".tsmx").
+//
+// Every buffer is stored in the exact dtype and layout SMPL::construct uses
+// (posedirs already transposed to (P, V * 3), int64 faces and parents), each
+// one aligned to kModelFileAlignment bytes. The file is mapped with mmap and
+// the tensors are built on top of the mapping with torch::from_blob, so
+// loading on CPU does not copy anything and several processes share the same
+// page-cache pages.
+//
+// Layout (little endian):
+//   ModelFileHeader
+//   ModelFileEntry[num_entries]
+//   padding, then each buffer at its (aligned) offset
+constexpr char kModelFileMagic[8] = {'T', 'S', 'M', 'X', 'M', 'D', 'L', '\0'};
+constexpr uint32_t kModelFileVersion = 1;
+constexpr uint64_t kModelFileAlignment = 64;
+constexpr const char *kModelFileExtension = "tsmx";
+constexpr size_t kModelFileMaxName = 48;
+constexpr size_t kModelFileMaxDims = 4;
+
+struct ModelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_entries;
+    uint64_t data_offset;
+    uint64_t file_size;
+};
+
+struct ModelFileEntry {
+    char name[kModelFileMaxName];
+    int32_t dtype; // c10::ScalarType
+    uint32_t ndim;
+    int64_t shape[kModelFileMaxDims];
+    uint64_t offset; // from the beginning of the file
+    uint64_t nbytes;
+};
+
+static_assert(sizeof(ModelFileHeader) == 32, "unexpected header padding");
+static_assert(sizeof(ModelFileEntry) == 104, "unexpected entry padding");
+
+// Read-only view over a mapped .tsmx file. Tensors returned by tensor() keep
+// the mapping alive, so the MappedModelFile itself may be dropped early.
+class MappedModelFile {
+  public:
+    explicit MappedModelFile(const std::string &path);
+
+    auto has(const std::string &name) const -> bool {
+        return entries_.count(name) > 0;
+    }
+
+    auto names() const -> std::vector<std::string>;
+
+    // Zero-copy CPU tensor aliasing the mapped bytes.
+    auto tensor(const std::string &name) const -> Tensor;
+
+  private:
+    struct Mapping;
+    std::shared_ptr<Mapping> mapping_;
+    std::map<std::string, ModelFileEntry> entries_;
+};
+
+// Writes the given (name, tensor) pairs in the native format. Tensors are
+// moved to CPU and made contiguous; their dtype, one of float32, float64,
+// int64 and uint32, is stored as is.
+auto save_model_file(const std::string &path,
+                     const std::vector<std::pair<std::string, Tensor>> &buffers)
+    -> void;
+
+// Converts an SMPL .npz (as produced by scripts/pkl2npz.py) into the native
+// format with the buffers SMPL::construct needs, in their final layout.
+auto convert_npz_to_model_file(const std::string &npz_path,
+                               const std::string &out_path,
+                               torch::Dtype dtype = torch::kFloat64) -> void;
+
+} // namespace smplx
+#endif
@@ -0,0 +1,101 @@
+#ifndef SMPLX_MODEL_REGISTRY_HPP
+#define SMPLX_MODEL_REGISTRY_HPP
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "common.hpp"
+
+namespace smplx {
+
+// Read-only buffers of a loaded body model, in the layout SMPL uses
+// (posedirs transposed to (P, V * 3), int64 faces and parents).
+//
+// The tensors are shared between every SMPL handle created from the same
+// ModelData and must never be modified in place.
+struct ModelData {
+    Tensor shapedirs;
+    Tensor v_template;
+    Tensor J_regressor;
+    Tensor posedirs;
+    Tensor lbs_weights;
+    Tensor faces;
+    Tensor parents;
+    torch::Device device{torch::kCPU};
+    torch::Dtype dtype{torch::kFloat64};
+    // File the buffers were loaded from, empty when built in memory.
+    std::string path;
+
+    // Bytes held by the buffers (not counting mapped, untouched pages).
+    auto nbytes() const -> size_t;
+};
+
+// Parents of the kinematic tree of the models loaded from an .npz or
+// converted from one (SMPL::parents, the root being its own parent), as an
+// int64 tensor.
+auto npz_model_parents() -> Tensor;
+
+// Loads an .npz or .tsmx model; floating point buffers are converted to
+// dtype, or keep the dtype they are stored in (float64 for an .npz) when it
+// is nullopt, and every buffer is moved to device.
+auto load_model_data(const std::string &model_path, torch::Device device,
+                     std::optional<torch::Dtype> dtype = torch::kFloat64)
+    -> ModelData;
+
+struct ModelKey {
+    std::string path;
+    std::string gender{"neutral"};
+    torch::Dtype dtype{torch::kFloat64};
+    torch::Device device{torch::kCPU};
+
+    auto operator<(const ModelKey &other) const -> bool {
+        return std::make_tuple(path, gender, static_cast<int>(dtype),
+                               static_cast<int>(device.type()),
+                               static_cast<int>(device.index())) <
+               std::make_tuple(other.path, other.gender,
+                               static_cast<int>(other.dtype),
+                               static_cast<int>(other.device.type()),
+                               static_cast<int>(other.device.index()));
+    }
+};
+
+// Process-wide cache of loaded models. Each (path, gender, dtype, device) is
+// loaded exactly once; every SMPL built from the returned ModelData shares
+// its buffers and only owns its parameters, so extra handles (e.g. one per
+// worker thread) cost almost nothing.
+//
+//   auto data = smplx::ModelRegistry::instance().get(
+//       {"SMPL_MALE.npz", "male", torch::kFloat64, torch::kCPU});
+//   smplx::SMPL smpl(data);
+//
+// Requests for different keys load concurrently; concurrent requests for the
+// same key wait for the single load in progress.
+class ModelRegistry {
+  public:
+    static auto instance() -> ModelRegistry &;
+
+    auto get(const ModelKey &key) -> std::shared_ptr<const ModelData>;
+
+    // Loads all keys in parallel (e.g. the three genders) and waits for them.
+    auto preload(const std::vector<ModelKey> &keys) -> void;
+
+    auto contains(const ModelKey &key) -> bool;
+    auto size() -> size_t;
+
+    // Drops the registry references; handles keep their buffers alive.
+    auto erase(const ModelKey &key) -> void;
+    auto clear() -> void;
+
+  private:
+    using Entry = std::shared_future<std::shared_ptr<const ModelData>>;
+
+    std::mutex mutex_;
+    std::map<ModelKey, Entry> entries_;
+};
+
+} // namespace smplx
+#endif
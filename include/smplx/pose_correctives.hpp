@@ -0,0 +1,81 @@
+#ifndef SMPLX_POSE_CORRECTIVES_HPP
+#define SMPLX_POSE_CORRECTIVES_HPP
+#include <functional>
+#include <optional>
+#include <tuple>
+#include "common.hpp"
+
+namespace smplx::lbs {
+// Compressed forms of the pose corrective blend shapes posedirs (P, V * 3),
+// P = 9 * (J - 1). Each one keeps its vertex error on the pose benchmark set
+// below, in model units (meters).
+
+// posedirs ~= left (P, r) @ right (r, V * 3), from a truncated SVD, so that
+// the corrective is two thin GEMMs.
+struct LowRankPosedirs {
+    Tensor left;
+    Tensor right;
+    double max_vertex_error{0};
+    double mean_vertex_error{0};
+
+    auto rank() const -> int64_t { return left.size(1); }
+};
+
+// Keeps the given rank, or the smallest rank whose relative Frobenius error
+// is below tolerance (one of the two must be set).
+auto factorize_posedirs(const Tensor &posedirs,
+                        std::optional<int64_t> rank = std::nullopt,
+                        std::optional<double> tolerance = std::nullopt)
+    -> LowRankPosedirs;
+
+// posedirs split into blocks of 9 rows (one joint's rotation) by block_size
+// consecutive vertices. Only the blocks with an entry above the threshold are
+// kept, so the corrective only touches the vertices near each joint.
+struct BlockSparsePosedirs {
+    Tensor values;    // (nnz, 9, block_size * 3), sorted by vertex block
+    Tensor joints;    // (nnz,) int64, rotation block (joint - 1)
+    Tensor blocks;    // (nnz,) int64, vertex block
+    Tensor block_ptr; // (num_blocks + 1,) int64 offsets into values, on CPU
+    int64_t block_size{64};
+    int64_t num_joints{0}; // rotation blocks, J - 1
+    int64_t num_vertices{0};
+    double threshold{0};
+    double max_vertex_error{0};
+    double mean_vertex_error{0};
+
+    auto num_blocks() const -> int64_t { return block_ptr.size(0) - 1; }
+    auto nnz() const -> int64_t { return values.size(0); }
+    // Fraction of the (joint, vertex block) pairs kept.
+    auto density() const -> double {
+        return static_cast<double>(nnz()) / (num_joints * num_blocks());
+    }
+};
+
+// Drops the blocks whose largest absolute entry is <= threshold.
+auto block_sparse_posedirs(const Tensor &posedirs, double threshold,
+                           int64_t block_size = 64) -> BlockSparsePosedirs;
+
+// Corrective offsets (B, V * 3) of pose_feature (B, 9 * num_joints).
+// Joints whose rotation is the identity over the whole batch are skipped.
+auto block_sparse_correctives(const Tensor &pose_feature,
+                              const BlockSparsePosedirs &posedirs) -> Tensor;
+
+// Gradient w.r.t. pose_feature of block_sparse_correctives.
+auto block_sparse_correctives_backward(const Tensor &grad_offsets,
+                                       const BlockSparsePosedirs &posedirs)
+    -> Tensor;
+
+// Pose features (R[1:] - I flattened) of a fixed set of random poses, the
+// joints rotated by up to ~1 rad. Deterministic.
+auto pose_benchmark_features(int64_t num_joints, int64_t num_poses = 512,
+                             torch::Dtype dtype = torch::kFloat64)
+    -> Tensor;
+
+// Max and mean distance, over the benchmark poses and vertices, between
+// pose_feature @ posedirs and approx(pose_feature).
+auto pose_corrective_error(const Tensor &posedirs,
+                           const std::function<Tensor(const Tensor &)> &approx,
+                           int64_t num_poses = 512)
+    -> std::tuple<double, double>;
+} // namespace smplx::lbs
+#endif
@@ -0,0 +1,31 @@
+#ifndef SMPLX_ROTATION_HPP
+#define SMPLX_ROTATION_HPP
+#include "common.hpp"
+
+namespace smplx::lbs {
+// Axis-angle (N, 3) to rotation matrices (N, 3, 3), closed form
+//
+//   R = I + a(t) K + b(t) K^2,  a = sin(t) / t,  b = (1 - cos(t)) / t^2
+//
+// with a and b (and their derivatives) switching to their Taylor series for
+// small angles, so that zero rotations are exact and have finite gradients
+// without biasing the input.
+//
+// On CPU this is a single elementwise kernel with an analytic backward; on
+// other devices the same closed form is composed from ATen ops.
+auto rodrigues(const Tensor &rot_vecs) -> Tensor;
+
+// CPU kernel of rodrigues() writing into a preallocated contiguous (N, 3, 3)
+// (or (N, 9)) out, without autograd.
+auto rodrigues_out(const Tensor &rot_vecs, const Tensor &out) -> void;
+
+// One axis-angle vector (3) to a row-major rotation matrix (9), same closed
+// form as rodrigues(); float and double only.
+template <typename scalar_t>
+void rodrigues_single(const scalar_t *rot_vec, scalar_t *R);
+
+// Quaternions (N, 4), (w, x, y, z) order, to rotation matrices (N, 3, 3).
+// The quaternions need not be normalized but must be non-zero.
+auto quaternion_to_rotation(const Tensor &quats) -> Tensor;
+} // namespace smplx::lbs
+#endif
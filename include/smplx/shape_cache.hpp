@@ -0,0 +1,58 @@
+#ifndef SMPLX_SHAPE_CACHE_HPP
+#define SMPLX_SHAPE_CACHE_HPP
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include "common.hpp"
+
+namespace smplx {
+
+// Remembers the shape stage of lbs() (shaped vertices and rest joints) for
+// the last betas seen, so that tracking a single subject only pays for the
+// pose stage on every frame.
+//
+// A lookup hits when the betas are the same tensor at the same version, or
+// when their values are equal (hash first, then an exact comparison). Betas
+// that require grad while grad mode is enabled bypass the cache: the cached
+// tensors carry no graph.
+class ShapeCache {
+  public:
+    // One slot per vertex set sharing the betas (full mesh, keypoints, ...).
+    static constexpr int kNumSlots = 4;
+    using Shape = std::tuple<Tensor, Tensor>;
+
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t bypassed{0};
+    };
+
+    auto lookup(const Tensor &betas, int slot,
+                const std::function<Shape()> &compute) -> Shape;
+
+    auto stats() const -> Stats;
+    auto clear() -> void;
+
+    static auto cacheable(const Tensor &betas) -> bool;
+
+  private:
+    struct Key {
+        Tensor source; // keeps the TensorImpl (and its address) alive
+        int64_t version{-1};
+        uint64_t hash{0};
+        Tensor values;
+    };
+
+    auto matches(const Tensor &betas, uint64_t hash) const -> bool;
+
+    mutable std::mutex mutex_;
+    Key key_;
+    std::array<std::optional<Shape>, kNumSlots> slots_;
+    Stats stats_;
+};
+
+} // namespace smplx
+#endif
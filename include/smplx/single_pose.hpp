@@ -0,0 +1,193 @@
+#ifndef SMPLX_SINGLE_POSE_HPP
+#define SMPLX_SINGLE_POSE_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include "rotation.hpp"
+
+namespace smplx::lbs {
+// Raw row-major model buffers of a single-pose forward, all in one dtype.
+// posedirs is unused when low_rank_left is set; lbs_weights when
+// weight_indices is set; the keypoint regressor is a CSR over the rows.
+template <typename scalar_t> struct SinglePoseModel {
+    int64_t num_vertices{0};
+    int64_t num_betas{0};
+    const scalar_t *v_template{nullptr};  // (V, 3)
+    const scalar_t *shapedirs{nullptr};   // (V * 3, L)
+    const scalar_t *posedirs{nullptr};    // (9 (J - 1), V * 3)
+    const scalar_t *low_rank_left{nullptr};  // (9 (J - 1), r)
+    const scalar_t *low_rank_right{nullptr}; // (r, V * 3)
+    int64_t rank{0};
+    const scalar_t *lbs_weights{nullptr};  // (V, J)
+    const int64_t *weight_indices{nullptr}; // (V, k)
+    const scalar_t *weight_values{nullptr}; // (V, k)
+    int64_t weights_k{0};
+    const scalar_t *J_template{nullptr};  // (J, 3)
+    const scalar_t *J_shapedirs{nullptr}; // (J * 3, L)
+    int64_t num_keypoints{0};
+    const int64_t *keypoint_crow{nullptr}; // (K + 1)
+    const int64_t *keypoint_col{nullptr};  // (nnz)
+    const scalar_t *keypoint_values{nullptr};
+};
+
+// Parents must precede their children, with the root first.
+template <size_t J>
+constexpr auto is_topologically_sorted(const size_t (&parents)[J]) -> bool {
+    for (size_t i = 1; i < J; ++i) {
+        if (parents[i] >= i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// lbs() for one body, with the joint count and the kinematic tree fixed at
+// compile time: no tensor, no dispatch, no allocation. pose holds J
+// axis-angle vectors (pose2rot) or J row-major rotation matrices, transl
+// three values. vertices (V, 3) is written (and used as scratch for the
+// posed rest mesh), joints (J + K, 3) receives the posed joints followed by
+// the keypoints regressed from vertices.
+template <size_t J, const size_t (&Parents)[J], typename scalar_t>
+void single_pose_lbs(const SinglePoseModel<scalar_t> &m,
+                     const scalar_t *betas, const scalar_t *pose,
+                     bool pose2rot, const scalar_t *transl,
+                     scalar_t *vertices, scalar_t *joints) {
+    static_assert(J > 0 && is_topologically_sorted(Parents),
+                  "single_pose_lbs: parents must precede their children");
+    constexpr size_t P = (J - 1) * 9;
+    const int64_t N = m.num_vertices * 3;
+    const int64_t L = m.num_betas;
+
+    scalar_t R[J][9];
+    for (size_t i = 0; i < J; ++i) {
+        if (pose2rot) {
+            rodrigues_single(pose + i * 3, R[i]);
+        } else {
+            std::copy_n(pose + i * 9, 9, R[i]);
+        }
+    }
+
+    // Rest joints and shaped mesh: template + shapedirs . betas
+    scalar_t rest[J][3];
+    for (size_t i = 0; i < J * 3; ++i) {
+        const auto *row = m.J_shapedirs + i * L;
+        scalar_t acc = m.J_template[i];
+        for (int64_t l = 0; l < L; ++l) {
+            acc += row[l] * betas[l];
+        }
+        rest[i / 3][i % 3] = acc;
+    }
+    for (int64_t n = 0; n < N; ++n) {
+        const auto *row = m.shapedirs + n * L;
+        scalar_t acc = m.v_template[n];
+        for (int64_t l = 0; l < L; ++l) {
+            acc += row[l] * betas[l];
+        }
+        vertices[n] = acc;
+    }
+
+    // Pose correctives, one axpy per non-zero entry of R[1:] - I (joints at
+    // rest contribute nothing).
+    scalar_t feature[P];
+    for (size_t k = 0; k < P; ++k) {
+        feature[k] = R[1 + k / 9][k % 9] - scalar_t(k % 9 % 4 == 0 ? 1 : 0);
+    }
+    auto axpy = [&](scalar_t a, const scalar_t *x) {
+        if (a == scalar_t(0)) {
+            return;
+        }
+        for (int64_t n = 0; n < N; ++n) {
+            vertices[n] += a * x[n];
+        }
+    };
+    if (m.low_rank_left != nullptr) {
+        for (int64_t r = 0; r < m.rank; ++r) {
+            scalar_t acc = 0;
+            for (size_t k = 0; k < P; ++k) {
+                acc += feature[k] * m.low_rank_left[k * m.rank + r];
+            }
+            axpy(acc, m.low_rank_right + r * N);
+        }
+    } else {
+        for (size_t k = 0; k < P; ++k) {
+            axpy(feature[k], m.posedirs + k * N);
+        }
+    }
+
+    // Kinematic chain G_i = G_p [R_i | j_i - j_p], posed joints (+ transl),
+    // then the skinning transforms A_i = G_i - [0 | G_i[:3, :3] j_i].
+    scalar_t G[J][12];
+    for (size_t i = 0; i < J; ++i) {
+        scalar_t T[12];
+        for (int r = 0; r < 3; ++r) {
+            T[r * 4 + 0] = R[i][r * 3 + 0];
+            T[r * 4 + 1] = R[i][r * 3 + 1];
+            T[r * 4 + 2] = R[i][r * 3 + 2];
+            T[r * 4 + 3] = rest[i][r] - (i > 0 ? rest[Parents[i]][r] : 0);
+        }
+        if (i == 0) {
+            std::copy_n(T, 12, G[0]);
+            continue;
+        }
+        const auto *Gp = G[Parents[i]];
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                G[i][r * 4 + c] = Gp[r * 4 + 0] * T[0 * 4 + c] +
+                                  Gp[r * 4 + 1] * T[1 * 4 + c] +
+                                  Gp[r * 4 + 2] * T[2 * 4 + c] +
+                                  (c == 3 ? Gp[r * 4 + 3] : 0);
+            }
+        }
+    }
+    for (size_t i = 0; i < J; ++i) {
+        for (int r = 0; r < 3; ++r) {
+            joints[i * 3 + r] = G[i][r * 4 + 3] + transl[r];
+            G[i][r * 4 + 3] -= G[i][r * 4 + 0] * rest[i][0] +
+                               G[i][r * 4 + 1] * rest[i][1] +
+                               G[i][r * 4 + 2] * rest[i][2];
+        }
+    }
+
+    // Skinning in place: v = (sum_j w_j A_j) [v; 1] + transl
+    for (int64_t v = 0; v < m.num_vertices; ++v) {
+        scalar_t T[12] = {};
+        auto blend = [&](int64_t j, scalar_t w) {
+            for (int c = 0; c < 12; ++c) {
+                T[c] += w * G[j][c];
+            }
+        };
+        if (m.weight_indices != nullptr) {
+            for (int64_t k = 0; k < m.weights_k; ++k) {
+                blend(m.weight_indices[v * m.weights_k + k],
+                      m.weight_values[v * m.weights_k + k]);
+            }
+        } else {
+            const auto *w = m.lbs_weights + v * int64_t(J);
+            for (size_t j = 0; j < J; ++j) {
+                if (w[j] != scalar_t(0)) {
+                    blend(j, w[j]);
+                }
+            }
+        }
+        auto *x = vertices + v * 3;
+        const scalar_t x0 = x[0], x1 = x[1], x2 = x[2];
+        for (int r = 0; r < 3; ++r) {
+            x[r] = T[r * 4 + 0] * x0 + T[r * 4 + 1] * x1 +
+                   T[r * 4 + 2] * x2 + T[r * 4 + 3] + transl[r];
+        }
+    }
+
+    // Keypoints
+    for (int64_t k = 0; k < m.num_keypoints; ++k) {
+        scalar_t acc[3] = {};
+        for (auto e = m.keypoint_crow[k]; e < m.keypoint_crow[k + 1]; ++e) {
+            const auto *x = vertices + m.keypoint_col[e] * 3;
+            acc[0] += m.keypoint_values[e] * x[0];
+            acc[1] += m.keypoint_values[e] * x[1];
+            acc[2] += m.keypoint_values[e] * x[2];
+        }
+        std::copy_n(acc, 3, joints + (J + k) * 3);
+    }
+}
+} // namespace smplx::lbs
+#endif
@@ -0,0 +1,59 @@
+#ifndef SMPLX_SKINNING_HPP
+#define SMPLX_SKINNING_HPP
+#include <optional>
+#include "common.hpp"
+
+namespace smplx::lbs {
+// Linear blend skinning of the posed vertices.
+//
+//   v_posed     (B, V, 3)
+//   lbs_weights (V, J)
+//   A           (B, J, 4, 4) relative joint transforms
+//   transl      (B, 3), optional, added to every output vertex
+//
+// On CPU this runs a fused kernel that blends the joint transforms and
+// applies them to each vertex in a single pass (no (B, V, 4, 4) temporary),
+// parallelized over batch x vertices, with a matching backward. On other
+// devices it falls back to skinning_reference().
+auto skinning(const Tensor &v_posed, const Tensor &lbs_weights,
+              const Tensor &A,
+              const std::optional<Tensor> &transl = std::nullopt) -> Tensor;
+
+// Skinning weights truncated to the k most influential joints per vertex.
+struct SparseWeights {
+    Tensor indices; // (V, k) int64 joint indices
+    Tensor values;  // (V, k) weights
+    // Largest per-vertex weight mass dropped by the truncation, and largest
+    // absolute difference to the dense weights after renormalization.
+    double max_dropped_weight{0};
+    double max_weight_error{0};
+
+    auto to_dense(int64_t num_joints) const -> Tensor;
+};
+
+// Keeps the k largest weights of every vertex, optionally renormalized so
+// that they still sum to the original total.
+auto compress_weights(const Tensor &lbs_weights, int64_t k,
+                      bool renormalize = true) -> SparseWeights;
+
+// Skinning with top-k weights: O(V * k) blending instead of O(V * J).
+auto skinning(const Tensor &v_posed, const SparseWeights &weights,
+              const Tensor &A,
+              const std::optional<Tensor> &transl = std::nullopt) -> Tensor;
+
+// CPU kernels of skinning() writing into a preallocated contiguous out
+// (B, V, 3), without autograd. transl is (B, 3) or (1, 3).
+auto skinning_out(const Tensor &v_posed, const Tensor &lbs_weights,
+                  const Tensor &A, const Tensor &transl, const Tensor &out)
+    -> void;
+auto skinning_out(const Tensor &v_posed, const SparseWeights &weights,
+                  const Tensor &A, const Tensor &transl, const Tensor &out)
+    -> void;
+
+// Plain ATen implementation (matmul of the blended (B, V, 4, 4) transforms).
+auto skinning_reference(const Tensor &v_posed, const Tensor &lbs_weights,
+                        const Tensor &A,
+                        const std::optional<Tensor> &transl = std::nullopt)
+    -> Tensor;
+} // namespace smplx::lbs
+#endif
@@ -1,13 +1,24 @@
 #ifndef SMPLX_BODYMODEL_HPP
 #define SMPLX_BODYMODEL_HPP
+#include <array>
 #include <functional>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <type_traits>
 #include <utility>
+#include "arena_allocator.hpp"
+#include "batch_chunking.hpp"
+#include "c10/core/InferenceMode.h"
 #include "c10/core/ScalarType.h"
 #include "common.hpp"
 #include "converter.hpp"
+#include "execution.hpp"
+#include "forward_workspace.hpp"
 #include "lbs.hpp"
+#include "model_file.hpp"
+#include "model_registry.hpp"
+#include "shape_cache.hpp"
 #include "utils.hpp"
 #include "vertex_joint_selector.hpp"
 
@@ -33,7 +44,45 @@ struct option {
 
     bool pose2rot = true;
     bool return_verts = false;
-    bool return_full_pose;
+    bool return_full_pose = false;
+
+    // Top-k compression of the skinning weights (see lbs::compress_weights)
+    std::optional<int> lbs_topk{std::nullopt};
+    bool lbs_topk_renormalize = true;
+
+    bool shape_cache = true;
+    bool fused_autograd = true;
+
+    // Unset: the dtype of the model data (float64 for an .npz).
+    std::optional<torch::ScalarType> model_dtype{std::nullopt};
+
+    // Low-rank posedirs (see lbs::factorize_posedirs)
+    std::optional<int> posedirs_rank{std::nullopt};
+    std::optional<double> posedirs_tolerance{std::nullopt};
+    bool cache_posedirs_factors = true;
+
+    // Block-sparse posedirs (see lbs::block_sparse_posedirs)
+    std::optional<double> posedirs_block_threshold{std::nullopt};
+    int posedirs_block_size = 64;
+
+    // Dense (K, V) regressors whose rows are appended to the keypoints
+    std::vector<Tensor> extra_keypoints;
+
+    // Inference-only model (see smplx::inference())
+    bool inference = false;
+
+    // CPU arena for the forward temporaries (see ArenaAllocator)
+    bool arena = false;
+    size_t arena_max_bytes = SIZE_MAX;
+
+    // Batch-1 CPU forwards through lbs::single_pose_lbs
+    bool single_pose = true;
+
+    // Threads, affinity and buffer placement (see ExecutionSettings)
+    ExecutionSettings execution;
+
+    // Chunk size of large batches, autotuned when unset, 0 never splits
+    std::optional<int64_t> batch_chunk{std::nullopt};
 };
 } // namespace internal
 
@@ -80,6 +129,115 @@ inline auto return_verts(bool value = true) {
 //     return [value](internal::option &opt) { opt.return_full_pose = value; };
 // }
 
+// Skins with the k largest weights of each vertex instead of all joints.
+inline auto lbs_topk(int k, bool renormalize = true) {
+    return [k, renormalize](internal::option &opt) {
+        opt.lbs_topk = k;
+        opt.lbs_topk_renormalize = renormalize;
+    };
+}
+
+// Reuses the shaped mesh and rest joints while the betas do not change
+// (see ShapeCache), enabled by default.
+inline auto shape_cache(bool value = true) {
+    return [value](internal::option &opt) { opt.shape_cache = value; };
+}
+
+// Records forward passes that need gradients as a single autograd node
+// (see lbs::lbs_fused), enabled by default.
+inline auto fused_autograd(bool value = true) {
+    return [value](internal::option &opt) { opt.fused_autograd = value; };
+}
+
+// Dtype of the model buffers: float64 or float32 store and compute in that
+// dtype. bfloat16 (or float16) stores the large blend shape bases
+// (shapedirs, posedirs) in that dtype and computes everything else in
+// float32, with float32 accumulation. Parameters and outputs use the compute
+// dtype; inputs of another dtype are converted to it. By default the model
+// keeps the dtype of its data: float64 for an .npz, the stored one for a
+// .tsmx, the registry key's for shared ModelData.
+inline auto model_dtype(torch::ScalarType dtype) {
+    return [dtype](internal::option &opt) { opt.model_dtype = dtype; };
+}
+
+// Replaces posedirs by a rank-r factorization (two thin GEMMs per forward).
+// The factors are cached next to the model file unless cache is false.
+inline auto posedirs_rank(int rank, bool cache = true) {
+    return [rank, cache](internal::option &opt) {
+        opt.posedirs_rank = rank;
+        opt.cache_posedirs_factors = cache;
+    };
+}
+
+// Same, with the smallest rank whose relative Frobenius error is below
+// tolerance.
+inline auto posedirs_tolerance(double tolerance, bool cache = true) {
+    return [tolerance, cache](internal::option &opt) {
+        opt.posedirs_tolerance = tolerance;
+        opt.cache_posedirs_factors = cache;
+    };
+}
+
+// Splits posedirs into (joint, block_size vertices) blocks and drops those
+// whose entries are all <= threshold (meters per unit of R - I).
+inline auto posedirs_block_sparse(double threshold, int block_size = 64) {
+    return [threshold, block_size](internal::option &opt) {
+        opt.posedirs_block_threshold = threshold;
+        opt.posedirs_block_size = block_size;
+    };
+}
+
+// Appends the rows of a (K, V) keypoint regressor (e.g. OpenPose BODY_25 or
+// COCO-17) to the output joints, after the vertex keypoints. Rows are
+// expected to sum to one.
+inline auto extra_keypoints(const Tensor &regressor) {
+    return [regressor](internal::option &opt) {
+        opt.extra_keypoints.push_back(regressor);
+    };
+}
+
+// Inference-only model: the derived buffers and default parameters are
+// inference tensors, no parameter is registered, and every forward runs
+// under c10::InferenceMode (no autograd graph, no version counter updates).
+// The outputs are inference tensors and cannot be used in autograd.
+inline auto inference(bool value = true) {
+    return [value](internal::option &opt) { opt.inference = value; };
+}
+
+// Serves the CPU temporaries of every forward from a caching arena owned by
+// the model (see SMPL::arena()), keeping at most max_bytes cached.
+inline auto arena(bool value = true, size_t max_bytes = SIZE_MAX) {
+    return [value, max_bytes](internal::option &opt) {
+        opt.arena = value;
+        opt.arena_max_bytes = max_bytes;
+    };
+}
+
+// Runs eligible batch-1 CPU forwards (no gradients, no joint mapper, SMPL
+// kinematic tree) through a dedicated kernel instead of ATen ops, enabled
+// by default (see SMPL::forward).
+inline auto single_pose(bool value = true) {
+    return [value](internal::option &opt) { opt.single_pose = value; };
+}
+
+// Thread budget and CPU affinity of every forward, and NUMA-local model
+// buffers, for workers co-located on one machine (see ExecutionSettings).
+inline auto execution(ExecutionSettings settings) {
+    return [settings = std::move(settings)](internal::option &opt) {
+        opt.execution = settings;
+    };
+}
+
+// Splits forwards of more than chunk_size bodies into chunks that run
+// through the whole pipeline one after the other; 0 never splits. Without
+// it, CPU batches of kAutoChunkMinBatch or more use a chunk size autotuned
+// once per machine and model configuration (see batch_chunking.hpp).
+inline auto batch_chunk(int64_t chunk_size) {
+    return [chunk_size](internal::option &opt) {
+        opt.batch_chunk = chunk_size;
+    };
+}
+
 inline auto batch_size(int batch_size) {
     return [batch_size](internal::option &opt) { opt.batch_size = batch_size; };
 }
@@ -102,6 +260,8 @@ class SMPL : public torch::nn::Module {
     static constexpr size_t parents[] = {0,  0,  0,  0,  1,  2,  3,  4,
                                          5,  6,  7,  8,  9,  9,  9,  12,
                                          13, 14, 16, 17, 18, 19, 20, 21};
+    // Members of the .npz that construct() reads, the rest is skipped.
+    static const std::vector<std::string> kRequiredNpzArrays;
     SMPL() = delete;
 
     template <typename... Args>
@@ -113,37 +273,202 @@ class SMPL : public torch::nn::Module {
         construct(model_path);
     }
 
+    // Lightweight handle over buffers shared with every other SMPL built from
+    // the same ModelData (see ModelRegistry); only the parameters are owned.
+    template <typename... Args>
+    explicit SMPL(std::shared_ptr<const ModelData> data, Args &&...args)
+        : device_(data->device) {
+        if constexpr (sizeof...(Args) > 0) {
+            apply_option(vars_, args...);
+        }
+        construct(std::move(data));
+    }
+
+    // Loads either an .npz model or a native .tsmx file (see model_file.hpp).
     auto construct(const char *model) -> void;
+    auto construct(std::shared_ptr<const ModelData> data) -> void;
+
+    auto model_data() const -> const std::shared_ptr<const ModelData> & {
+        return data_;
+    }
 
-    auto num_betas() -> int { return vars_.num_betas; }
+    auto num_betas() const -> int { return vars_.num_betas; }
 
-    auto num_verts() -> int { return v_template_.size(0); }
+    auto num_verts() const -> int { return v_template_.size(0); }
 
-    auto num_faces() -> int { return faces_.size(0); }
+    auto num_faces() const -> int { return faces_.size(0); }
 
     auto faces() const -> Tensor { return faces_; }
 
+    auto compute_dtype() const -> torch::ScalarType { return compute_dtype_; }
+
+    auto is_inference() const -> bool { return vars_.inference; }
+
+    auto execution_settings() const -> const ExecutionSettings & {
+        return vars_.execution;
+    }
+
+    // Chunk size of large forwards with or without vertices: the
+    // batch_chunk() override, else the cached or freshly autotuned value.
+    // The autotune is silent; this is where its result is reported.
+    auto chunk_size(bool return_verts) const -> int64_t;
+
+    // Set when constructed with posedirs_rank() or posedirs_tolerance().
+    auto low_rank_posedirs() const
+        -> const std::optional<lbs::LowRankPosedirs> & {
+        return precomputed_.low_rank_posedirs;
+    }
+
+    // Set when constructed with posedirs_block_sparse().
+    auto block_sparse_posedirs() const
+        -> const std::optional<lbs::BlockSparsePosedirs> & {
+        return precomputed_.block_sparse_posedirs;
+    }
+
+    // Keypoints appended after the kinematic joints.
+    auto keypoint_regressor() const -> const lbs::KeypointRegressor & {
+        return keypoint_regressor_;
+    }
+
+    // Set when constructed with lbs_topk(k).
+    auto sparse_weights() const -> const std::optional<lbs::SparseWeights> & {
+        return precomputed_.sparse_weights;
+    }
+
+    // Arena of the forwards, nullptr unless constructed with arena(). Wrap a
+    // training loop in ArenaGuard guard(smpl.arena()) so that the loss and
+    // backward temporaries come from it too.
+    auto arena() const -> ArenaAllocator * { return arena_.get(); }
+
+    auto shape_cache_stats() const -> ShapeCache::Stats {
+        return shape_cache_.stats();
+    }
+    auto clear_shape_cache() const -> void { shape_cache_.clear(); }
+
+    // Gathers the model rows of the given vertices once, for forwards that
+    // only need those vertices (markers, landmarks, contact points).
+    auto vertex_subset(const Tensor &vertex_ids) const -> lbs::VertexSubset;
+
+    // Forward over a vertex subset: shape blend, pose correctives and
+    // skinning only run on the subset rows, and stay differentiable.
+    // vertices holds the subset (B, n, 3) in vertex_ids order; joints are
+    // the model joints, without the VertexJointSelector extras, and the
+    // joint mapper is not applied.
+    auto forward(const SMPLInput &input, const lbs::VertexSubset &subset) const
+        -> SMPLOutput;
+
+    // Max vertex distance between the top-k and the dense skinning for the
+    // given parameters, 0 without lbs_topk.
+    auto sparse_weights_error(const SMPLInput &input) const -> double;
+
     // auto v_template() const -> const Tensor & { return v_template_; }
 
-    template <typename... Args> auto forward(Args &&...args) -> SMPLOutput {
+    // Options only apply to this call, parameters that are not given fall
+    // back to the ones set at construction.
+    template <typename... Args,
+              typename = std::enable_if_t<
+                  !(std::is_same_v<std::decay_t<Args>, SMPLInput> || ...)>>
+    auto forward(Args &&...args) const -> SMPLOutput {
+        internal::option opt = vars_;
         if constexpr (sizeof...(Args) > 0) {
-            apply_option(vars_, args...);
+            apply_option(opt, args...);
         }
-        return forward_impl();
+        return forward(make_input(opt));
     }
 
-    auto forward_impl() -> SMPLOutput;
+    // Reentrant forward: it only reads the model, so a single SMPL can serve
+    // concurrent calls from several threads.
+    //
+    // Without return_verts only the joints are computed: the rest joints come
+    // straight from the betas and only the vertices used as extra keypoints
+    // are skinned.
+    //
+    // A single body on CPU without gradients skips ATen altogether (see
+    // smplx::single_pose()); the result matches the batched path up to
+    // rounding. Large batches that do not record gradients run in chunks
+    // written into the output (see smplx::batch_chunk()).
+    auto forward(const SMPLInput &input) const -> SMPLOutput;
+
+    // Buffers for forward_into(), for batches of up to max_batch_size.
+    auto make_workspace(int64_t max_batch_size) const -> ForwardWorkspace;
+
+    // forward() writing every intermediate and output into workspace; the
+    // returned tensors are views into it (see ForwardWorkspace). Once the
+    // workspace has seen a call of the same shape, this performs no heap
+    // allocation. Larger batches grow the workspace.
+    //
+    // Inputs must be contiguous and in the compute dtype. Only the CPU
+    // inference path runs in place: on other devices, while recording
+    // gradients, with a joint mapper, block-sparse posedirs or a storage
+    // dtype other than the compute dtype, this simply calls forward().
+    auto forward_into(const SMPLInput &input, ForwardWorkspace &workspace) const
+        -> SMPLOutput;
     Tensor v_template_;
 
   private:
+    // construct() on the calling thread; private_buffers copies the shared
+    // model buffers instead of aliasing them.
+    auto build(std::shared_ptr<const ModelData> data, bool private_buffers)
+        -> void;
+    static auto make_input(const internal::option &opt) -> SMPLInput;
+    auto to_compute_dtype(const Tensor &t) const -> Tensor;
+
+    // Parameters of one forward, defaults filled in and in compute dtype.
+    struct Resolved {
+        Tensor betas, global_orient, body_pose, transl;
+        Tensor full_pose, batch_betas;
+        bool pose2rot{true};
+    };
+    auto resolve(const SMPLInput &input) const -> Resolved;
+    // forward() of a single body through lbs::single_pose_lbs, nullopt when
+    // the call is not eligible.
+    auto forward_single_pose(const SMPLInput &input) const
+        -> std::optional<SMPLOutput>;
+    // forward() of the whole batch at once, and split into chunks of
+    // chunk_size bodies; chunk_size_for() picks the latter's size, 0 for
+    // the former. Without shape_cache the shape stage is neither looked up
+    // nor stored.
+    auto forward_batch(const SMPLInput &input, bool shape_cache = true) const
+        -> SMPLOutput;
+    auto forward_chunked(const SMPLInput &input, int64_t chunk_size) const
+        -> SMPLOutput;
+    auto chunk_size_for(const SMPLInput &input) const -> int64_t;
+    auto run_lbs(const Resolved &in, const std::optional<Tensor> &transl,
+                 int slot, const Tensor &v_template, const Tensor &shapedirs,
+                 const Tensor &posedirs, const Tensor &lbs_weights,
+                 const lbs::Precomputed &precomputed) const
+        -> std::tuple<Tensor, Tensor>;
+
     internal::option vars_;
+    std::shared_ptr<const ModelData> data_;
     torch::Device device_;
+    torch::ScalarType compute_dtype_{torch::kFloat64};
     Tensor faces_;
     Tensor shapedirs_;
     Tensor J_regressor_;
     Tensor posedirs_;
     Tensor lbs_weights_;
     Tensor parents_;
+    lbs::Precomputed precomputed_;
+    // Keypoints regressed from the posed vertices: the vertices picked by
+    // vertex_joint_selector_, then the extra_keypoints rows.
+    lbs::KeypointRegressor keypoint_regressor_;
+    // The vertices used by keypoint_regressor_, and the same regressor over
+    // that subset, for joints-only forwards.
+    lbs::VertexSubset keypoint_vertices_;
+    lbs::KeypointRegressor keypoint_subset_regressor_;
+
+    // Slots of shape_cache_
+    enum ShapeSlot : int {
+        kNoShapeCache = -1,
+        kFullShape = 0,
+        kKeypointShape = 1
+    };
+    mutable ShapeCache shape_cache_;
+    // Autotuned chunk sizes without and with vertices, 0 until known.
+    mutable std::mutex chunk_mutex_;
+    mutable std::array<int64_t, 2> tuned_chunk_{0, 0};
+    std::shared_ptr<ArenaAllocator> arena_;
 
     std::unique_ptr<VertexJointSelector> vertex_joint_selector_;
 };
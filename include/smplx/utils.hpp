@@ -22,6 +22,18 @@ inline auto check_file_ext(const char *path, const char *extension) -> bool {
 
 struct ModelOutput {};
 
+// Per-call parameters of SMPL::forward. Unset tensors fall back to the
+// parameters the model was constructed with.
+struct SMPLInput {
+    std::optional<Tensor> betas;
+    std::optional<Tensor> global_orient;
+    std::optional<Tensor> body_pose;
+    std::optional<Tensor> transl;
+    bool pose2rot = true;
+    bool return_verts = false;
+    bool return_full_pose = false;
+};
+
 struct SMPLOutput {
     std::optional<Tensor> vertices;
     std::optional<Tensor> joints;
@@ -20,7 +20,12 @@ class VertexJointSelector : public torch::nn::Module {
                         const torch::Device device, bool use_hands = true,
                         bool use_feet_keypoints = true);
 
-    auto forward(Tensor &vertices, Tensor &joints) -> Tensor;
+    auto forward(const Tensor &vertices, const Tensor &joints) const -> Tensor;
+
+    // Vertices appended as extra joints, in output order.
+    auto extra_joints_idxs() const -> const Tensor & {
+        return extra_joints_idxs_;
+    }
 };
 } // namespace smplx
 #endif
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 #include "smplx.hpp"
 
@@ -28,20 +29,18 @@ void save_obj(const std::string &filename, const torch::Tensor &vertices,
 double compute_fps(smplx::SMPL &model, const torch::Tensor &betas,
                    const torch::Tensor &global_orient,
                    const torch::Tensor &body_pose, const torch::Tensor &transl,
-                   int iterations = 1000) {
+                   int iterations = 1000, bool return_verts = true) {
     auto start = std::chrono::high_resolution_clock::now();
 
     for (int i = 0; i < iterations; ++i) {
         auto output = model.forward(
             smplx::betas(betas), smplx::global_orient(global_orient),
-            smplx::body_pose(body_pose), smplx::transl(transl));
+            smplx::body_pose(body_pose), smplx::transl(transl),
+            smplx::return_verts(return_verts));
     }
 
     auto end = std::chrono::high_resolution_clock::now();
-    auto duration =
-        std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
-            .count();
-    double seconds = duration / 1000.0;
+    double seconds = std::chrono::duration<double>(end - start).count();
     return iterations / seconds;
 }
 int main(int argc, char *argv[]) {
@@ -85,6 +84,30 @@ int main(int argc, char *argv[]) {
     std::cout << "FPS (forward pass, run " << iterations << " iterations) @"
               << fps << " FPS" << std::endl;
 
+    double joints_fps = compute_fps(smpl, betas, global_orient, body_pose,
+                                    transl, iterations, false);
+    std::cout << "FPS (joints only, run " << iterations << " iterations) @"
+              << joints_fps << " FPS" << std::endl;
+
+    // Default model vs inference-only model (no parameters, no autograd or
+    // version counter bookkeeping) over increasing batch sizes.
+    smplx::SMPL smpl_inference(path.c_str(), device, smplx::inference());
+    std::cout << "batch, default FPS, inference FPS, speedup" << std::endl;
+    for (int64_t batch : {1, 64, 4096}) {
+        auto opts = torch::dtype(torch::kFloat64).device(device);
+        auto b = torch::zeros({batch, smpl.num_betas()}, opts);
+        auto go = torch::zeros({batch, 3}, opts);
+        auto bp = torch::zeros({batch, 69}, opts);
+        auto t = torch::zeros({batch, 3}, opts);
+        const int n = std::max<int64_t>(10, 1000 / batch);
+        compute_fps(smpl, b, go, bp, t, 2);
+        compute_fps(smpl_inference, b, go, bp, t, 2);
+        double default_fps = compute_fps(smpl, b, go, bp, t, n);
+        double inference_fps = compute_fps(smpl_inference, b, go, bp, t, n);
+        std::cout << batch << ", " << default_fps << ", " << inference_fps
+                  << ", " << inference_fps / default_fps << "x" << std::endl;
+    }
+
     auto output =
         smpl.forward(smplx::betas(betas), smplx::global_orient(global_orient),
                      smplx::body_pose(body_pose), smplx::transl(transl),
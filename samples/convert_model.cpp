@@ -0,0 +1,40 @@
+#include <filesystem>
+#include <iostream>
+#include "model_file.hpp"
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model.npz> <model.tsmx> [float32|float64]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string in_path = argv[1];
+    std::string out_path = argv[2];
+    if (!std::filesystem::exists(in_path)) {
+        std::cerr << "Model path does not exist: " << in_path << std::endl;
+        return 1;
+    }
+
+    torch::Dtype dtype = torch::kFloat64;
+    if (argc > 3) {
+        std::string name = argv[3];
+        if (name == "float32") {
+            dtype = torch::kFloat32;
+        } else if (name != "float64") {
+            std::cerr << "Unsupported dtype: " << name << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        smplx::convert_npz_to_model_file(in_path, out_path, dtype);
+    } catch (const std::exception &e) {
+        std::cerr << "Conversion failed: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << out_path << " ("
+              << std::filesystem::file_size(out_path) << " bytes)" << std::endl;
+    return 0;
+}
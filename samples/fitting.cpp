@@ -87,7 +87,8 @@ int main(int argc, char *argv[]) {
         torch::cuda::is_available() ? torch::kCUDA : torch::kCPU;
     std::cout << "Using device: " << device << "\n";
 
-    smplx::SMPL smpl(path.c_str(), device);
+    // On CPU the temporaries of every iteration come from a caching arena.
+    smplx::SMPL smpl(path.c_str(), device, smplx::arena());
     smpl.eval();
 
     const int batch_size = 1;
@@ -164,6 +165,7 @@ int main(int argc, char *argv[]) {
     std::cout << "Starting optimization..." << std::endl;
 
     const int steps = 200;
+    smplx::ArenaGuard arena_guard(smpl.arena());
     for (int i = 0; i < steps; ++i) {
         optimizer.zero_grad();
 
@@ -203,6 +205,14 @@ int main(int argc, char *argv[]) {
 #endif
     }
 
+    if (smpl.arena() != nullptr) {
+        auto stats = smpl.arena()->stats();
+        std::cout << "Arena: " << stats.hits << " hits, " << stats.misses
+                  << " misses, " << stats.bytes_held / (1 << 20)
+                  << " MiB held (peak " << stats.peak_bytes_held / (1 << 20)
+                  << " MiB)" << std::endl;
+    }
+
     auto final_output = smpl.forward(
         smplx::betas(betas.detach()), smplx::global_orient(global_orient),
         smplx::body_pose(body_pose), smplx::transl(transl),
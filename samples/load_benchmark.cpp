@@ -0,0 +1,81 @@
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include "smplx.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+// Reports the time spent in each phase of loading an SMPL .npz model:
+// central directory parsing, reading, inflating, tensor conversion and the
+// full smplx::SMPL construction (plus the legacy sequential cnpy::npz_load
+// for reference).
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <model_path> [iterations]"
+                  << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    if (!std::filesystem::exists(path)) {
+        std::cerr << "Model path does not exist: " << path << std::endl;
+        return 1;
+    }
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 10;
+    auto device = torch::cuda::is_available() ? torch::kCUDA : torch::kCPU;
+
+    double legacy = 0, directory = 0, read = 0, inflate = 0, npz_total = 0,
+           convert = 0, construct = 0;
+    cnpy::npz_load_timings t;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        auto all = cnpy::npz_load(path);
+        legacy += elapsed_ms(start);
+
+        auto data = cnpy::npz_load_selected(
+            path, smplx::SMPL::kRequiredNpzArrays, 0, &t);
+        directory += t.directory_ms;
+        read += t.read_ms;
+        inflate += t.inflate_ms;
+        npz_total += t.total_ms;
+
+        start = Clock::now();
+        for (const auto &kv : data) {
+            auto tensor = cnpyToTensor(kv.second, kv.first == "f"
+                                                      ? torch::kInt64
+                                                      : torch::kFloat64)
+                              .to(device);
+        }
+        convert += elapsed_ms(start);
+
+        start = Clock::now();
+        smplx::SMPL smpl(path.c_str(), device);
+        construct += elapsed_ms(start);
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Arrays loaded: " << t.num_arrays << " ("
+              << t.compressed_bytes / 1e6 << " MB compressed, "
+              << t.uncompressed_bytes / 1e6 << " MB uncompressed)\n";
+    std::cout << "Average over " << iterations << " iterations [ms]\n";
+    std::cout << "  cnpy::npz_load (sequential, all arrays) : "
+              << legacy / iterations << "\n";
+    std::cout << "  npz_load_selected                       : "
+              << npz_total / iterations << "\n";
+    std::cout << "    central directory                     : "
+              << directory / iterations << "\n";
+    std::cout << "    read                                  : "
+              << read / iterations << "\n";
+    std::cout << "    inflate                               : "
+              << inflate / iterations << "\n";
+    std::cout << "  tensor conversion + transfer            : "
+              << convert / iterations << "\n";
+    std::cout << "  smplx::SMPL construction (end to end)   : "
+              << construct / iterations << std::endl;
+    return 0;
+}
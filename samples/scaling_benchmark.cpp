@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "smplx.hpp"
+
+// Throughput and latency of SMPL::forward over a sweep of intra-op thread
+// budgets x batch sizes, one inference-only model per budget (see
+// smplx::execution()).
+//
+//   ./scaling_benchmark <model_path> [--threads 1,2,4] [--batches 1,64,1024]
+//                       [--pin] [--joints] [--csv out.csv] [--json out.json]
+//
+// --pin pins each budget of n threads to CPUs 0..n-1.
+
+namespace {
+struct Result {
+    int threads;
+    int64_t batch;
+    int iterations;
+    double mean_ms, p50_ms, p99_ms;
+    double bodies_per_second;
+    double speedup; // vs the smallest budget at the same batch size
+};
+
+auto parse_list(const std::string &text) -> std::vector<int64_t> {
+    std::vector<int64_t> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        values.push_back(std::stoll(item));
+    }
+    return values;
+}
+
+auto percentile(std::vector<double> samples, double q) -> double {
+    std::sort(samples.begin(), samples.end());
+    const auto i = static_cast<size_t>(q * (samples.size() - 1) + 0.5);
+    return samples[std::min(i, samples.size() - 1)];
+}
+
+auto measure(const smplx::SMPL &smpl, int64_t batch, bool return_verts)
+    -> Result {
+    auto opts = torch::dtype(smpl.compute_dtype());
+    smplx::SMPLInput input;
+    input.betas = torch::randn({batch, 10}, opts);
+    input.global_orient = torch::randn({batch, 3}, opts) * 0.3;
+    input.body_pose = torch::randn({batch, 69}, opts) * 0.3;
+    input.transl = torch::zeros({batch, 3}, opts);
+    input.return_verts = return_verts;
+
+    for (int i = 0; i < 3; ++i) {
+        smpl.forward(input);
+    }
+    // Roughly 0.1 s per point, at least 10 calls.
+    auto start = std::chrono::steady_clock::now();
+    smpl.forward(input);
+    const double once = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    const int iterations = std::clamp(static_cast<int>(0.1 / once), 10, 10000);
+
+    std::vector<double> latencies;
+    latencies.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        smpl.forward(input);
+        latencies.push_back(std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - t0)
+                                .count());
+    }
+    double total = 0;
+    for (double l : latencies) {
+        total += l;
+    }
+    Result r{};
+    r.batch = batch;
+    r.iterations = iterations;
+    r.mean_ms = total / iterations;
+    r.p50_ms = percentile(latencies, 0.5);
+    r.p99_ms = percentile(latencies, 0.99);
+    r.bodies_per_second = batch * 1e3 / r.mean_ms;
+    return r;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <model_path> [--threads 1,2,4] [--batches 1,64,1024]"
+                     " [--pin] [--joints] [--csv out.csv] [--json out.json]"
+                  << std::endl;
+        return 1;
+    }
+    const std::string path = argv[1];
+    std::vector<int64_t> threads;
+    for (int64_t n = 1; n <= std::max(1u, std::thread::hardware_concurrency());
+         n *= 2) {
+        threads.push_back(n);
+    }
+    std::vector<int64_t> batches = {1, 16, 64, 256, 1024, 4096};
+    std::string csv_path = "scaling.csv", json_path = "scaling.json";
+    bool pin = false, return_verts = true;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = parse_list(argv[++i]);
+        } else if (arg == "--batches" && i + 1 < argc) {
+            batches = parse_list(argv[++i]);
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "--pin") {
+            pin = true;
+        } else if (arg == "--joints") {
+            return_verts = false;
+        } else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    torch::NoGradGuard no_grad;
+    auto data = smplx::ModelRegistry::instance().get(
+        {path, "neutral", torch::kFloat64, torch::kCPU});
+
+    std::vector<Result> results;
+    std::cout << "threads, batch, mean ms, p50 ms, p99 ms, bodies/s, speedup"
+              << std::endl;
+    for (auto n : threads) {
+        smplx::ExecutionSettings settings;
+        settings.num_threads = static_cast<int>(n);
+        if (pin) {
+            for (int cpu = 0; cpu < n; ++cpu) {
+                settings.cpu_affinity.push_back(cpu);
+            }
+        }
+        smplx::SMPL smpl(data, smplx::inference(),
+                         smplx::execution(settings));
+        for (auto batch : batches) {
+            auto r = measure(smpl, batch, return_verts);
+            r.threads = static_cast<int>(n);
+            auto base = std::find_if(
+                results.begin(), results.end(),
+                [&](const Result &other) { return other.batch == batch; });
+            r.speedup = base == results.end()
+                            ? 1.0
+                            : r.bodies_per_second / base->bodies_per_second;
+            results.push_back(r);
+            std::cout << r.threads << ", " << r.batch << ", " << r.mean_ms
+                      << ", " << r.p50_ms << ", " << r.p99_ms << ", "
+                      << r.bodies_per_second << ", " << r.speedup << "x"
+                      << std::endl;
+        }
+    }
+
+    std::ofstream csv(csv_path);
+    csv << "threads,batch,iterations,mean_ms,p50_ms,p99_ms,bodies_per_second,"
+           "speedup\n";
+    for (const auto &r : results) {
+        csv << r.threads << "," << r.batch << "," << r.iterations << ","
+            << r.mean_ms << "," << r.p50_ms << "," << r.p99_ms << ","
+            << r.bodies_per_second << "," << r.speedup << "\n";
+    }
+
+    std::ofstream json(json_path);
+    json << "{\n  \"model\": \"" << path << "\",\n  \"return_verts\": "
+         << std::boolalpha << return_verts << ",\n  \"pinned\": " << pin
+         << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &r = results[i];
+        json << "    {\"threads\": " << r.threads << ", \"batch\": " << r.batch
+             << ", \"iterations\": " << r.iterations
+             << ", \"mean_ms\": " << r.mean_ms << ", \"p50_ms\": " << r.p50_ms
+             << ", \"p99_ms\": " << r.p99_ms
+             << ", \"bodies_per_second\": " << r.bodies_per_second
+             << ", \"speedup\": " << r.speedup << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+    std::cout << "Wrote " << csv_path << " and " << json_path << std::endl;
+    return 0;
+}
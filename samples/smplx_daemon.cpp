@@ -0,0 +1,83 @@
+#include <csignal>
+#include <iostream>
+#include "daemon.hpp"
+
+// Local inference daemon: loads inference-only models once and serves them
+// to the processes of this machine through smplx::DaemonClient.
+//
+//   ./smplx_daemon --socket /tmp/smplx.sock --model neutral=SMPL_NEUTRAL.npz
+//                  [--model male=SMPL_MALE.npz] [--workers 1]
+//                  [--max-batch 64] [--max-wait-us 500] [--socket-mode 600]
+//
+// --socket-mode (octal) decides who may connect; the default lets only the
+// user running the daemon in.
+//
+// Runs until SIGINT or SIGTERM, then prints the batching stats per model.
+
+int main(int argc, char *argv[]) {
+    std::string socket_path = "/tmp/smplx.sock";
+    std::vector<std::pair<std::string, std::string>> models;
+    smplx::ExecutorOptions options;
+    mode_t socket_mode = 0600;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--model" && i + 1 < argc) {
+            const std::string spec = argv[++i];
+            const auto eq = spec.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                std::cerr << "--model expects name=path, got " << spec << "\n";
+                return 1;
+            }
+            models.emplace_back(spec.substr(0, eq), spec.substr(eq + 1));
+        } else if (arg == "--socket-mode" && i + 1 < argc) {
+            socket_mode =
+                static_cast<mode_t>(std::stoul(argv[++i], nullptr, 8));
+        } else if (arg == "--workers" && i + 1 < argc) {
+            options.num_workers = std::stoi(argv[++i]);
+        } else if (arg == "--max-batch" && i + 1 < argc) {
+            options.max_batch = std::stoll(argv[++i]);
+        } else if (arg == "--max-wait-us" && i + 1 < argc) {
+            options.max_wait = std::chrono::microseconds(std::stoll(argv[++i]));
+        } else {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return 1;
+        }
+    }
+    if (models.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --socket <path> --model <name>=<model_path> ..."
+                  << std::endl;
+        return 1;
+    }
+
+    // Block the signals in every thread; the main thread waits for them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    smplx::DaemonServer server(socket_path, options, socket_mode);
+    for (const auto &[name, path] : models) {
+        server.add_model(name, std::make_shared<const smplx::SMPL>(
+                                   path, torch::kCPU, smplx::inference()));
+        std::cout << "Loaded " << name << " from " << path << "\n";
+    }
+    server.start();
+    std::cout << "Serving on " << socket_path << std::endl;
+
+    int signal = 0;
+    sigwait(&signals, &signal);
+    server.stop();
+
+    for (const auto &[name, path] : models) {
+        const auto stats = server.stats(name);
+        std::cout << name << ": " << stats.requests << " requests in "
+                  << stats.batches << " forwards, mean batch "
+                  << stats.mean_batch_size << ", p50 " << stats.p50_ms
+                  << " ms, p99 " << stats.p99_ms << " ms\n";
+    }
+    return 0;
+}
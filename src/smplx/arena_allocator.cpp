@@ -0,0 +1,203 @@
+#include "arena_allocator.hpp"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "c10/core/CPUAllocator.h"
+#include "c10/core/impl/alloc_cpu.h"
+
+namespace smplx {
+namespace {
+// Block layout: [BlockHeader, padded to 64 bytes][data]. The data keeps
+// c10's 64-byte alignment, and the DataPtr context is the block start, so
+// that raw_allocate() (which needs data == context) fails loudly instead of
+// freeing an arena block with the system deleter.
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kMinBucket = 512;
+
+thread_local ArenaAllocator *current_arena = nullptr;
+
+// Installed once as the process CPU allocator: forwards to the arena of the
+// calling thread, if any, else to the allocator it replaced.
+class RoutingAllocator final : public c10::Allocator {
+  public:
+    explicit RoutingAllocator(c10::Allocator *base) : base_(base) {}
+
+    auto allocate(size_t n) -> c10::DataPtr override {
+        if (current_arena != nullptr) {
+            return current_arena->allocate(n);
+        }
+        return base_->allocate(n);
+    }
+    // For raw allocations outside a guard; inside one, raw_allocate()
+    // asserts on the arena's DataPtr before this could be used on it.
+    auto raw_deleter() const -> c10::DeleterFnPtr override {
+        return base_->raw_deleter();
+    }
+    void copy_data(void *dest, const void *src, size_t count) const override {
+        base_->copy_data(dest, src, count);
+    }
+
+  private:
+    c10::Allocator *base_;
+};
+
+auto install_routing_allocator() -> void {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        static RoutingAllocator router(c10::GetCPUAllocator());
+        c10::SetCPUAllocator(&router, /*priority=*/UINT8_MAX);
+    });
+}
+} // namespace
+
+struct ArenaAllocator::State {
+    std::mutex mutex;
+    std::unordered_map<size_t, std::vector<void *>> free_blocks;
+    Stats stats;
+    size_t max_bytes_held{SIZE_MAX};
+    int64_t live_blocks{0};
+    // Set when the allocator is destroyed with blocks still alive: the last
+    // of them releases the state.
+    std::shared_ptr<State> self;
+    bool closed{false};
+};
+
+namespace {
+struct BlockHeader {
+    ArenaAllocator::State *state;
+    size_t bucket;
+};
+static_assert(sizeof(BlockHeader) <= kHeaderSize, "header too large");
+
+void free_block(void *ctx) {
+    auto *header = static_cast<BlockHeader *>(ctx);
+    auto *state = header->state;
+    const auto bucket = header->bucket;
+
+    bool release = false;
+    std::shared_ptr<ArenaAllocator::State> last_ref;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->stats.bytes_in_use -= bucket;
+        --state->live_blocks;
+        if (state->closed || state->stats.bytes_held > state->max_bytes_held) {
+            state->stats.bytes_held -= bucket;
+            release = true;
+        } else {
+            state->free_blocks[bucket].push_back(ctx);
+        }
+        if (state->closed && state->live_blocks == 0) {
+            last_ref = std::move(state->self);
+        }
+    }
+    if (release) {
+        c10::free_cpu(ctx);
+    }
+}
+} // namespace
+
+ArenaAllocator::ArenaAllocator(size_t max_bytes_held)
+    : state_(std::make_shared<State>()) {
+    state_->max_bytes_held = max_bytes_held;
+}
+
+ArenaAllocator::~ArenaAllocator() {
+    release_cached();
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->closed = true;
+    if (state_->live_blocks > 0) {
+        state_->self = state_;
+    }
+}
+
+auto ArenaAllocator::bucket_size(size_t n) -> size_t {
+    if (n <= kMinBucket) {
+        return kMinBucket;
+    }
+    // Four buckets per power of two.
+    size_t p = size_t(1) << (63 - __builtin_clzll(n));
+    const size_t step = p / 4;
+    return (n + step - 1) / step * step;
+}
+
+auto ArenaAllocator::allocate(size_t n) -> c10::DataPtr {
+    const c10::Device device(c10::DeviceType::CPU);
+    if (n == 0) {
+        return c10::DataPtr(nullptr, nullptr, &free_block, device);
+    }
+    const auto bucket = bucket_size(n);
+    void *block = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        auto &stats = state_->stats;
+        auto it = state_->free_blocks.find(bucket);
+        if (it != state_->free_blocks.end() && !it->second.empty()) {
+            block = it->second.back();
+            it->second.pop_back();
+            ++stats.hits;
+        } else {
+            ++stats.misses;
+            stats.bytes_held += bucket;
+            stats.peak_bytes_held =
+                std::max(stats.peak_bytes_held, stats.bytes_held);
+        }
+        stats.bytes_in_use += bucket;
+        ++state_->live_blocks;
+    }
+    if (block == nullptr) {
+        block = c10::alloc_cpu(kHeaderSize + bucket);
+        *static_cast<BlockHeader *>(block) = {state_.get(), bucket};
+    }
+    return c10::DataPtr(static_cast<char *>(block) + kHeaderSize, block,
+                        &free_block, device);
+}
+
+void ArenaAllocator::copy_data(void *dest, const void *src,
+                               size_t count) const {
+    std::memcpy(dest, src, count);
+}
+
+auto ArenaAllocator::stats() const -> Stats {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->stats;
+}
+
+auto ArenaAllocator::reset_stats() -> void {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    auto &stats = state_->stats;
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.peak_bytes_held = stats.bytes_held;
+}
+
+auto ArenaAllocator::release_cached() -> void {
+    std::vector<void *> blocks;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        for (auto &[bucket, list] : state_->free_blocks) {
+            state_->stats.bytes_held -= bucket * list.size();
+            blocks.insert(blocks.end(), list.begin(), list.end());
+        }
+        state_->free_blocks.clear();
+    }
+    for (auto *block : blocks) {
+        c10::free_cpu(block);
+    }
+}
+
+ArenaGuard::ArenaGuard(ArenaAllocator *arena)
+    : previous_(current_arena), active_(arena != nullptr) {
+    if (active_) {
+        install_routing_allocator();
+        current_arena = arena;
+    }
+}
+
+ArenaGuard::~ArenaGuard() {
+    if (active_) {
+        current_arena = previous_;
+    }
+}
+} // namespace smplx
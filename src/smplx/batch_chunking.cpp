@@ -0,0 +1,103 @@
+#include "batch_chunking.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace smplx {
+
+const std::vector<int64_t> kChunkCandidates = {64, 128, 256, 512, 1024, 2048};
+
+namespace {
+auto read_entries(const std::string &path) -> std::map<std::string, int64_t> {
+    std::map<std::string, int64_t> entries;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        int64_t chunk = 0;
+        if (fields >> key >> chunk && chunk > 0) {
+            entries[key] = chunk;
+        }
+    }
+    return entries;
+}
+} // namespace
+
+auto chunk_cache_path() -> std::string {
+    std::filesystem::path dir;
+    if (const char *env = std::getenv("SMPLX_CACHE_DIR")) {
+        dir = env;
+    } else if (const char *xdg = std::getenv("XDG_CACHE_HOME")) {
+        dir = std::filesystem::path(xdg) / "smplx";
+    } else if (const char *home = std::getenv("HOME")) {
+        dir = std::filesystem::path(home) / ".cache" / "smplx";
+    } else {
+        return "";
+    }
+    return (dir / "batch_chunks.txt").string();
+}
+
+auto load_chunk_size(const std::string &path, const std::string &key)
+    -> std::optional<int64_t> {
+    if (path.empty()) {
+        return std::nullopt;
+    }
+    const auto entries = read_entries(path);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+auto store_chunk_size(const std::string &path, const std::string &key,
+                      int64_t chunk_size) -> void {
+    if (path.empty()) {
+        return;
+    }
+    try {
+        std::filesystem::create_directories(
+            std::filesystem::path(path).parent_path());
+        auto entries = read_entries(path);
+        entries[key] = chunk_size;
+        const auto tmp = path + ".tmp";
+        {
+            std::ofstream file(tmp, std::ios::trunc);
+            for (const auto &[k, chunk] : entries) {
+                file << k << " " << chunk << "\n";
+            }
+            if (!file) {
+                throw std::runtime_error("write failed");
+            }
+        }
+        std::filesystem::rename(tmp, path);
+    } catch (const std::exception &e) {
+        std::cerr << "[WARNING] Could not store the batch chunk size in "
+                  << path << ": " << e.what() << std::endl;
+    }
+}
+
+auto autotune_chunk_size(const std::vector<int64_t> &candidates,
+                         const std::function<double(int64_t)> &seconds_per_body)
+    -> int64_t {
+    std::vector<double> times;
+    times.reserve(candidates.size());
+    double best = 0;
+    for (auto chunk : candidates) {
+        times.push_back(seconds_per_body(chunk));
+        if (times.size() == 1 || times.back() < best) {
+            best = times.back();
+        }
+    }
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (times[i] <= best * 1.03) {
+            return candidates[i];
+        }
+    }
+    return candidates.back();
+}
+} // namespace smplx
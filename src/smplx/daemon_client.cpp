@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "daemon.hpp"
+
+namespace smplx {
+struct DaemonClient::State {
+    int fd{-1};
+    char *ring{nullptr};
+    size_t ring_bytes{0};
+    ipc::SlotLayout layout;
+    int64_t max_rows{0};
+    int64_t num_joints{0};
+    int64_t num_vertices{0};
+    torch::ScalarType dtype{torch::kFloat64};
+
+    std::mutex mutex;
+    std::condition_variable slot_freed;
+    std::vector<uint32_t> free_slots;
+    // Requests in flight by slot, with what their outputs are made of.
+    struct Pending {
+        std::promise<SMPLOutput> promise;
+        SMPLOutput output;
+        int64_t rows{0};
+        bool return_verts{false};
+    };
+    std::map<uint32_t, Pending> pending;
+    bool broken{false};
+
+    ~State() {
+        if (ring != nullptr) {
+            munmap(ring, ring_bytes);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    auto slot_data(uint32_t slot, size_t offset) -> char * {
+        return ring + slot * layout.bytes + offset;
+    }
+
+    auto release(uint32_t slot) -> void {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_slots.push_back(slot);
+        }
+        slot_freed.notify_one();
+    }
+};
+
+DaemonClient::DaemonClient(const std::string &socket_path,
+                           const std::string &model,
+                           DaemonClientOptions options)
+    : state_(std::make_shared<State>()) {
+    TORCH_CHECK(options.max_rows > 0 && options.num_slots > 0 &&
+                    options.max_rows <= ipc::kMaxRows &&
+                    options.num_slots <= ipc::kMaxSlots,
+                "DaemonClient: max_rows must be in [1, ", ipc::kMaxRows,
+                "] and num_slots in [1, ", ipc::kMaxSlots, "]");
+    TORCH_CHECK(model.size() < sizeof(ipc::Hello::model),
+                "DaemonClient: model name too long");
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    TORCH_CHECK(socket_path.size() < sizeof(addr.sun_path),
+                "DaemonClient: socket path too long");
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    auto &s = *state_;
+    s.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    TORCH_CHECK(s.fd >= 0, "DaemonClient: socket: ", strerror(errno));
+    TORCH_CHECK(
+        connect(s.fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0,
+        "DaemonClient: cannot connect to ", socket_path, ": ",
+        strerror(errno));
+
+    ipc::Hello hello;
+    std::strcpy(hello.model, model.c_str());
+    hello.max_rows = static_cast<uint32_t>(options.max_rows);
+    hello.num_slots = static_cast<uint32_t>(options.num_slots);
+    ipc::HelloReply reply;
+    int ring_fd = -1;
+    TORCH_CHECK(ipc::send_all(s.fd, &hello, sizeof(hello)) &&
+                    ipc::recv_with_fd(s.fd, &reply, sizeof(reply), &ring_fd),
+                "DaemonClient: handshake with ", socket_path, " failed");
+    if (reply.status != 0 || ring_fd < 0) {
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+        reply.error[sizeof(reply.error) - 1] = '\0';
+        TORCH_CHECK(false, "DaemonClient: ", reply.error);
+    }
+
+    s.dtype = static_cast<torch::ScalarType>(reply.dtype);
+    s.max_rows = options.max_rows;
+    s.num_joints = reply.num_joints;
+    s.num_vertices = reply.num_vertices;
+    s.layout = ipc::SlotLayout::make(options.max_rows, reply.num_betas,
+                                     reply.num_vertices, reply.num_joints,
+                                     c10::elementSize(s.dtype));
+    s.ring_bytes = reply.ring_bytes;
+    void *ring = mmap(nullptr, s.ring_bytes, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, ring_fd, 0);
+    close(ring_fd);
+    TORCH_CHECK(ring != MAP_FAILED, "DaemonClient: cannot map the ring");
+    s.ring = static_cast<char *>(ring);
+    TORCH_CHECK(s.layout.ring_bytes(options.num_slots) == s.ring_bytes,
+                "DaemonClient: unexpected ring size");
+    for (int64_t i = options.num_slots - 1; i >= 0; --i) {
+        s.free_slots.push_back(static_cast<uint32_t>(i));
+    }
+
+    num_betas_ = reply.num_betas;
+    num_vertices_ = reply.num_vertices;
+    dtype_ = s.dtype;
+    receiver_ = std::thread([this] { receive_loop(); });
+}
+
+DaemonClient::~DaemonClient() {
+    // Pending requests fail; the mapping lives on in returned tensors.
+    shutdown(state_->fd, SHUT_RDWR);
+    receiver_.join();
+}
+
+auto DaemonClient::submit(const SMPLInput &input) -> std::future<SMPLOutput> {
+    auto &s = *state_;
+    int64_t rows = 1;
+    for (const auto *t : {&input.betas, &input.global_orient, &input.body_pose,
+                          &input.transl}) {
+        if (t->has_value() && (*t)->dim() > 1) {
+            rows = std::max(rows, (*t)->size(0));
+        }
+    }
+    TORCH_CHECK(rows <= s.max_rows, "DaemonClient: ", rows,
+                " bodies exceed the ", s.max_rows,
+                " rows of a slot (see DaemonClientOptions)");
+
+    uint32_t slot;
+    {
+        std::unique_lock<std::mutex> lock(s.mutex);
+        s.slot_freed.wait(lock,
+                          [&] { return s.broken || !s.free_slots.empty(); });
+        TORCH_CHECK(!s.broken, "DaemonClient: connection lost");
+        slot = s.free_slots.back();
+        s.free_slots.pop_back();
+    }
+
+    // Parameters straight into the slot, converted and broadcast over the
+    // rows; missing ones are zero.
+    const int64_t width = input.pose2rot ? 3 : 9;
+    auto write = [&](const std::optional<Tensor> &t, size_t offset,
+                     int64_t per_row) {
+        auto dest = torch::from_blob(s.slot_data(slot, offset), {rows, per_row},
+                                     torch::dtype(s.dtype));
+        if (t.has_value()) {
+            dest.copy_(t->reshape({-1, per_row}).expand({rows, per_row}));
+        } else {
+            dest.zero_();
+        }
+    };
+    try {
+        write(input.betas, s.layout.betas, num_betas_);
+        write(input.global_orient, s.layout.global_orient, width);
+        write(input.body_pose, s.layout.body_pose,
+              SMPL::NUM_BODY_JOINTS * width);
+        write(input.transl, s.layout.transl, 3);
+    } catch (...) {
+        s.release(slot);
+        throw;
+    }
+
+    // The outputs handed back to the caller: the inputs as given (like
+    // SMPL::forward) and, filled in on completion, views of the slot.
+    State::Pending pending;
+    pending.rows = rows;
+    pending.return_verts = input.return_verts;
+    auto view = [&](size_t offset, int64_t per_row) {
+        return torch::from_blob(s.slot_data(slot, offset), {rows, per_row},
+                                torch::dtype(s.dtype))
+            .clone();
+    };
+    pending.output.global_orient = view(s.layout.global_orient, width);
+    pending.output.body_pose =
+        view(s.layout.body_pose, SMPL::NUM_BODY_JOINTS * width);
+    pending.output.betas = view(s.layout.betas, num_betas_);
+    pending.output.transl = view(s.layout.transl, 3);
+    if (input.return_full_pose) {
+        pending.output.full_pose = torch::cat(
+            {*pending.output.global_orient, *pending.output.body_pose}, 1);
+    }
+    auto future = pending.promise.get_future();
+
+    ipc::Request request;
+    request.slot = slot;
+    request.rows = static_cast<uint32_t>(rows);
+    request.pose2rot = input.pose2rot ? 1 : 0;
+    request.return_verts = input.return_verts ? 1 : 0;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.pending.emplace(slot, std::move(pending));
+        if (!ipc::send_all(s.fd, &request, sizeof(request))) {
+            s.broken = true;
+        }
+    }
+    return future;
+}
+
+auto DaemonClient::receive_loop() -> void {
+    auto state = state_;
+    auto &s = *state;
+    ipc::Response response;
+    while (ipc::recv_all(s.fd, &response, sizeof(response))) {
+        State::Pending pending;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            auto it = s.pending.find(response.slot);
+            if (it == s.pending.end()) {
+                continue;
+            }
+            pending = std::move(it->second);
+            s.pending.erase(it);
+        }
+        if (response.status != 0) {
+            s.release(response.slot);
+            response.error[sizeof(response.error) - 1] = '\0';
+            pending.promise.set_exception(std::make_exception_ptr(
+                std::runtime_error(std::string("smplx daemon: ") +
+                                   response.error)));
+            continue;
+        }
+
+        // The slot returns to the free list once every output view of it
+        // is gone.
+        const auto slot = response.slot;
+        auto lease = std::shared_ptr<void>(
+            nullptr, [state, slot](void *) { state->release(slot); });
+        auto view = [&](size_t offset, std::vector<int64_t> sizes) {
+            return torch::from_blob(
+                s.slot_data(slot, offset), sizes,
+                [lease](void *) {}, torch::dtype(s.dtype));
+        };
+        pending.output.joints =
+            view(s.layout.joints, {pending.rows, s.num_joints, 3});
+        if (pending.return_verts) {
+            pending.output.vertices =
+                view(s.layout.vertices, {pending.rows, s.num_vertices, 3});
+        }
+        lease.reset();
+        pending.promise.set_value(std::move(pending.output));
+    }
+
+    // Connection closed: fail what is in flight and wake blocked submits.
+    std::map<uint32_t, State::Pending> failed;
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.broken = true;
+        failed.swap(s.pending);
+    }
+    s.slot_freed.notify_all();
+    for (auto &[slot, pending] : failed) {
+        pending.promise.set_exception(std::make_exception_ptr(
+            std::runtime_error("smplx daemon: connection lost")));
+    }
+}
+} // namespace smplx
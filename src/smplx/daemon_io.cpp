@@ -0,0 +1,142 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "daemon.hpp"
+
+namespace smplx::ipc {
+namespace {
+constexpr size_t kAlignment = 64;
+
+auto align(size_t offset) -> size_t {
+    return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+} // namespace
+
+auto SlotLayout::make(int64_t max_rows, int64_t num_betas,
+                      int64_t num_vertices, int64_t num_joints,
+                      size_t element_size) -> SlotLayout {
+    TORCH_CHECK(max_rows >= 0 && num_betas >= 0 && num_vertices >= 0 &&
+                    num_joints >= 0,
+                "SlotLayout: negative size");
+    SlotLayout layout;
+    size_t offset = 0;
+    auto section = [&](int64_t per_row) {
+        const auto start = offset;
+        size_t bytes, end;
+        TORCH_CHECK(!__builtin_mul_overflow(static_cast<size_t>(max_rows),
+                                            static_cast<size_t>(per_row),
+                                            &bytes) &&
+                        !__builtin_mul_overflow(bytes, element_size, &bytes) &&
+                        !__builtin_add_overflow(offset, bytes, &end) &&
+                        end <= SIZE_MAX - kAlignment,
+                    "SlotLayout: slot size overflows");
+        offset = align(end);
+        return start;
+    };
+    layout.betas = section(num_betas);
+    layout.global_orient = section(9);
+    layout.body_pose = section(SMPL::NUM_BODY_JOINTS * 9);
+    layout.transl = section(3);
+    layout.vertices = section(num_vertices * 3);
+    layout.joints = section(num_joints * 3);
+    layout.bytes = offset;
+    return layout;
+}
+
+auto SlotLayout::ring_bytes(uint64_t num_slots) const
+    -> std::optional<size_t> {
+    size_t total;
+    if (__builtin_mul_overflow(bytes, num_slots, &total) ||
+        total > kMaxRingBytes) {
+        return std::nullopt;
+    }
+    return total;
+}
+
+auto send_all(int fd, const void *data, size_t size) -> bool {
+    const auto *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        const auto n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+auto recv_all(int fd, void *data, size_t size) -> bool {
+    auto *bytes = static_cast<char *>(data);
+    while (size > 0) {
+        const auto n = ::recv(fd, bytes, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+auto send_with_fd(int fd, const void *data, size_t size, int attached)
+    -> bool {
+    iovec iov{const_cast<void *>(data), size};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &attached, sizeof(int));
+
+    ssize_t n;
+    do {
+        n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return false;
+    }
+    // The descriptor went with the first byte; the rest is plain data.
+    return send_all(fd, static_cast<const char *>(data) + n, size - n);
+}
+
+auto recv_with_fd(int fd, void *data, size_t size, int *attached) -> bool {
+    *attached = -1;
+    iovec iov{data, size};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        return false;
+    }
+    for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(attached, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    return recv_all(fd, static_cast<char *>(data) + n, size - n);
+}
+} // namespace smplx::ipc
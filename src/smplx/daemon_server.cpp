@@ -0,0 +1,342 @@
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "daemon.hpp"
+
+namespace smplx {
+namespace {
+auto copy_error(char (&dest)[128], const std::string &message) -> void {
+    std::strncpy(dest, message.c_str(), sizeof(dest) - 1);
+    dest[sizeof(dest) - 1] = '\0';
+}
+} // namespace
+
+// One connected client: its ring and the two threads serving it. The reader
+// turns requests into Executor submissions on views of the ring; the writer
+// waits for them in order, copies the outputs into the slots and answers.
+struct DaemonServer::Session {
+    int fd{-1};
+    const Model *model{nullptr};
+    torch::ScalarType dtype{torch::kFloat64};
+    int64_t num_betas{0};
+    ipc::SlotLayout layout;
+    uint32_t max_rows{0};
+    uint32_t num_slots{0};
+    char *ring{nullptr};
+    size_t ring_bytes{0};
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::pair<ipc::Request, std::future<SMPLOutput>>> pending;
+    bool closed{false};
+    std::atomic<bool> finished{false};
+    std::thread reader, writer;
+
+    ~Session() {
+        if (ring != nullptr) {
+            munmap(ring, ring_bytes);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    auto view(const ipc::Request &request, size_t offset, int64_t per_row)
+        -> Tensor {
+        return torch::from_blob(
+            ring + request.slot * layout.bytes + offset,
+            {static_cast<int64_t>(request.rows), per_row}, torch::dtype(dtype));
+    }
+
+    // Reads the hello and answers with the ring; false if the client is
+    // refused or gone.
+    auto handshake(const std::map<std::string, Model> &models) -> bool {
+        // A silent client is dropped after kHandshakeTimeout.
+        timeval timeout{};
+        timeout.tv_sec = static_cast<time_t>(ipc::kHandshakeTimeout.count());
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ipc::Hello hello;
+        ipc::HelloReply reply;
+        int ring_fd = -1;
+        try {
+            TORCH_CHECK(ipc::recv_all(fd, &hello, sizeof(hello)),
+                        "no hello");
+            TORCH_CHECK(hello.magic == ipc::kMagic &&
+                            hello.version == ipc::kVersion,
+                        "protocol mismatch");
+            hello.model[sizeof(hello.model) - 1] = '\0';
+            auto it = models.find(hello.model);
+            TORCH_CHECK(it != models.end(), "unknown model '", hello.model,
+                        "'");
+            TORCH_CHECK(hello.max_rows > 0 && hello.num_slots > 0 &&
+                            hello.max_rows <= ipc::kMaxRows &&
+                            hello.num_slots <= ipc::kMaxSlots,
+                        "max_rows must be in [1, ", ipc::kMaxRows,
+                        "] and num_slots in [1, ", ipc::kMaxSlots, "]");
+            const auto &smpl = *it->second.smpl;
+            model = &it->second;
+            dtype = smpl.compute_dtype();
+            num_betas = smpl.num_betas();
+            max_rows = hello.max_rows;
+            num_slots = hello.num_slots;
+            layout = ipc::SlotLayout::make(hello.max_rows, smpl.num_betas(),
+                                           smpl.num_verts(), model->num_joints,
+                                           c10::elementSize(dtype));
+            const auto bytes = layout.ring_bytes(hello.num_slots);
+            TORCH_CHECK(bytes.has_value(), "a ring of ", hello.num_slots,
+                        " slots of ", hello.max_rows,
+                        " bodies exceeds the limit of ", ipc::kMaxRingBytes,
+                        " bytes");
+            ring_bytes = *bytes;
+
+            ring_fd = memfd_create("smplx-ring", MFD_CLOEXEC);
+            TORCH_CHECK(ring_fd >= 0 && ftruncate(ring_fd, ring_bytes) == 0,
+                        "cannot create the ring: ", strerror(errno));
+            void *mapped = mmap(nullptr, ring_bytes, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, ring_fd, 0);
+            TORCH_CHECK(mapped != MAP_FAILED, "cannot map the ring: ",
+                        strerror(errno));
+            ring = static_cast<char *>(mapped);
+
+            reply.dtype = static_cast<int32_t>(dtype);
+            reply.num_betas = smpl.num_betas();
+            reply.num_vertices = smpl.num_verts();
+            reply.num_joints = model->num_joints;
+            reply.ring_bytes = ring_bytes;
+        } catch (const std::exception &e) {
+            reply.status = 1;
+            copy_error(reply.error, e.what());
+        }
+
+        const bool sent =
+            reply.status == 0
+                ? ipc::send_with_fd(fd, &reply, sizeof(reply), ring_fd)
+                : ipc::send_all(fd, &reply, sizeof(reply));
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+        // Requests may then take as long as they like to come.
+        timeout = {};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        return reply.status == 0 && sent;
+    }
+
+    auto read_requests() -> void {
+        ipc::Request request;
+        while (ipc::recv_all(fd, &request, sizeof(request))) {
+            std::future<SMPLOutput> result;
+            if (request.slot >= num_slots || request.rows == 0 ||
+                request.rows > max_rows) {
+                std::promise<SMPLOutput> invalid;
+                invalid.set_exception(std::make_exception_ptr(
+                    std::runtime_error("invalid slot or row count")));
+                result = invalid.get_future();
+            } else {
+                const int64_t width = request.pose2rot ? 3 : 9;
+                SMPLInput input;
+                input.betas = view(request, layout.betas, num_betas);
+                input.global_orient =
+                    view(request, layout.global_orient, width);
+                input.body_pose = view(request, layout.body_pose,
+                                       SMPL::NUM_BODY_JOINTS * width);
+                input.transl = view(request, layout.transl, 3);
+                input.pose2rot = request.pose2rot != 0;
+                input.return_verts = request.return_verts != 0;
+                result = model->executor->submit(std::move(input));
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.emplace_back(request, std::move(result));
+            }
+            ready.notify_one();
+        }
+        close_requests();
+    }
+
+    // No more requests: the writer finishes once the queued ones are
+    // answered.
+    auto close_requests() -> void {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        ready.notify_one();
+    }
+
+    auto write_responses() -> void {
+        while (true) {
+            std::pair<ipc::Request, std::future<SMPLOutput>> item;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return closed || !pending.empty(); });
+                if (pending.empty()) {
+                    break;
+                }
+                item = std::move(pending.front());
+                pending.pop_front();
+            }
+            const auto &request = item.first;
+            ipc::Response response;
+            response.slot = request.slot;
+            try {
+                auto out = item.second.get();
+                const auto num_joints = model->num_joints;
+                view(request, layout.joints, num_joints * 3)
+                    .copy_(out.joints->reshape({request.rows, -1}));
+                if (request.return_verts) {
+                    view(request, layout.vertices,
+                         out.vertices->size(1) * 3)
+                        .copy_(out.vertices->reshape({request.rows, -1}));
+                }
+            } catch (const std::exception &e) {
+                response.status = 1;
+                copy_error(response.error, e.what());
+            }
+            // A vanished client is noticed by the reader.
+            ipc::send_all(fd, &response, sizeof(response));
+        }
+        finished = true;
+    }
+};
+
+DaemonServer::DaemonServer(std::string socket_path,
+                           ExecutorOptions executor_options,
+                           mode_t socket_mode)
+    : socket_path_(std::move(socket_path)),
+      executor_options_(executor_options), socket_mode_(socket_mode) {}
+
+DaemonServer::~DaemonServer() { stop(); }
+
+auto DaemonServer::add_model(const std::string &name,
+                             std::shared_ptr<const SMPL> model) -> void {
+    TORCH_CHECK(!running_, "DaemonServer: add_model after start");
+    TORCH_CHECK(name.size() < sizeof(ipc::Hello::model),
+                "DaemonServer: model name too long");
+    // Joints per body in the outputs (kinematic joints and keypoints).
+    torch::NoGradGuard no_grad;
+    auto opts = torch::dtype(model->compute_dtype());
+    SMPLInput probe;
+    probe.betas = torch::zeros({1, model->num_betas()}, opts);
+    probe.global_orient = torch::zeros({1, 3}, opts);
+    probe.body_pose = torch::zeros({1, SMPL::NUM_BODY_JOINTS * 3}, opts);
+    probe.transl = torch::zeros({1, 3}, opts);
+
+    Model entry;
+    entry.num_joints = model->forward(probe).joints->size(1);
+    entry.executor = std::make_unique<Executor>(model, executor_options_);
+    entry.smpl = std::move(model);
+    models_[name] = std::move(entry);
+}
+
+auto DaemonServer::start() -> void {
+    TORCH_CHECK(!running_, "DaemonServer: already started");
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    TORCH_CHECK(socket_path_.size() < sizeof(addr.sun_path),
+                "DaemonServer: socket path too long");
+    std::strcpy(addr.sun_path, socket_path_.c_str());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    TORCH_CHECK(listen_fd_ >= 0, "DaemonServer: socket: ", strerror(errno));
+    unlink(socket_path_.c_str());
+    // On Linux the socket file takes the mode of the socket inode, so this
+    // holds from bind() on, with no window under the umask's mode.
+    if (fchmod(listen_fd_, socket_mode_) != 0 ||
+        bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) !=
+            0 ||
+        listen(listen_fd_, 64) != 0) {
+        const std::string error = strerror(errno);
+        close(listen_fd_);
+        listen_fd_ = -1;
+        TORCH_CHECK(false, "DaemonServer: cannot listen on ", socket_path_,
+                    ": ", error);
+    }
+    running_ = true;
+    acceptor_ = std::thread([this] { accept_loop(); });
+}
+
+auto DaemonServer::stop() -> void {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    // Wakes accept() and every reader; writers drain what was queued.
+    shutdown(listen_fd_, SHUT_RDWR);
+    acceptor_.join();
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(socket_path_.c_str());
+
+    std::vector<std::shared_ptr<Session>> sessions;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex_);
+        sessions.swap(sessions_);
+    }
+    for (auto &s : sessions) {
+        shutdown(s->fd, SHUT_RDWR);
+        s->reader.join();
+        s->writer.join();
+    }
+}
+
+auto DaemonServer::stats(const std::string &name) const -> Executor::Stats {
+    auto it = models_.find(name);
+    TORCH_CHECK(it != models_.end(), "DaemonServer: unknown model ", name);
+    return it->second.executor->stats();
+}
+
+auto DaemonServer::num_sessions() const -> size_t {
+    std::lock_guard<std::mutex> lock(sessions_mutex_);
+    size_t live = 0;
+    for (const auto &s : sessions_) {
+        live += s->finished ? 0 : 1;
+    }
+    return live;
+}
+
+auto DaemonServer::accept_loop() -> void {
+    while (running_) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        auto session = std::make_shared<Session>();
+        session->fd = fd;
+
+        // The handshake runs on the session's thread: a client that never
+        // says hello holds up nobody else.
+        session->reader = std::thread([this, s = session.get()] {
+            if (s->handshake(models_)) {
+                s->read_requests();
+            } else {
+                s->close_requests();
+            }
+        });
+        session->writer = std::thread([s = session.get()] {
+            s->write_responses();
+        });
+
+        std::lock_guard<std::mutex> lock(sessions_mutex_);
+        // Sessions of clients that left are joined and dropped here.
+        for (auto it = sessions_.begin(); it != sessions_.end();) {
+            if ((*it)->finished) {
+                (*it)->reader.join();
+                (*it)->writer.join();
+                it = sessions_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        sessions_.push_back(std::move(session));
+    }
+}
+} // namespace smplx
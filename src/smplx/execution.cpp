@@ -0,0 +1,145 @@
+#include "execution.hpp"
+#include <cstring>
+#include <exception>
+#include <thread>
+#include "ATen/Parallel.h"
+#include "c10/util/Exception.h"
+#if AT_PARALLEL_OPENMP
+#include <omp.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace smplx {
+namespace {
+#ifdef __linux__
+static_assert(sizeof(cpu_set_t) <= sizeof(std::array<uint64_t, 16>),
+              "cpu_set_t does not fit the saved mask");
+
+auto make_mask(const std::vector<int> &cpus) -> cpu_set_t {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &mask);
+        }
+    }
+    return mask;
+}
+
+// Applies mask to the calling thread and, with the OpenMP backend, to every
+// thread of the team its parallel regions run on: OpenMP gives each team
+// thread at least one of the num_threads chunks.
+auto set_team_affinity(const cpu_set_t &mask, bool team) -> void {
+    sched_setaffinity(0, sizeof(mask), &mask);
+#if AT_PARALLEL_OPENMP
+    const auto num_threads = at::get_num_threads();
+    if (team && num_threads > 1) {
+        at::parallel_for(0, num_threads, 1, [&](int64_t, int64_t) {
+            sched_setaffinity(0, sizeof(mask), &mask);
+        });
+    }
+#else
+    (void)team;
+#endif
+}
+#endif
+} // namespace
+
+auto pin_current_thread(const std::vector<int> &cpus) -> bool {
+#ifdef __linux__
+    if (cpus.empty()) {
+        return false;
+    }
+    const auto mask = make_mask(cpus);
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+ExecutionGuard::ExecutionGuard(const ExecutionSettings &settings) {
+    if (settings.num_threads == 1) {
+        serial_.emplace(true);
+    } else if (settings.num_threads > 1) {
+#if AT_PARALLEL_OPENMP
+        // The OpenMP thread count is per calling thread, unlike
+        // at::set_num_threads(), which also sets the process-wide default.
+        // Initialize it first so that LibTorch's lazy initialization does
+        // not override it later.
+        at::internal::lazy_init_num_threads();
+        if (omp_get_max_threads() != settings.num_threads) {
+            previous_threads_ = omp_get_max_threads();
+            omp_set_num_threads(settings.num_threads);
+        }
+#else
+        TORCH_WARN_ONCE("ExecutionSettings::num_threads above one needs the "
+                        "OpenMP backend; forwards use the intra-op pool of ",
+                        at::get_num_threads(), " threads");
+#endif
+    }
+
+#ifdef __linux__
+    if (!settings.cpu_affinity.empty()) {
+        cpu_set_t previous;
+        const auto mask = make_mask(settings.cpu_affinity);
+        if (sched_getaffinity(0, sizeof(previous), &previous) == 0) {
+            std::memcpy(previous_mask_.data(), &previous, sizeof(previous));
+            restore_affinity_ = true;
+            pin_team_ = !serial_.has_value();
+            set_team_affinity(mask, pin_team_);
+        }
+#if !AT_PARALLEL_OPENMP
+        TORCH_WARN_ONCE("ExecutionSettings::cpu_affinity pins the calling "
+                        "thread only; the intra-op pool of the native backend "
+                        "is not pinned");
+#endif
+    }
+#else
+    if (!settings.cpu_affinity.empty()) {
+        TORCH_WARN_ONCE("ExecutionSettings::cpu_affinity is only supported "
+                        "on Linux");
+    }
+#endif
+}
+
+ExecutionGuard::~ExecutionGuard() {
+#ifdef __linux__
+    if (restore_affinity_) {
+        // The team goes back to the caller's mask, which its threads had
+        // when they were started from the caller.
+        cpu_set_t previous;
+        std::memcpy(&previous, previous_mask_.data(), sizeof(previous));
+        set_team_affinity(previous, pin_team_);
+    }
+#endif
+#if AT_PARALLEL_OPENMP
+    if (previous_threads_ > 0) {
+        omp_set_num_threads(previous_threads_);
+    }
+#endif
+}
+
+auto run_on_cpus(const std::vector<int> &cpus, const std::function<void()> &fn)
+    -> void {
+    std::exception_ptr error;
+    std::thread worker([&] {
+        try {
+            if (!pin_current_thread(cpus)) {
+                TORCH_WARN("run_on_cpus: could not pin the thread, running "
+                           "unpinned");
+            }
+            c10::ParallelGuard serial(true);
+            fn();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    });
+    worker.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+} // namespace smplx
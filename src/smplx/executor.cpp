@@ -0,0 +1,264 @@
+#include "executor.hpp"
+#include <algorithm>
+
+namespace smplx {
+namespace {
+auto rows_of(const SMPLInput &input) -> int64_t {
+    int64_t rows = 1;
+    for (const auto *t : {&input.betas, &input.global_orient, &input.body_pose,
+                          &input.transl}) {
+        if (t->has_value() && (*t)->dim() > 0) {
+            rows = std::max(rows, (*t)->size(0));
+        }
+    }
+    return rows;
+}
+
+// Every parameter given as (1 or rows, width). Others, including those
+// whose row counts do not broadcast, run alone so that their error only
+// reaches them.
+auto coalescable(const SMPLInput &input, int64_t rows) -> bool {
+    for (const auto *t : {&input.betas, &input.global_orient, &input.body_pose,
+                          &input.transl}) {
+        if (!t->has_value() || (*t)->dim() != 2 ||
+            ((*t)->size(0) != 1 && (*t)->size(0) != rows)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Same flags, dtype, device and row widths: the two can share a forward.
+auto can_join(const SMPLInput &a, const SMPLInput &b) -> bool {
+    if (a.pose2rot != b.pose2rot || a.return_verts != b.return_verts ||
+        a.return_full_pose != b.return_full_pose) {
+        return false;
+    }
+    auto same = [](const Tensor &x, const Tensor &y) {
+        return x.scalar_type() == y.scalar_type() &&
+               x.device() == y.device() && x.size(1) == y.size(1);
+    };
+    return same(*a.betas, *b.betas) &&
+           same(*a.global_orient, *b.global_orient) &&
+           same(*a.body_pose, *b.body_pose) && same(*a.transl, *b.transl);
+}
+
+auto percentile(std::vector<double> &sorted, double q) -> double {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto i = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+} // namespace
+
+Executor::Executor(std::shared_ptr<const SMPL> model, ExecutorOptions options)
+    : model_(std::move(model)), options_(options) {
+    TORCH_CHECK(model_ != nullptr, "Executor: null model");
+    TORCH_CHECK(options_.num_workers > 0 && options_.max_batch > 0,
+                "Executor: num_workers and max_batch must be positive");
+    latencies_ms_.reserve(options_.latency_window);
+    for (int i = 0; i < options_.num_workers; ++i) {
+        workers_.emplace_back([this] { worker(); });
+    }
+}
+
+Executor::~Executor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    ready_.notify_all();
+    for (auto &w : workers_) {
+        w.join();
+    }
+}
+
+auto Executor::submit(SMPLInput input) -> std::future<SMPLOutput> {
+    Request request;
+    request.rows = rows_of(input);
+    request.coalescable = coalescable(input, request.rows);
+    request.input = std::move(input);
+    request.submitted = Clock::now();
+    auto future = request.promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TORCH_CHECK(!stop_, "Executor: submit after shutdown");
+        queue_.push_back(std::move(request));
+    }
+    ready_.notify_one();
+    return future;
+}
+
+auto Executor::compatible_rows(const Request &front) const -> int64_t {
+    if (!front.coalescable) {
+        return front.rows;
+    }
+    int64_t rows = 0;
+    for (const auto &r : queue_) {
+        if (r.coalescable && can_join(front.input, r.input)) {
+            rows += r.rows;
+        }
+    }
+    return rows;
+}
+
+auto Executor::worker() -> void {
+    torch::NoGradGuard no_grad;
+    while (true) {
+        std::vector<Request> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            // Wait for company until the batch is full or the oldest
+            // request has waited max_wait; at shutdown, run what is there.
+            // A request that cannot be coalesced runs at once.
+            const auto deadline = queue_.front().submitted + options_.max_wait;
+            while (!stop_ && !queue_.empty() && queue_.front().coalescable &&
+                   compatible_rows(queue_.front()) < options_.max_batch &&
+                   Clock::now() < deadline) {
+                ready_.wait_until(lock, deadline);
+            }
+            if (queue_.empty()) {
+                // Another worker took them.
+                continue;
+            }
+
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+            int64_t rows = batch.front().rows;
+            if (batch.front().coalescable) {
+                for (auto it = queue_.begin(); it != queue_.end();) {
+                    if (it->coalescable &&
+                        rows + it->rows <= options_.max_batch &&
+                        can_join(batch.front().input, it->input)) {
+                        rows += it->rows;
+                        batch.push_back(std::move(*it));
+                        it = queue_.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+        }
+        // Others may be able to start on what is left.
+        ready_.notify_one();
+        run(batch);
+    }
+}
+
+auto Executor::run(std::vector<Request> &batch) -> void {
+    int64_t rows = 0;
+    for (const auto &r : batch) {
+        rows += r.rows;
+    }
+    try {
+        if (batch.size() == 1) {
+            batch[0].promise.set_value(model_->forward(batch[0].input));
+            record(batch, rows);
+            return;
+        }
+
+        // Stack the requests, broadcasting single-row parameters.
+        std::vector<Tensor> betas, global_orient, body_pose, transl;
+        for (auto *list : {&betas, &global_orient, &body_pose, &transl}) {
+            list->reserve(batch.size());
+        }
+        for (const auto &r : batch) {
+            auto expand = [&](const Tensor &t) {
+                return t.size(0) == r.rows ? t : t.expand({r.rows, -1});
+            };
+            betas.push_back(expand(*r.input.betas));
+            global_orient.push_back(expand(*r.input.global_orient));
+            body_pose.push_back(expand(*r.input.body_pose));
+            transl.push_back(expand(*r.input.transl));
+        }
+        SMPLInput input;
+        input.betas = torch::cat(betas);
+        input.global_orient = torch::cat(global_orient);
+        input.body_pose = torch::cat(body_pose);
+        input.transl = torch::cat(transl);
+        input.pose2rot = batch[0].input.pose2rot;
+        input.return_verts = batch[0].input.return_verts;
+        input.return_full_pose = batch[0].input.return_full_pose;
+        const auto out = model_->forward(input);
+
+        // Scatter: every request gets views of its own rows.
+        int64_t start = 0;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const auto n = batch[i].rows;
+            auto slice = [&](const std::optional<Tensor> &t) {
+                return t ? std::make_optional(t->narrow(0, start, n))
+                         : std::nullopt;
+            };
+            batch[i].promise.set_value({slice(out.vertices),
+                                        slice(out.joints),
+                                        slice(out.full_pose),
+                                        global_orient[i],
+                                        betas[i],
+                                        body_pose[i],
+                                        transl[i]});
+            start += n;
+        }
+    } catch (...) {
+        for (auto &r : batch) {
+            try {
+                r.promise.set_exception(std::current_exception());
+            } catch (const std::future_error &) {
+                // Already satisfied.
+            }
+        }
+    }
+    record(batch, rows);
+}
+
+auto Executor::record(const std::vector<Request> &batch, int64_t rows)
+    -> void {
+    const auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.requests += batch.size();
+    stats_.batches += 1;
+    stats_.batch_sizes[rows] += 1;
+    bodies_ += rows;
+    for (const auto &r : batch) {
+        const double ms =
+            std::chrono::duration<double, std::milli>(now - r.submitted)
+                .count();
+        if (latencies_ms_.size() < options_.latency_window) {
+            latencies_ms_.push_back(ms);
+        } else if (!latencies_ms_.empty()) {
+            latencies_ms_[next_latency_] = ms;
+            next_latency_ = (next_latency_ + 1) % latencies_ms_.size();
+        }
+    }
+}
+
+auto Executor::stats() const -> Stats {
+    std::vector<double> sorted;
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats = stats_;
+        sorted = latencies_ms_;
+        stats.mean_batch_size =
+            stats_.batches ? double(bodies_) / stats_.batches : 0;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    stats.p50_ms = percentile(sorted, 0.5);
+    stats.p90_ms = percentile(sorted, 0.9);
+    stats.p99_ms = percentile(sorted, 0.99);
+    stats.max_ms = sorted.empty() ? 0 : sorted.back();
+    return stats;
+}
+
+auto Executor::reset_stats() -> void {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_ = Stats{};
+    bodies_ = 0;
+    latencies_ms_.clear();
+    next_latency_ = 0;
+}
+} // namespace smplx
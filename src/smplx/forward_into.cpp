@@ -0,0 +1,332 @@
+#include <algorithm>
+#include "ATen/Dispatch.h"
+#include "ATen/Parallel.h"
+#include "ATen/native/CPUBlas.h"
+#include "rotation.hpp"
+#include "smplx.hpp"
+
+// SMPL::forward_into: the CPU inference pipeline of lbs() written against
+// the preallocated buffers of a ForwardWorkspace. Everything below works on
+// raw pointers or on views cached in the workspace, so that a call does not
+// create a single tensor.
+namespace smplx {
+namespace {
+using at::native::TransposeType;
+
+// Row-major c (m, n) = beta * c + a (m, k) . b, with b stored (k, n), or
+// (n, k) when transpose_b. BLAS is column-major, so this computes
+// c^T = b^T . a^T.
+template <typename scalar_t>
+void row_gemm(bool transpose_b, int64_t m, int64_t n, int64_t k,
+              const scalar_t *a, const scalar_t *b, scalar_t beta,
+              scalar_t *c) {
+    if (m == 0 || n == 0) {
+        return;
+    }
+    at::native::cpublas::gemm(
+        transpose_b ? TransposeType::Transpose : TransposeType::NoTranspose,
+        TransposeType::NoTranspose, n, m, k, scalar_t(1), b,
+        transpose_b ? k : n, a, k, beta, c, n);
+}
+
+// The model rows one forward runs on: the full mesh, or the vertices used by
+// the keypoint regressor.
+struct VertexSet {
+    const Tensor &v_template;
+    const Tensor &shapedirs;
+    const Tensor &posedirs;
+    const Tensor &lbs_weights;
+    const lbs::Precomputed &precomputed;
+    const lbs::KeypointRegressor &regressor;
+};
+
+struct Inputs {
+    const Tensor &betas;
+    const Tensor &global_orient;
+    const Tensor &body_pose;
+    const Tensor &transl;
+    bool pose2rot;
+};
+
+template <typename scalar_t>
+void forward_in_place(const Inputs &in, const VertexSet &set,
+                      const Tensor &parents, ForwardWorkspace &ws) {
+    const auto &views = ws.views;
+    const int64_t B = views.batch_size;
+    const int64_t Bb = in.betas.size(0);
+    const int64_t L = in.betas.size(1);
+    const int64_t J = parents.size(0);
+    const int64_t K = set.regressor.num_keypoints();
+    const int64_t N = set.v_template.size(0) * 3;
+    const int64_t P = (J - 1) * 9;
+    const int64_t pose_width = J * (in.pose2rot ? 3 : 9);
+    const auto &precomputed = set.precomputed;
+
+    // Betas, broadcast over the batch for the returned view.
+    const auto *betas = in.betas.data_ptr<scalar_t>();
+    auto *batch_betas = ws.betas.data_ptr<scalar_t>();
+    for (int64_t b = 0; b < B; ++b) {
+        std::copy_n(betas + (Bb == 1 ? 0 : b) * L, L, batch_betas + b * L);
+    }
+
+    // Shape blend and rest joints, once per distinct betas row.
+    auto *v_shaped = ws.v_shaped.data_ptr<scalar_t>();
+    auto *rest = ws.rest_joints.data_ptr<scalar_t>();
+    const auto *v_template = set.v_template.data_ptr<scalar_t>();
+    const auto *J_template = precomputed.J_template.data_ptr<scalar_t>();
+    for (int64_t b = 0; b < Bb; ++b) {
+        std::copy_n(v_template, N, v_shaped + b * N);
+        std::copy_n(J_template, J * 3, rest + b * J * 3);
+    }
+    row_gemm<scalar_t>(true, Bb, N, L, betas,
+                       set.shapedirs.data_ptr<scalar_t>(), 1, v_shaped);
+    row_gemm<scalar_t>(true, Bb, J * 3, L, betas,
+                       precomputed.J_shapedirs.data_ptr<scalar_t>(), 1, rest);
+
+    // Full pose and rotations.
+    auto *full_pose = ws.full_pose.data_ptr<scalar_t>();
+    const auto root_width = in.global_orient.numel() / B;
+    const auto *global_orient = in.global_orient.data_ptr<scalar_t>();
+    const auto *body_pose = in.body_pose.data_ptr<scalar_t>();
+    for (int64_t b = 0; b < B; ++b) {
+        auto *row = full_pose + b * pose_width;
+        std::copy_n(global_orient + b * root_width, root_width, row);
+        std::copy_n(body_pose + b * (pose_width - root_width),
+                    pose_width - root_width, row + root_width);
+    }
+    const scalar_t *rot = full_pose;
+    if (in.pose2rot) {
+        lbs::rodrigues_out(views.pose_vecs, views.rot_mats);
+        rot = ws.rot_mats.data_ptr<scalar_t>();
+    }
+
+    // Pose correctives: v_posed = v_shaped + (R[1:] - I) . posedirs
+    auto *feature = ws.pose_feature.data_ptr<scalar_t>();
+    auto *v_posed = ws.v_posed.data_ptr<scalar_t>();
+    for (int64_t b = 0; b < B; ++b) {
+        for (int64_t k = 0; k < P; ++k) {
+            feature[b * P + k] =
+                rot[b * J * 9 + 9 + k] - scalar_t(k % 9 % 4 == 0 ? 1 : 0);
+        }
+        std::copy_n(v_shaped + (Bb == 1 ? 0 : b) * N, N, v_posed + b * N);
+    }
+    if (precomputed.low_rank_posedirs.has_value()) {
+        const auto &low_rank = *precomputed.low_rank_posedirs;
+        const auto r = low_rank.rank();
+        auto *tmp = ws.low_rank.data_ptr<scalar_t>();
+        row_gemm<scalar_t>(false, B, r, P, feature,
+                           low_rank.left.data_ptr<scalar_t>(), 0, tmp);
+        row_gemm<scalar_t>(false, B, N, r, tmp,
+                           low_rank.right.data_ptr<scalar_t>(), 1, v_posed);
+    } else {
+        row_gemm<scalar_t>(false, B, N, P, feature,
+                           set.posedirs.data_ptr<scalar_t>(), 1, v_posed);
+    }
+
+    // Kinematic chain: world transforms G_i = G_p [R_i | j_i - j_p], the
+    // posed joints (+ transl) straight into the joints output, then the
+    // skinning transforms A_i = G_i - [0 | G_i[:3, :3] j_i].
+    const auto *p = parents.data_ptr<int64_t>();
+    const auto *transl = in.transl.data_ptr<scalar_t>();
+    const int64_t transl_stride = in.transl.size(0) == 1 ? 0 : 3;
+    auto *transforms = ws.transforms.data_ptr<scalar_t>();
+    auto *joints = ws.joints.data_ptr<scalar_t>();
+    at::parallel_for(0, B, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t b = begin; b < end; ++b) {
+            const auto *R = rot + b * J * 9;
+            const auto *j = rest + (Bb == 1 ? 0 : b) * J * 3;
+            auto *G = transforms + b * J * 16;
+            for (int64_t i = 0; i < J; ++i) {
+                scalar_t T[12];
+                for (int r = 0; r < 3; ++r) {
+                    T[r * 4 + 0] = R[i * 9 + r * 3 + 0];
+                    T[r * 4 + 1] = R[i * 9 + r * 3 + 1];
+                    T[r * 4 + 2] = R[i * 9 + r * 3 + 2];
+                    T[r * 4 + 3] = j[i * 3 + r];
+                    if (i > 0) {
+                        T[r * 4 + 3] -= j[p[i] * 3 + r];
+                    }
+                }
+                auto *Gi = G + i * 16;
+                if (i == 0) {
+                    std::copy_n(T, 12, Gi);
+                } else {
+                    const auto *Gp = G + p[i] * 16;
+                    for (int r = 0; r < 3; ++r) {
+                        for (int c = 0; c < 4; ++c) {
+                            Gi[r * 4 + c] = Gp[r * 4 + 0] * T[0 * 4 + c] +
+                                            Gp[r * 4 + 1] * T[1 * 4 + c] +
+                                            Gp[r * 4 + 2] * T[2 * 4 + c] +
+                                            (c == 3 ? Gp[r * 4 + 3] : 0);
+                        }
+                    }
+                }
+                Gi[12] = Gi[13] = Gi[14] = 0;
+                Gi[15] = 1;
+            }
+            auto *out = joints + b * (J + K) * 3;
+            for (int64_t i = 0; i < J; ++i) {
+                auto *Gi = G + i * 16;
+                for (int r = 0; r < 3; ++r) {
+                    out[i * 3 + r] =
+                        Gi[r * 4 + 3] + transl[b * transl_stride + r];
+                    Gi[r * 4 + 3] -= Gi[r * 4 + 0] * j[i * 3 + 0] +
+                                     Gi[r * 4 + 1] * j[i * 3 + 1] +
+                                     Gi[r * 4 + 2] * j[i * 3 + 2];
+                }
+            }
+        }
+    });
+
+    if (precomputed.sparse_weights.has_value()) {
+        lbs::skinning_out(views.v_posed, *precomputed.sparse_weights,
+                          views.transforms, in.transl, views.vertices);
+    } else {
+        lbs::skinning_out(views.v_posed, set.lbs_weights, views.transforms,
+                          in.transl, views.vertices);
+    }
+    lbs::regress_keypoints_out(set.regressor, views.vertices, views.keypoints);
+}
+
+// Views of the flat buffers for one call shape.
+auto make_views(ForwardWorkspace &ws, int64_t B, int64_t num_vertices,
+                int64_t num_joints, int64_t num_keypoints, bool pose2rot)
+    -> void {
+    auto &views = ws.views;
+    const auto J = num_joints;
+    const auto width = pose2rot ? 3 : 9;
+    views.batch_size = B;
+    views.num_vertices = num_vertices;
+    views.pose2rot = pose2rot;
+    const auto L = ws.betas.numel() / ws.max_batch_size;
+    views.betas = ws.betas.narrow(0, 0, B * L).view({B, L});
+    views.full_pose =
+        ws.full_pose.narrow(0, 0, B * J * width).view({B, J * width});
+    views.pose_vecs = ws.full_pose.narrow(0, 0, B * J * 3).view({B * J, 3});
+    views.rot_mats = ws.rot_mats.narrow(0, 0, B * J * 9).view({B * J, 9});
+    views.v_posed = ws.v_posed.narrow(0, 0, B * num_vertices * 3)
+                        .view({B, num_vertices, 3});
+    views.transforms =
+        ws.transforms.narrow(0, 0, B * J * 16).view({B, J, 4, 4});
+    views.vertices = ws.vertices.narrow(0, 0, B * num_vertices * 3)
+                         .view({B, num_vertices, 3});
+    views.joints = ws.joints.narrow(0, 0, B * (J + num_keypoints) * 3)
+                       .view({B, J + num_keypoints, 3});
+    views.keypoints = views.joints.narrow(1, J, num_keypoints);
+}
+} // namespace
+
+auto SMPL::make_workspace(int64_t max_batch_size) const -> ForwardWorkspace {
+    TORCH_CHECK(max_batch_size > 0, "make_workspace: batch size must be "
+                                    "positive");
+    const auto B = max_batch_size;
+    const auto V = v_template_.size(0);
+    const auto J = parents_.size(0);
+    const auto L = shapedirs_.size(2);
+    const auto K = keypoint_regressor_.num_keypoints();
+    const auto &low_rank = precomputed_.low_rank_posedirs;
+    auto options = torch::dtype(compute_dtype_).device(device_);
+
+    ForwardWorkspace ws;
+    ws.max_batch_size = B;
+    ws.betas = torch::empty({B * L}, options);
+    ws.full_pose = torch::empty({B * J * 9}, options);
+    ws.v_shaped = torch::empty({B * V * 3}, options);
+    ws.rest_joints = torch::empty({B * J * 3}, options);
+    ws.rot_mats = torch::empty({B * J * 9}, options);
+    ws.pose_feature = torch::empty({B * (J - 1) * 9}, options);
+    ws.low_rank = torch::empty({low_rank ? B * low_rank->rank() : 0}, options);
+    ws.v_posed = torch::empty({B * V * 3}, options);
+    ws.transforms = torch::empty({B * J * 16}, options);
+    ws.vertices = torch::empty({B * V * 3}, options);
+    ws.joints = torch::empty({B * (J + K) * 3}, options);
+    return ws;
+}
+
+auto SMPL::forward_into(const SMPLInput &input,
+                        ForwardWorkspace &workspace) const -> SMPLOutput {
+    ExecutionGuard execution_guard(vars_.execution);
+    std::optional<c10::InferenceMode> inference_guard;
+    if (vars_.inference) {
+        inference_guard.emplace();
+    }
+    const auto &betas = input.betas ? *input.betas : vars_.betas.value();
+    const auto &global_orient =
+        input.global_orient ? *input.global_orient
+                            : vars_.global_orient.value();
+    const auto &body_pose =
+        input.body_pose ? *input.body_pose : vars_.body_pose.value();
+    const auto &transl = input.transl ? *input.transl : vars_.transl.value();
+
+    const auto J = parents_.size(0);
+    const auto B = std::max(betas.size(0), global_orient.size(0));
+    auto fits = [&](const Tensor &t) {
+        return t.is_cpu() && t.is_contiguous() &&
+               t.scalar_type() == compute_dtype_ && t.dim() >= 2 &&
+               !(torch::GradMode::is_enabled() && t.requires_grad());
+    };
+    const bool in_place =
+        device_.is_cpu() && !vars_.joint_mapper.has_value() &&
+        !precomputed_.block_sparse_posedirs.has_value() &&
+        (compute_dtype_ == torch::kFloat || compute_dtype_ == torch::kDouble) &&
+        shapedirs_.scalar_type() == compute_dtype_ && fits(betas) &&
+        fits(global_orient) && fits(body_pose) && fits(transl) &&
+        betas.size(1) == shapedirs_.size(2) &&
+        (betas.size(0) == 1 || betas.size(0) == B) &&
+        global_orient.size(0) == B && body_pose.size(0) == B &&
+        (transl.size(0) == 1 || transl.size(0) == B) &&
+        transl.numel() == transl.size(0) * 3 &&
+        global_orient.numel() + body_pose.numel() ==
+            B * J * (input.pose2rot ? 3 : 9);
+    if (!in_place) {
+        return forward(input);
+    }
+
+    const auto &set =
+        input.return_verts
+            ? VertexSet{v_template_,  shapedirs_,   posedirs_,
+                        lbs_weights_, precomputed_, keypoint_regressor_}
+            : VertexSet{keypoint_vertices_.v_template,
+                        keypoint_vertices_.shapedirs,
+                        keypoint_vertices_.posedirs,
+                        keypoint_vertices_.lbs_weights,
+                        keypoint_vertices_.precomputed,
+                        keypoint_subset_regressor_};
+    const auto num_vertices = set.v_template.size(0);
+    const auto num_keypoints = set.regressor.num_keypoints();
+
+    // A workspace of another model, or too small, is replaced.
+    if (workspace.max_batch_size < B ||
+        workspace.v_posed.numel() !=
+            workspace.max_batch_size * v_template_.size(0) * 3 ||
+        workspace.joints.numel() !=
+            workspace.max_batch_size *
+                (J + keypoint_regressor_.num_keypoints()) * 3 ||
+        workspace.betas.numel() !=
+            workspace.max_batch_size * shapedirs_.size(2) ||
+        workspace.v_posed.scalar_type() != compute_dtype_) {
+        workspace = make_workspace(std::max(B, workspace.max_batch_size));
+    }
+    auto &views = workspace.views;
+    if (views.batch_size != B || views.num_vertices != num_vertices ||
+        views.pose2rot != input.pose2rot) {
+        make_views(workspace, B, num_vertices, J, num_keypoints,
+                   input.pose2rot);
+    }
+
+    const Inputs in{betas, global_orient, body_pose, transl, input.pose2rot};
+    AT_DISPATCH_FLOATING_TYPES(compute_dtype_, "forward_into", [&] {
+        forward_in_place<scalar_t>(in, set, parents_, workspace);
+    });
+
+    return {input.return_verts ? std::make_optional(views.vertices)
+                               : std::nullopt,
+            views.joints,
+            input.return_full_pose ? std::make_optional(views.full_pose)
+                                   : std::nullopt,
+            global_orient,
+            views.betas,
+            body_pose,
+            transl};
+}
+} // namespace smplx
@@ -0,0 +1,163 @@
+#include "keypoint_regressor.hpp"
+#include "ATen/Dispatch.h"
+#include "ATen/OpMathType.h"
+#include "ATen/Parallel.h"
+#include "torch/torch.h"
+
+namespace smplx::lbs {
+namespace {
+// Keypoints handled per task; one keypoint is nnz / K gathers.
+constexpr int64_t kKeypointGrainSize = 64;
+
+// out may be a view into a larger joints buffer: only its keypoint rows
+// need to be contiguous.
+auto regress_keypoints_cpu(const KeypointRegressor &regressor,
+                           const Tensor &v, const Tensor &w, const Tensor &out)
+    -> void {
+    const auto B = v.size(0);
+    const auto V = v.size(1);
+    const auto K = regressor.num_keypoints();
+    const auto out_stride = out.stride(0);
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(
+        at::kBFloat16, at::kHalf, v.scalar_type(), "regress_keypoints_cpu",
+        [&] {
+            using acc_t = at::opmath_type<scalar_t>;
+            const auto *vp = v.data_ptr<scalar_t>();
+            const auto *wp = w.data_ptr<scalar_t>();
+            const auto *crow = regressor.crow_indices.data_ptr<int64_t>();
+            const auto *col = regressor.col_indices.data_ptr<int64_t>();
+            auto *o = out.data_ptr<scalar_t>();
+
+            at::parallel_for(
+                0, B * K, kKeypointGrainSize, [&](int64_t begin, int64_t end) {
+                    for (int64_t idx = begin; idx < end; ++idx) {
+                        const int64_t b = idx / K;
+                        const int64_t k = idx % K;
+                        acc_t x = 0, y = 0, z = 0;
+                        for (int64_t n = crow[k]; n < crow[k + 1]; ++n) {
+                            const acc_t wn = wp[n];
+                            const auto *vn = vp + (b * V + col[n]) * 3;
+                            x += wn * static_cast<acc_t>(vn[0]);
+                            y += wn * static_cast<acc_t>(vn[1]);
+                            z += wn * static_cast<acc_t>(vn[2]);
+                        }
+                        auto *ok = o + b * out_stride + k * 3;
+                        ok[0] = static_cast<scalar_t>(x);
+                        ok[1] = static_cast<scalar_t>(y);
+                        ok[2] = static_cast<scalar_t>(z);
+                    }
+                });
+        });
+}
+} // namespace
+
+auto sparse_regressor(const Tensor &regressor, double threshold)
+    -> KeypointRegressor {
+    TORCH_CHECK(regressor.dim() == 2,
+                "sparse_regressor: expected a (K, V) regressor");
+    auto dense = regressor.detach();
+    auto keep = dense.abs() > threshold;
+    // nonzero() is row-major, i.e. already in CSR order.
+    auto nz = keep.nonzero();
+
+    KeypointRegressor out;
+    out.row_indices = nz.select(1, 0).contiguous();
+    out.col_indices = nz.select(1, 1).contiguous();
+    out.values = dense.index({out.row_indices, out.col_indices}).contiguous();
+    out.crow_indices =
+        torch::cat({torch::zeros({1}, keep.options().dtype(torch::kLong)),
+                    keep.sum(1).cumsum(0)});
+    out.num_vertices = dense.size(1);
+    return out;
+}
+
+auto vertex_regressor(const Tensor &vertex_ids, int64_t num_vertices,
+                      torch::Dtype dtype) -> KeypointRegressor {
+    auto ids = vertex_ids.to(torch::kLong).contiguous();
+    TORCH_CHECK(ids.dim() == 1, "vertex_regressor: expected 1-D indices");
+    KeypointRegressor out;
+    out.col_indices = ids;
+    out.row_indices = torch::arange(ids.size(0), ids.options());
+    out.crow_indices = torch::arange(ids.size(0) + 1, ids.options());
+    out.values = torch::ones({ids.size(0)}, ids.options().dtype(dtype));
+    out.num_vertices = num_vertices;
+    return out;
+}
+
+auto stack_regressors(const KeypointRegressor &top,
+                      const KeypointRegressor &bottom) -> KeypointRegressor {
+    TORCH_CHECK(top.num_vertices == bottom.num_vertices,
+                "stack_regressors: regressors over different vertices");
+    KeypointRegressor out;
+    out.crow_indices = torch::cat(
+        {top.crow_indices,
+         bottom.crow_indices.narrow(0, 1, bottom.num_keypoints()) +
+             top.nnz()});
+    out.col_indices = torch::cat({top.col_indices, bottom.col_indices});
+    out.row_indices = torch::cat(
+        {top.row_indices, bottom.row_indices + top.num_keypoints()});
+    out.values = torch::cat(
+        {top.values, bottom.values.to(top.values.scalar_type())});
+    out.num_vertices = top.num_vertices;
+    return out;
+}
+
+auto compact_regressor(const KeypointRegressor &regressor)
+    -> std::tuple<Tensor, KeypointRegressor> {
+    auto [support, inverse] = torch::_unique(regressor.col_indices,
+                                             /*sorted=*/true,
+                                             /*return_inverse=*/true);
+    KeypointRegressor out = regressor;
+    out.col_indices = inverse.contiguous();
+    out.num_vertices = support.size(0);
+    return std::make_tuple(support, out);
+}
+
+auto regress_keypoints(const KeypointRegressor &regressor,
+                       const Tensor &vertices) -> Tensor {
+    TORCH_CHECK(vertices.dim() == 3 &&
+                    vertices.size(1) == regressor.num_vertices &&
+                    vertices.size(2) == 3,
+                "regress_keypoints: expected vertices of shape (B, ",
+                regressor.num_vertices, ", 3)");
+    const bool needs_grad =
+        torch::GradMode::is_enabled() &&
+        (vertices.requires_grad() || regressor.values.requires_grad());
+    if (vertices.device().is_cpu() && !needs_grad) {
+        auto v = vertices.contiguous();
+        auto out = torch::empty({v.size(0), regressor.num_keypoints(), 3},
+                                v.options());
+        regress_keypoints_cpu(regressor, v,
+                              regressor.values.to(v.scalar_type()).contiguous(),
+                              out);
+        return out;
+    }
+    auto weights = regressor.values.to(vertices.scalar_type());
+    auto weighted = vertices.index_select(1, regressor.col_indices) *
+                    weights.view({1, -1, 1});
+    return torch::zeros({vertices.size(0), regressor.num_keypoints(), 3},
+                        weighted.options())
+        .index_add(1, regressor.row_indices, weighted);
+}
+
+auto regress_keypoints_out(const KeypointRegressor &regressor,
+                           const Tensor &vertices, const Tensor &out) -> void {
+    TORCH_CHECK(vertices.is_cpu() && vertices.is_contiguous() &&
+                    vertices.dim() == 3 &&
+                    vertices.size(1) == regressor.num_vertices,
+                "regress_keypoints_out: expected contiguous CPU vertices of "
+                "shape (B, ", regressor.num_vertices, ", 3)");
+    TORCH_CHECK(out.dim() == 3 && out.size(0) == vertices.size(0) &&
+                    out.size(1) == regressor.num_keypoints() &&
+                    out.size(2) == 3 && out.stride(2) == 1 &&
+                    out.stride(1) == 3,
+                "regress_keypoints_out: expected a (B, K, 3) out with "
+                "contiguous rows");
+    TORCH_CHECK(regressor.values.scalar_type() == vertices.scalar_type() &&
+                    out.scalar_type() == vertices.scalar_type(),
+                "regress_keypoints_out: regressor, vertices and out must "
+                "share a dtype");
+    regress_keypoints_cpu(regressor, vertices, regressor.values, out);
+}
+} // namespace smplx::lbs
@@ -1,6 +1,7 @@
 
 #include "lbs.hpp"
 #include <cmath>
+#include <optional>
 #include <tuple>
 #include <vector>
 #include "ATen/TensorIndexing.h"
@@ -19,90 +20,171 @@
 #include "ATen/ops/unsqueeze.h"
 #include "c10/core/ScalarType.h"
 #include "c10/core/TensorOptions.h"
+#include "rotation.hpp"
+#include "skinning.hpp"
 #include "torch/types.h"
 
 namespace smplx::lbs {
-auto batch_rodrigues(Tensor &&rot_vecs, float epsilon) -> Tensor {
-    auto batch_size = rot_vecs.size(0);
-
-    auto angle = torch::norm(rot_vecs + 1e-8, 2, 1, true);
-
-    auto rot_dir = rot_vecs / angle;
-
-    auto cos = torch::unsqueeze(torch::cos(angle), 1);
-    auto sin = torch::unsqueeze(torch::sin(angle), 1);
-
-    auto r = torch::split(rot_dir, 1, 1);
-
-    auto K =
-        torch::zeros({batch_size, 3, 3},
-                     torch::device(rot_vecs.device()).dtype(rot_vecs.dtype()));
-    auto zeros =
-        torch::zeros({batch_size, 1},
-                     torch::device(rot_vecs.device()).dtype(rot_vecs.dtype()));
-
-    K = torch::cat({zeros, -r[2], r[1], r[2], zeros, -r[0], -r[1], r[0], zeros},
-                   1)
-            .view({batch_size, 3, 3});
-
-    auto ident =
-        torch::eye(3, torch::device(rot_vecs.device()).dtype(rot_vecs.dtype()))
-            .unsqueeze(0);
+auto batch_rodrigues(const Tensor &rot_vecs, float) -> Tensor {
+    return rodrigues(rot_vecs);
+}
 
-    auto rot_mat = ident + sin * K + (1 - cos) * torch::bmm(K, K);
+auto build_kinematic_tree(const Tensor &parents) -> KinematicTree {
+    auto host = parents.to(torch::kCPU, torch::kLong).contiguous();
+    const auto *p = host.data_ptr<int64_t>();
+    const auto num_joints = host.size(0);
+
+    std::vector<int64_t> depth(num_joints, 0);
+    std::vector<std::vector<int64_t>> levels, level_parents;
+    for (int64_t i = 1; i < num_joints; ++i) {
+        TORCH_CHECK(p[i] >= 0 && p[i] < i,
+                    "build_kinematic_tree: parents must precede children");
+        depth[i] = depth[p[i]] + 1;
+        if (static_cast<size_t>(depth[i]) > levels.size()) {
+            levels.resize(depth[i]);
+            level_parents.resize(depth[i]);
+        }
+        levels[depth[i] - 1].push_back(i);
+        level_parents[depth[i] - 1].push_back(p[i]);
+    }
 
-    return rot_mat;
+    KinematicTree tree;
+    auto options = torch::dtype(torch::kLong).device(parents.device());
+    tree.parents = parents.to(options);
+    for (size_t d = 0; d < levels.size(); ++d) {
+        tree.levels.push_back(torch::tensor(levels[d], options));
+        tree.level_parents.push_back(torch::tensor(level_parents[d], options));
+    }
+    return tree;
 }
 
-auto batch_rigid_transform(Tensor &rot_mats, Tensor &joints, Tensor &parents,
-                           torch::Dtype) -> std::tuple<Tensor, Tensor> {
-
-    joints = torch::unsqueeze(joints, -1);
+auto batch_rigid_transform(const Tensor &rot_mats, const Tensor &rest_joints,
+                           const KinematicTree &tree)
+    -> std::tuple<Tensor, Tensor> {
+    const auto num_joints = tree.num_joints();
+    auto joints = torch::unsqueeze(rest_joints, -1);
 
     auto rel_joints = joints.clone();
     rel_joints.index_put_(
         {Slice(None), Slice(1, None)},
         rel_joints.index({Slice(None), Slice(1, None)}) -
-            joints.index({Slice(None), parents.index({Slice(1, None)})}));
+            joints.index_select(1, tree.parents.index({Slice(1, None)})));
 
     auto transforms_mat = transform_mat(rot_mats.reshape({-1, 3, 3}),
                                         rel_joints.reshape({-1, 3, 1}))
-                              .reshape({-1, joints.size(1), 4, 4});
-
-    // auto transform_chain = [transforms_mat[:, 0]]
-    std::vector<Tensor> transform_chain{transforms_mat.index({Slice(None), 0})};
-    transform_chain.reserve(parents.size(0));
-    for (auto i = 1; i < parents.size(0); ++i) {
-        auto x = parents[i];
-        auto curr_res = torch::matmul(transform_chain[parents[i].item<int>()],
-                                      transforms_mat.index({Slice(None), i}));
-        transform_chain.emplace_back(curr_res);
+                              .reshape({-1, num_joints, 4, 4});
+
+    // Every joint of a level only depends on the previous levels, so each
+    // level is a single batched matmul and the traversal never leaves the
+    // device.
+    auto transforms = transforms_mat.clone();
+    for (size_t d = 0; d < tree.levels.size(); ++d) {
+        transforms = transforms.index_copy(
+            1, tree.levels[d],
+            torch::matmul(transforms.index_select(1, tree.level_parents[d]),
+                          transforms_mat.index_select(1, tree.levels[d])));
     }
 
-    auto transforms = torch::stack(transform_chain, 1);
-
     auto posed_joints =
         transforms.index({Slice(None), Slice(None), Slice(None, 3), 3});
 
-    auto joints_homogen = torch::pad(joints, {0, 0, 0, 1});
-
-    auto rel_transforms =
-        transforms - torch::pad(torch::matmul(transforms, joints_homogen),
-                                {3, 0, 0, 0, 0, 0, 0, 0});
+    // Relative transforms: same rotation, translation t - R j. Only the
+    // 3x3 block takes part in the product instead of padding the joints to
+    // homogeneous coordinates and subtracting a full 4x4 matmul.
+    auto R = transforms.index({Slice(None), Slice(None), Slice(None, 3),
+                               Slice(None, 3)});
+    auto rel_t = posed_joints.unsqueeze(-1) - torch::matmul(R, joints);
+    auto rel_transforms = transform_mat(R.reshape({-1, 3, 3}),
+                                        rel_t.reshape({-1, 3, 1}))
+                              .reshape({-1, num_joints, 4, 4});
 
     return std::make_tuple(posed_joints, rel_transforms);
 }
 
-auto lbs(Tensor &betas, Tensor &pose, Tensor &v_template, Tensor &shapedirs,
-         Tensor &posedirs, Tensor &J_regressor, Tensor &parents,
-         Tensor &lbs_weights, bool pose2rot) -> std::tuple<Tensor, Tensor> {
-    auto batch_size = std::max(betas.size(0), pose.size(0));
+auto batch_rigid_transform(const Tensor &rot_mats, const Tensor &rest_joints,
+                           const Tensor &parents, torch::Dtype)
+    -> std::tuple<Tensor, Tensor> {
+    return batch_rigid_transform(rot_mats, rest_joints,
+                                 build_kinematic_tree(parents));
+}
+
+auto regress_shape_joints(const Tensor &J_regressor, const Tensor &v_template,
+                          const Tensor &shapedirs)
+    -> std::tuple<Tensor, Tensor> {
+    auto J_template = torch::matmul(J_regressor, v_template);
+    auto J_shapedirs = torch::einsum("jv,vkl->jkl", {J_regressor, shapedirs});
+    return std::make_tuple(J_template, J_shapedirs.contiguous());
+}
 
+auto select_vertices(const Tensor &vertex_ids, const Tensor &v_template,
+                     const Tensor &shapedirs, const Tensor &posedirs,
+                     const Tensor &lbs_weights, const Precomputed &precomputed)
+    -> VertexSubset {
+    VertexSubset subset;
+    subset.vertex_ids = vertex_ids.to(torch::kLong);
+    const auto &ids = subset.vertex_ids;
+    subset.v_template = v_template.index_select(0, ids);
+    subset.shapedirs = shapedirs.index_select(0, ids).contiguous();
+    subset.lbs_weights = lbs_weights.index_select(0, ids);
+
+    // posedirs columns are laid out vertex-major: 3 * id + {0, 1, 2}
+    auto cols = (ids.unsqueeze(1) * 3 +
+                 torch::arange(3, ids.options()).unsqueeze(0))
+                    .view({-1});
+    // Undefined when the low-rank factors replace posedirs.
+    if (posedirs.defined()) {
+        subset.posedirs = posedirs.index_select(1, cols);
+    }
+
+    subset.precomputed = precomputed;
+    if (precomputed.low_rank_posedirs.has_value()) {
+        auto &low_rank = *subset.precomputed.low_rank_posedirs;
+        low_rank.right = low_rank.right.index_select(1, cols);
+    }
+    // The vertex blocks do not survive the gather; the subset posedirs are
+    // small enough to be used dense.
+    subset.precomputed.block_sparse_posedirs.reset();
+    if (precomputed.sparse_weights.has_value()) {
+        auto &sparse = *subset.precomputed.sparse_weights;
+        sparse.indices = sparse.indices.index_select(0, ids);
+        sparse.values = sparse.values.index_select(0, ids);
+    }
+    return subset;
+}
+
+auto lbs(const Tensor &betas, const Tensor &pose, const VertexSubset &subset,
+         const Tensor &parents, bool pose2rot,
+         const std::optional<Tensor> &transl) -> std::tuple<Tensor, Tensor> {
+    TORCH_CHECK(subset.precomputed.J_template.defined(),
+                "lbs: a vertex subset needs the precomputed shape regressor");
+    return lbs(betas, pose, subset.v_template, subset.shapedirs,
+               subset.posedirs, Tensor(), parents, subset.lbs_weights,
+               pose2rot, transl, subset.precomputed);
+}
+
+auto shape_blend(const Tensor &betas, const Tensor &v_template,
+                 const Tensor &shapedirs, const Tensor &J_regressor,
+                 const Precomputed &precomputed) -> std::tuple<Tensor, Tensor> {
     auto v_shaped = v_template + blend_shape(betas, shapedirs);
-    auto J = vertices2joints(J_regressor, v_shaped);
+    auto J = precomputed.J_template.defined()
+                 ? shape_joints(betas, precomputed)
+                 : vertices2joints(J_regressor, v_shaped);
+    return std::make_tuple(v_shaped, J);
+}
+
+auto pose_and_skin(const Tensor &v_shaped, const Tensor &rest_joints,
+                   const Tensor &pose, const Tensor &posedirs,
+                   const Tensor &parents, const Tensor &lbs_weights,
+                   bool pose2rot, const std::optional<Tensor> &transl,
+                   const Precomputed &precomputed)
+    -> std::tuple<Tensor, Tensor> {
+    auto batch_size = std::max(v_shaped.size(0), pose.size(0));
+    auto J = rest_joints.size(0) == batch_size
+                 ? rest_joints
+                 : rest_joints.expand({batch_size, -1, -1});
 
     auto ident =
-        torch::eye(3, torch::device(betas.device()).dtype(betas.dtype()));
+        torch::eye(3, torch::device(pose.device()).dtype(pose.dtype()));
     Tensor pose_offsets, rot_mats;
     if (pose2rot) {
         rot_mats =
@@ -114,7 +196,8 @@ auto lbs(Tensor &betas, Tensor &pose, Tensor &v_template, Tensor &shapedirs,
                                 .view({batch_size, -1});
 
         pose_offsets =
-            torch::matmul(pose_feature, posedirs).view({batch_size, -1, 3});
+            pose_correctives(pose_feature, posedirs, precomputed)
+                .view({batch_size, -1, 3});
     } else {
         auto pose_feature = pose.index({Slice(None), Slice(1, None)})
                                 .view({batch_size, -1, 3, 3}) -
@@ -122,32 +205,39 @@ auto lbs(Tensor &betas, Tensor &pose, Tensor &v_template, Tensor &shapedirs,
 
         rot_mats = pose.view({batch_size, -1, 3, 3});
         pose_offsets =
-            torch::matmul(pose_feature.view({batch_size, -1}), posedirs)
+            pose_correctives(pose_feature.view({batch_size, -1}), posedirs,
+                             precomputed)
                 .view({batch_size, -1, 3});
     }
 
     auto v_posed = pose_offsets + v_shaped;
 
-    auto [J_transformed, A] = batch_rigid_transform(rot_mats, J, parents);
-
-    auto W = lbs_weights.unsqueeze(0).expand({batch_size, -1, -1});
-
-    auto num_joints = J_regressor.size(0);
-
-    auto T = torch::matmul(W, A.view({batch_size, num_joints, 16}))
-                 .view({batch_size, -1, 4, 4});
-
-    auto homogen_coord =
-        torch::ones({batch_size, v_posed.size(1), 1},
-                    torch::device(betas.device()).dtype(betas.dtype()));
-
-    auto v_posed_homo = torch::cat({v_posed, homogen_coord}, 2);
+    auto [J_transformed, A] =
+        precomputed.kinematic_tree.has_value()
+            ? batch_rigid_transform(rot_mats, J, *precomputed.kinematic_tree)
+            : batch_rigid_transform(rot_mats, J, parents);
+
+    const auto &sparse_weights = precomputed.sparse_weights;
+    auto vertices = sparse_weights.has_value()
+                        ? skinning(v_posed, *sparse_weights, A, transl)
+                        : skinning(v_posed, lbs_weights, A, transl);
+    if (transl.has_value()) {
+        J_transformed = J_transformed + transl->unsqueeze(1);
+    }
 
-    auto v_homo = torch::matmul(T, torch::unsqueeze(v_posed_homo, -1));
+    return std::make_tuple(vertices, J_transformed);
+}
 
-    return std::make_tuple(
-        v_homo.index({Slice(None), Slice(None), Slice(None, 3), 0}),
-        J_transformed);
+auto lbs(const Tensor &betas, const Tensor &pose, const Tensor &v_template,
+         const Tensor &shapedirs, const Tensor &posedirs,
+         const Tensor &J_regressor, const Tensor &parents,
+         const Tensor &lbs_weights, bool pose2rot,
+         const std::optional<Tensor> &transl,
+         const Precomputed &precomputed) -> std::tuple<Tensor, Tensor> {
+    auto [v_shaped, J] =
+        shape_blend(betas, v_template, shapedirs, J_regressor, precomputed);
+    return pose_and_skin(v_shaped, J, pose, posedirs, parents, lbs_weights,
+                         pose2rot, transl, precomputed);
 }
 
 auto vertices2landmarks(Tensor &vertices, Tensor &faces, Tensor &lmk_faces_idx,
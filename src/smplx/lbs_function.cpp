@@ -0,0 +1,282 @@
+#include <optional>
+#include <string>
+#include "lbs.hpp"
+#include "rotation.hpp"
+#include "skinning.hpp"
+#include "torch/torch.h"
+
+namespace smplx::lbs {
+namespace {
+using torch::autograd::AutogradContext;
+using torch::autograd::tensor_list;
+
+auto skin(const Tensor &v_posed, const Tensor &lbs_weights,
+          const Tensor &sparse_indices, const Tensor &sparse_values,
+          const Tensor &A) -> Tensor {
+    if (!sparse_indices.defined()) {
+        return skinning(v_posed, lbs_weights, A);
+    }
+    SparseWeights sparse;
+    sparse.indices = sparse_indices;
+    sparse.values = sparse_values;
+    return skinning(v_posed, sparse, A);
+}
+
+// Shape -> pose -> skinning as a single autograd node.
+//
+// Saved for backward: the rotations, the rest joints, the posed joints and
+// relative transforms (which together give the world transforms), v_posed
+// and the pose itself; the model buffers are only referenced. The backward
+// re-runs the fused skinning and Rodrigues kernels for their own analytic
+// backwards, walks the kinematic tree in reverse, and maps the vertex and
+// joint gradients back to the betas through shapedirs and J_shapedirs.
+class LbsFunction : public torch::autograd::Function<LbsFunction> {
+  public:
+    static auto forward(AutogradContext *ctx, Tensor betas, Tensor pose,
+                        Tensor transl, Tensor v_template, Tensor shapedirs,
+                        Tensor posedirs, Tensor lbs_weights,
+                        Tensor sparse_indices, Tensor sparse_values,
+                        const Precomputed *precomputed, bool pose2rot)
+        -> tensor_list {
+        const auto &tree = *precomputed->kinematic_tree;
+        const auto &low_rank = precomputed->low_rank_posedirs;
+        const auto &block_sparse = precomputed->block_sparse_posedirs;
+
+        auto [v_shaped, rest_joints] =
+            shape_blend(betas, v_template, shapedirs, Tensor(), *precomputed);
+        const auto batch_size = std::max(v_shaped.size(0), pose.size(0));
+        rest_joints = rest_joints.expand({batch_size, -1, -1}).contiguous();
+
+        auto rot_mats =
+            (pose2rot ? rodrigues(pose.reshape({-1, 3})) : pose)
+                .reshape({batch_size, -1, 3, 3});
+        auto ident = torch::eye(3, pose.options());
+        auto pose_feature =
+            (rot_mats.index({Slice(None), Slice(1, None)}) - ident)
+                .view({batch_size, -1});
+        auto v_posed =
+            v_shaped +
+            pose_correctives(pose_feature, posedirs, *precomputed)
+                .view({batch_size, -1, 3});
+
+        auto [posed_joints, A] =
+            batch_rigid_transform(rot_mats, rest_joints, tree);
+
+        auto vertices = skin(v_posed, lbs_weights, sparse_indices,
+                             sparse_values, A) +
+                        transl.unsqueeze(1);
+        auto joints = posed_joints + transl.unsqueeze(1);
+
+        ctx->save_for_backward({betas, pose, transl, shapedirs, posedirs,
+                                lbs_weights, sparse_indices, sparse_values,
+                                rot_mats, rest_joints, posed_joints, A,
+                                v_posed, precomputed->J_shapedirs,
+                                tree.parents,
+                                low_rank ? low_rank->left : Tensor(),
+                                low_rank ? low_rank->right : Tensor(),
+                                block_sparse ? block_sparse->values : Tensor(),
+                                block_sparse ? block_sparse->joints : Tensor(),
+                                block_sparse ? block_sparse->blocks
+                                             : Tensor()});
+        ctx->saved_data["pose2rot"] = pose2rot;
+        if (block_sparse) {
+            ctx->saved_data["block_size"] = block_sparse->block_size;
+            ctx->saved_data["block_ptr"] = block_sparse->block_ptr;
+        }
+        ctx->saved_data["num_levels"] =
+            static_cast<int64_t>(tree.levels.size());
+        for (size_t d = 0; d < tree.levels.size(); ++d) {
+            ctx->saved_data["level_" + std::to_string(d)] = tree.levels[d];
+            ctx->saved_data["parents_" + std::to_string(d)] =
+                tree.level_parents[d];
+        }
+        return {vertices, joints};
+    }
+
+    static auto backward(AutogradContext *ctx, tensor_list grad_outputs)
+        -> tensor_list {
+        auto saved = ctx->get_saved_variables();
+        const auto &betas = saved[0];
+        const auto &pose = saved[1];
+        const auto &transl = saved[2];
+        const auto &shapedirs = saved[3];
+        const auto &posedirs = saved[4];
+        const auto &lbs_weights = saved[5];
+        const auto &sparse_indices = saved[6];
+        const auto &sparse_values = saved[7];
+        const auto &rot_mats = saved[8];
+        const auto &rest_joints = saved[9];
+        const auto &posed_joints = saved[10];
+        const auto &A = saved[11];
+        const auto &v_posed = saved[12];
+        const auto &J_shapedirs = saved[13];
+        const auto &parents = saved[14];
+        const auto &low_rank_left = saved[15];
+        const auto &low_rank_right = saved[16];
+        std::optional<BlockSparsePosedirs> block_sparse;
+        if (saved[17].defined()) {
+            block_sparse.emplace();
+            block_sparse->values = saved[17];
+            block_sparse->joints = saved[18];
+            block_sparse->blocks = saved[19];
+            block_sparse->block_size = ctx->saved_data["block_size"].toInt();
+            block_sparse->block_ptr = ctx->saved_data["block_ptr"].toTensor();
+            block_sparse->num_joints = posedirs.size(0) / 9;
+            block_sparse->num_vertices = v_posed.size(1);
+        }
+        const bool pose2rot = ctx->saved_data["pose2rot"].toBool();
+        const auto num_levels = ctx->saved_data["num_levels"].toInt();
+
+        const auto batch_size = v_posed.size(0);
+        auto grad_verts = grad_outputs[0].defined()
+                              ? grad_outputs[0]
+                              : torch::zeros_like(v_posed);
+        auto grad_joints = grad_outputs[1].defined()
+                               ? grad_outputs[1]
+                               : torch::zeros_like(posed_joints);
+
+        Tensor grad_betas, grad_pose, grad_transl;
+        if (ctx->needs_input_grad(2)) {
+            grad_transl = grad_verts.sum(1) + grad_joints.sum(1);
+            if (transl.size(0) != batch_size) {
+                grad_transl = grad_transl.sum(0, true);
+            }
+        }
+        if (!ctx->needs_input_grad(0) && !ctx->needs_input_grad(1)) {
+            return {grad_betas, grad_pose, grad_transl, Tensor(), Tensor(),
+                    Tensor(),   Tensor(),  Tensor(),    Tensor(), Tensor(),
+                    Tensor()};
+        }
+
+        // Skinning, through the fused kernel's own backward.
+        Tensor grad_v_posed, grad_A;
+        {
+            torch::AutoGradMode enable_grad(true);
+            auto v = v_posed.detach().requires_grad_(true);
+            auto a = A.detach().requires_grad_(true);
+            auto out = skin(v, lbs_weights, sparse_indices, sparse_values, a);
+            auto grads = torch::autograd::grad({out}, {v, a}, {grad_verts});
+            grad_v_posed = grads[0];
+            grad_A = grads[1];
+        }
+
+        // A = [G_R | G_t - G_R j], G_t being the posed joints.
+        auto G_R = A.index({Slice(None), Slice(None), Slice(None, 3),
+                            Slice(None, 3)});
+        auto grad_AR = grad_A.index({Slice(None), Slice(None), Slice(None, 3),
+                                     Slice(None, 3)});
+        auto grad_At = grad_A.index({Slice(None), Slice(None), Slice(None, 3), 3});
+        auto grad_rest =
+            -torch::matmul(G_R.transpose(-1, -2), grad_At.unsqueeze(-1))
+                 .squeeze(-1);
+        auto grad_GR =
+            grad_AR - grad_At.unsqueeze(-1) * rest_joints.unsqueeze(-2);
+        auto grad_Gt = grad_At + grad_joints;
+
+        // Reverse kinematic chain on homogeneous 4x4 matrices: with
+        // G_i = G_p T_i, dT_i = G_p^T dG_i and dG_p += dG_i T_i^T. The
+        // bottom rows of the gradients stay zero.
+        auto G = transform_mat(G_R.reshape({-1, 3, 3}),
+                               posed_joints.reshape({-1, 3, 1}))
+                     .view({batch_size, -1, 4, 4});
+        auto rel_joints = rest_joints.clone();
+        rel_joints.index_put_({Slice(None), Slice(1, None)},
+                              rest_joints.index({Slice(None), Slice(1, None)}) -
+                                  rest_joints.index_select(
+                                      1, parents.index({Slice(1, None)})));
+        auto T = transform_mat(rot_mats.reshape({-1, 3, 3}),
+                               rel_joints.reshape({-1, 3, 1}))
+                     .view({batch_size, -1, 4, 4});
+        auto grad_G = torch::constant_pad_nd(
+            torch::cat({grad_GR, grad_Gt.unsqueeze(-1)}, -1), {0, 0, 0, 1});
+        auto grad_T = torch::empty_like(grad_G);
+        for (auto d = num_levels - 1; d >= 0; --d) {
+            auto idx = ctx->saved_data["level_" + std::to_string(d)].toTensor();
+            auto par =
+                ctx->saved_data["parents_" + std::to_string(d)].toTensor();
+            auto grad_Gi = grad_G.index_select(1, idx);
+            grad_T.index_copy_(
+                1, idx,
+                torch::matmul(G.index_select(1, par).transpose(-1, -2),
+                              grad_Gi));
+            grad_G.index_add_(
+                1, par,
+                torch::matmul(grad_Gi,
+                              T.index_select(1, idx).transpose(-1, -2)));
+        }
+        // The root has G_0 = T_0, and its gradient is complete only now that
+        // every child has added to it.
+        grad_T.select(1, 0).copy_(grad_G.select(1, 0));
+
+        // T_i = [R_i | j_i - j_p]
+        auto grad_R = grad_T.index({Slice(None), Slice(None), Slice(None, 3),
+                                    Slice(None, 3)})
+                          .clone();
+        auto grad_rel = grad_T.index({Slice(None), Slice(None), Slice(None, 3), 3});
+        grad_rest = grad_rest + grad_rel;
+        grad_rest.index_add_(1, parents.index({Slice(1, None)}),
+                             -grad_rel.index({Slice(None), Slice(1, None)}));
+
+        if (ctx->needs_input_grad(1)) {
+            // Pose correctives: v_posed += (R[1:] - I) . posedirs
+            auto grad_offsets = grad_v_posed.view({batch_size, -1});
+            Tensor grad_feature;
+            if (low_rank_left.defined()) {
+                grad_feature =
+                    blend_pose(blend_pose(grad_offsets, low_rank_right.t()),
+                               low_rank_left.t());
+            } else if (block_sparse) {
+                grad_feature = block_sparse_correctives_backward(grad_offsets,
+                                                                 *block_sparse);
+            } else {
+                grad_feature = blend_pose(grad_offsets, posedirs.t());
+            }
+            grad_R.index({Slice(None), Slice(1, None)}) +=
+                grad_feature.view({batch_size, -1, 3, 3});
+            if (pose2rot) {
+                torch::AutoGradMode enable_grad(true);
+                auto p = pose.detach().reshape({-1, 3}).requires_grad_(true);
+                grad_pose = torch::autograd::grad({rodrigues(p)}, {p},
+                                                  {grad_R.view({-1, 3, 3})})[0]
+                                .view(pose.sizes());
+            } else {
+                grad_pose = grad_R.reshape(pose.sizes());
+            }
+        }
+
+        if (ctx->needs_input_grad(0)) {
+            // blend_shape() transposed, with the same storage handling.
+            auto dirs = shapedirs.reshape({-1, shapedirs.size(2)});
+            grad_betas =
+                blend_pose(grad_v_posed.reshape({batch_size, -1}), dirs) +
+                torch::einsum("bjk,jkl->bl", {grad_rest, J_shapedirs});
+            if (betas.size(0) != batch_size) {
+                grad_betas = grad_betas.sum(0, true);
+            }
+        }
+
+        return {grad_betas, grad_pose, grad_transl, Tensor(), Tensor(),
+                Tensor(),   Tensor(),  Tensor(),    Tensor(), Tensor(),
+                Tensor()};
+    }
+};
+} // namespace
+
+auto lbs_fused(const Tensor &betas, const Tensor &pose,
+               const Tensor &v_template, const Tensor &shapedirs,
+               const Tensor &posedirs, const Tensor &lbs_weights,
+               bool pose2rot, const std::optional<Tensor> &transl,
+               const Precomputed &precomputed) -> std::tuple<Tensor, Tensor> {
+    TORCH_CHECK(precomputed.J_template.defined() &&
+                    precomputed.kinematic_tree.has_value(),
+                "lbs_fused: needs the shape regressor and the kinematic tree");
+    const auto &sparse = precomputed.sparse_weights;
+    auto outputs = LbsFunction::apply(
+        betas, pose,
+        transl.has_value() ? *transl : torch::zeros({1, 3}, pose.options()),
+        v_template, shapedirs, posedirs, lbs_weights,
+        sparse ? sparse->indices : Tensor(), sparse ? sparse->values : Tensor(),
+        &precomputed, pose2rot);
+    return std::make_tuple(outputs[0], outputs[1]);
+}
+} // namespace smplx::lbs
@@ -0,0 +1,265 @@
+#include "model_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include "converter.hpp"
+#include "model_registry.hpp"
+#include "smplx.hpp"
+
+namespace smplx {
+
+namespace {
+// The dtypes a model file may hold: those the converter writes, plus the
+// uint32 of raw npz indices.
+auto supported_dtype(int32_t dtype) -> bool {
+    switch (static_cast<c10::ScalarType>(dtype)) {
+    case torch::kFloat32:
+    case torch::kFloat64:
+    case torch::kInt64:
+    case torch::kUInt32:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Bytes of a (ndim, shape, dtype) entry, nullopt for negative dims or an
+// overflowing product.
+auto entry_bytes(const ModelFileEntry &entry) -> std::optional<uint64_t> {
+    uint64_t bytes =
+        c10::elementSize(static_cast<c10::ScalarType>(entry.dtype));
+    for (uint32_t d = 0; d < entry.ndim; ++d) {
+        const auto dim = entry.shape[d];
+        if (dim < 0 ||
+            __builtin_mul_overflow(bytes, static_cast<uint64_t>(dim), &bytes)) {
+            return std::nullopt;
+        }
+    }
+    return bytes;
+}
+} // namespace
+
+struct MappedModelFile::Mapping {
+    void *addr{nullptr};
+    size_t size{0};
+
+    ~Mapping() {
+        if (addr != nullptr && addr != MAP_FAILED) {
+            munmap(addr, size);
+        }
+    }
+};
+
+MappedModelFile::MappedModelFile(const std::string &path)
+    : mapping_(std::make_shared<Mapping>()) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open model file " + path);
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Unable to stat model file " + path);
+    }
+    if (static_cast<size_t>(st.st_size) < sizeof(ModelFileHeader)) {
+        close(fd);
+        throw std::runtime_error("Truncated model file " + path);
+    }
+
+    // MAP_PRIVATE + PROT_WRITE: pages stay shared with the page cache (and
+    // with other processes mapping the same file) until somebody writes to
+    // them, in which case the writer gets a private copy instead of a
+    // SIGSEGV.
+    mapping_->size = static_cast<size_t>(st.st_size);
+    mapping_->addr = mmap(nullptr, mapping_->size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping_->addr == MAP_FAILED) {
+        throw std::runtime_error("Unable to mmap model file " + path);
+    }
+    madvise(mapping_->addr, mapping_->size, MADV_WILLNEED);
+
+    const auto *base = static_cast<const char *>(mapping_->addr);
+    ModelFileHeader header{};
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, kModelFileMagic, sizeof(kModelFileMagic))) {
+        throw std::runtime_error(path + " is not a torchure_smplx model file");
+    }
+    if (header.version != kModelFileVersion) {
+        throw std::runtime_error(
+            "Unsupported model file version " + std::to_string(header.version) +
+            " in " + path + " (expected " + std::to_string(kModelFileVersion) +
+            "), please re-run the converter");
+    }
+    if (header.file_size != mapping_->size ||
+        sizeof(header) + header.num_entries * sizeof(ModelFileEntry) >
+            mapping_->size) {
+        throw std::runtime_error("Corrupted model file " + path);
+    }
+
+    for (uint32_t i = 0; i < header.num_entries; ++i) {
+        ModelFileEntry entry{};
+        std::memcpy(&entry, base + sizeof(header) + i * sizeof(entry),
+                    sizeof(entry));
+        uint64_t end = 0;
+        if (entry.offset % kModelFileAlignment != 0 ||
+            __builtin_add_overflow(entry.offset, entry.nbytes, &end) ||
+            end > mapping_->size || entry.ndim > kModelFileMaxDims ||
+            !supported_dtype(entry.dtype) ||
+            entry_bytes(entry) != entry.nbytes) {
+            throw std::runtime_error("Corrupted entry in model file " + path);
+        }
+        entry.name[kModelFileMaxName - 1] = '\0';
+        entries_.emplace(entry.name, entry);
+    }
+}
+
+auto MappedModelFile::names() const -> std::vector<std::string> {
+    std::vector<std::string> out;
+    out.reserve(entries_.size());
+    for (const auto &kv : entries_) {
+        out.push_back(kv.first);
+    }
+    return out;
+}
+
+auto MappedModelFile::tensor(const std::string &name) const -> Tensor {
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+        throw std::runtime_error("Missing tensor in model file: '" + name +
+                                 "'");
+    }
+    const auto &entry = it->second;
+    std::vector<int64_t> shape(entry.shape, entry.shape + entry.ndim);
+    auto *data = static_cast<char *>(mapping_->addr) + entry.offset;
+    // The deleter owns a reference to the mapping: the bytes stay valid for
+    // as long as any tensor (or view of it) is alive.
+    auto mapping = mapping_;
+    return torch::from_blob(
+        data, shape, [mapping](void *) {},
+        torch::TensorOptions().dtype(
+            static_cast<c10::ScalarType>(entry.dtype)));
+}
+
+auto save_model_file(const std::string &path,
+                     const std::vector<std::pair<std::string, Tensor>> &buffers)
+    -> void {
+    auto align = [](uint64_t v) {
+        return (v + kModelFileAlignment - 1) / kModelFileAlignment *
+               kModelFileAlignment;
+    };
+
+    std::vector<Tensor> contiguous;
+    std::vector<ModelFileEntry> entries;
+    contiguous.reserve(buffers.size());
+    entries.reserve(buffers.size());
+
+    uint64_t offset = align(sizeof(ModelFileHeader) +
+                            buffers.size() * sizeof(ModelFileEntry));
+    const uint64_t data_offset = offset;
+    for (const auto &[name, tensor] : buffers) {
+        if (name.size() >= kModelFileMaxName) {
+            throw std::runtime_error("Tensor name too long: '" + name + "'");
+        }
+        if (tensor.dim() > static_cast<int64_t>(kModelFileMaxDims)) {
+            throw std::runtime_error("Tensor '" + name + "' has too many dims");
+        }
+        if (!supported_dtype(static_cast<int32_t>(tensor.scalar_type()))) {
+            throw std::runtime_error("Tensor '" + name +
+                                     "' has an unsupported dtype");
+        }
+        auto t = tensor.detach().to(torch::kCPU).contiguous();
+        ModelFileEntry entry{};
+        std::strncpy(entry.name, name.c_str(), kModelFileMaxName - 1);
+        entry.dtype = static_cast<int32_t>(t.scalar_type());
+        entry.ndim = static_cast<uint32_t>(t.dim());
+        for (int64_t d = 0; d < t.dim(); ++d) {
+            entry.shape[d] = t.size(d);
+        }
+        entry.offset = offset;
+        entry.nbytes = t.nbytes();
+        offset = align(offset + entry.nbytes);
+        entries.push_back(entry);
+        contiguous.push_back(std::move(t));
+    }
+
+    ModelFileHeader header{};
+    std::memcpy(header.magic, kModelFileMagic, sizeof(kModelFileMagic));
+    header.version = kModelFileVersion;
+    header.num_entries = static_cast<uint32_t>(entries.size());
+    header.data_offset = data_offset;
+    header.file_size = offset;
+
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        throw std::runtime_error("Unable to write model file " + path);
+    }
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(entries.data()),
+              entries.size() * sizeof(ModelFileEntry));
+
+    const std::vector<char> zeros(kModelFileAlignment, 0);
+    uint64_t written = sizeof(header) + entries.size() * sizeof(ModelFileEntry);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        ofs.write(zeros.data(), entries[i].offset - written);
+        ofs.write(static_cast<const char *>(contiguous[i].data_ptr()),
+                  entries[i].nbytes);
+        written = entries[i].offset + entries[i].nbytes;
+    }
+    ofs.write(zeros.data(), offset - written);
+    if (!ofs) {
+        throw std::runtime_error("Failed writing model file " + path);
+    }
+}
+
+auto convert_npz_to_model_file(const std::string &npz_path,
+                               const std::string &out_path, torch::Dtype dtype)
+    -> void {
+    cnpy::npz_t data = cnpy::npz_load(npz_path);
+
+    auto get = [&](const std::string &name, torch::Dtype t) -> Tensor {
+        if (!data.count(name)) {
+            throw std::runtime_error("Missing tensor in npz: '" + name + "'");
+        }
+        return cnpyToTensor(data.at(name), t);
+    };
+
+    auto posedirs = get("posedirs", torch::kFloat64);
+    posedirs = posedirs.reshape({-1, posedirs.size(2)})
+                   .transpose(0, 1)
+                   .contiguous()
+                   .to(dtype);
+
+    // Same tree as when the npz is loaded directly. kintree_table[0] holds
+    // the parent of each joint, the root having an invalid (max uint32)
+    // parent; a model with another tree is refused rather than converted
+    // into one that loads differently from its npz.
+    auto parents = npz_model_parents();
+    if (data.count("kintree_table")) {
+        auto kintree = get("kintree_table", torch::kInt64)[0];
+        if (kintree.numel() != parents.numel() ||
+            !torch::equal(kintree.slice(0, 1), parents.slice(0, 1))) {
+            throw std::runtime_error(
+                "kintree_table of " + npz_path +
+                " does not match the SMPL kinematic tree");
+        }
+    }
+
+    save_model_file(out_path,
+                    {
+                        {"shapedirs", get("shapedirs", dtype)},
+                        {"v_template", get("v_template", dtype)},
+                        {"J_regressor", get("J_regressor", dtype)},
+                        {"posedirs", posedirs},
+                        {"weights", get("weights", dtype)},
+                        {"f", get("f", torch::kInt64)},
+                        {"parents", parents},
+                    });
+}
+
+} // namespace smplx
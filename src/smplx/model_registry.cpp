@@ -0,0 +1,187 @@
+#include "model_registry.hpp"
+#include <filesystem>
+#include "converter.hpp"
+#include "model_file.hpp"
+#include "smplx.hpp"
+#include "utils.hpp"
+
+namespace smplx {
+
+auto ModelData::nbytes() const -> size_t {
+    size_t total = 0;
+    for (const auto *t : {&shapedirs, &v_template, &J_regressor, &posedirs,
+                          &lbs_weights, &faces, &parents}) {
+        if (t->defined()) {
+            total += t->nbytes();
+        }
+    }
+    return total;
+}
+
+auto npz_model_parents() -> Tensor {
+    return torch::tensor(std::vector<int64_t>(std::begin(SMPL::parents),
+                                              std::end(SMPL::parents)),
+                         torch::kInt64);
+}
+
+namespace {
+
+auto load_npz(const std::string &model_path) -> ModelData {
+    // Only the members used below are read and inflated, concurrently.
+    cnpy::npz_t data;
+    try {
+        data = cnpy::npz_load_selected(model_path, SMPL::kRequiredNpzArrays);
+    } catch (const std::exception &e) {
+        throw std::runtime_error(std::string("Failed to load npz file: ") +
+                                 e.what());
+    }
+
+    auto load_required_tensor = [&](const std::string &name,
+                                    torch::Dtype dtype) -> torch::Tensor {
+        if (!data.count(name)) {
+            throw std::runtime_error("Missing tensor in npz: '" + name + "'");
+        }
+        try {
+            return cnpyToTensor(data.at(name), dtype);
+        } catch (const std::exception &e) {
+            throw std::runtime_error("Failed to load tensor '" + name +
+                                     "': " + e.what());
+        }
+    };
+
+    ModelData out;
+    out.shapedirs = load_required_tensor("shapedirs", torch::kFloat64);
+    out.faces = load_required_tensor("f", torch::kInt64);
+    out.v_template = load_required_tensor("v_template", torch::kFloat64);
+    out.J_regressor = load_required_tensor("J_regressor", torch::kFloat64);
+
+    auto posedirs = load_required_tensor("posedirs", torch::kFloat64);
+    out.posedirs =
+        posedirs.reshape({-1, posedirs.size(2)}).transpose(0, 1).contiguous();
+
+    out.lbs_weights = load_required_tensor("weights", torch::kFloat64);
+
+    out.parents = npz_model_parents();
+    return out;
+}
+
+auto load_mapped(const std::string &model_path) -> ModelData {
+    MappedModelFile file(model_path);
+
+    ModelData out;
+    out.shapedirs = file.tensor("shapedirs");
+    out.faces = file.tensor("f");
+    out.v_template = file.tensor("v_template");
+    out.J_regressor = file.tensor("J_regressor");
+    out.posedirs = file.tensor("posedirs");
+    out.lbs_weights = file.tensor("weights");
+    out.parents = file.tensor("parents");
+    return out;
+}
+
+} // namespace
+
+auto load_model_data(const std::string &model_path, torch::Device device,
+                     std::optional<torch::Dtype> dtype) -> ModelData {
+    if (!std::filesystem::exists(model_path)) {
+        throw std::runtime_error(model_path + " does not exist");
+    }
+
+    ModelData out;
+    if (check_file_ext(model_path.c_str(), kModelFileExtension)) {
+        out = load_mapped(model_path);
+    } else if (check_file_ext(model_path.c_str(), "npz")) {
+        out = load_npz(model_path);
+    } else {
+        throw std::runtime_error(
+            "invalid extension " +
+            std::filesystem::path(model_path).extension().string());
+    }
+
+    // On CPU with a matching dtype these are no-ops, so mapped buffers keep
+    // aliasing the file.
+    const auto buffer_dtype = dtype.value_or(out.shapedirs.scalar_type());
+    for (auto *t : {&out.shapedirs, &out.v_template, &out.J_regressor,
+                    &out.posedirs, &out.lbs_weights}) {
+        *t = t->to(device, buffer_dtype);
+    }
+    out.faces = out.faces.to(device);
+    out.parents = out.parents.to(device);
+    out.device = device;
+    out.dtype = buffer_dtype;
+    out.path = model_path;
+    return out;
+}
+
+auto ModelRegistry::instance() -> ModelRegistry & {
+    static ModelRegistry registry;
+    return registry;
+}
+
+auto ModelRegistry::get(const ModelKey &key)
+    -> std::shared_ptr<const ModelData> {
+    std::promise<std::shared_ptr<const ModelData>> promise;
+    Entry entry;
+    bool owner = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            entry = it->second;
+        } else {
+            entry = promise.get_future().share();
+            entries_.emplace(key, entry);
+            owner = true;
+        }
+    }
+
+    // The load runs outside the lock, so other keys can load concurrently
+    // while requests for this key block on the shared future.
+    if (owner) {
+        try {
+            promise.set_value(std::make_shared<const ModelData>(
+                load_model_data(key.path, key.device, key.dtype)));
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                entries_.erase(key);
+            }
+            promise.set_exception(std::current_exception());
+        }
+    }
+    return entry.get();
+}
+
+auto ModelRegistry::preload(const std::vector<ModelKey> &keys) -> void {
+    std::vector<std::future<std::shared_ptr<const ModelData>>> loads;
+    loads.reserve(keys.size());
+    for (const auto &key : keys) {
+        loads.push_back(
+            std::async(std::launch::async, [this, key] { return get(key); }));
+    }
+    for (auto &load : loads) {
+        load.get();
+    }
+}
+
+auto ModelRegistry::contains(const ModelKey &key) -> bool {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.count(key) > 0;
+}
+
+auto ModelRegistry::size() -> size_t {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+auto ModelRegistry::erase(const ModelKey &key) -> void {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(key);
+}
+
+auto ModelRegistry::clear() -> void {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+} // namespace smplx
@@ -0,0 +1,247 @@
+#include "pose_correctives.hpp"
+#include <cmath>
+#include <vector>
+#include "ATen/CPUGeneratorImpl.h"
+#include "ATen/Dispatch.h"
+#include "ATen/OpMathType.h"
+#include "ATen/Parallel.h"
+#include "rotation.hpp"
+#include "torch/torch.h"
+
+namespace smplx::lbs {
+
+namespace {
+// Fixed seed of the pose benchmark set.
+constexpr uint64_t kPoseBenchmarkSeed = 0x5eed;
+
+// Each task owns whole vertex blocks, so the output needs no reduction.
+auto block_sparse_forward_cpu(const Tensor &pose_feature,
+                              const BlockSparsePosedirs &posedirs) -> Tensor {
+    const auto B = pose_feature.size(0);
+    const auto NJ = posedirs.num_joints;
+    const auto V = posedirs.num_vertices;
+    const auto BS = posedirs.block_size;
+    const auto C = BS * 3;
+    auto feature = pose_feature.to(posedirs.values.scalar_type()).contiguous();
+    auto out = torch::zeros({B, V * 3}, feature.options());
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(
+        at::kBFloat16, at::kHalf, feature.scalar_type(),
+        "block_sparse_forward_cpu", [&] {
+            using acc_t = at::opmath_type<scalar_t>;
+            const auto *f = feature.data_ptr<scalar_t>();
+            const auto *w = posedirs.values.data_ptr<scalar_t>();
+            const auto *joints = posedirs.joints.data_ptr<int64_t>();
+            const auto *ptr = posedirs.block_ptr.data_ptr<int64_t>();
+            auto *o = out.data_ptr<scalar_t>();
+
+            // A joint at rest has R - I = 0 exactly in every sample.
+            std::vector<char> active(NJ, 0);
+            for (int64_t b = 0; b < B; ++b) {
+                for (int64_t k = 0; k < NJ * 9; ++k) {
+                    if (static_cast<acc_t>(f[b * NJ * 9 + k]) != acc_t(0)) {
+                        active[k / 9] = 1;
+                    }
+                }
+            }
+
+            at::parallel_for(
+                0, posedirs.num_blocks(), 1, [&](int64_t begin, int64_t end) {
+                    std::vector<acc_t> acc(C);
+                    for (int64_t blk = begin; blk < end; ++blk) {
+                        const int64_t cols = std::min(BS, V - blk * BS) * 3;
+                        for (int64_t b = 0; b < B; ++b) {
+                            std::fill(acc.begin(), acc.end(), acc_t(0));
+                            for (int64_t k = ptr[blk]; k < ptr[blk + 1]; ++k) {
+                                const int64_t j = joints[k];
+                                if (!active[j]) {
+                                    continue;
+                                }
+                                const auto *fj = f + (b * NJ + j) * 9;
+                                const auto *wk = w + k * 9 * C;
+                                for (int r = 0; r < 9; ++r) {
+                                    const acc_t fr = fj[r];
+                                    if (fr == acc_t(0)) {
+                                        continue;
+                                    }
+                                    for (int64_t c = 0; c < cols; ++c) {
+                                        acc[c] += fr * static_cast<acc_t>(
+                                                           wk[r * C + c]);
+                                    }
+                                }
+                            }
+                            auto *ob = o + b * V * 3 + blk * C;
+                            for (int64_t c = 0; c < cols; ++c) {
+                                ob[c] = static_cast<scalar_t>(acc[c]);
+                            }
+                        }
+                    }
+                });
+        });
+    return out.to(pose_feature.scalar_type());
+}
+
+// Differentiable ATen version: one (9 x block) product per kept block,
+// scattered into the vertex blocks.
+auto block_sparse_forward_aten(const Tensor &pose_feature,
+                               const BlockSparsePosedirs &posedirs) -> Tensor {
+    const auto B = pose_feature.size(0);
+    const auto &values = posedirs.values;
+    auto feature = pose_feature.to(values.scalar_type())
+                       .view({B, posedirs.num_joints, 9})
+                       .index_select(1, posedirs.joints);
+    auto contrib = torch::einsum("bnk,nkc->bnc", {feature, values});
+    auto out = torch::zeros(
+        {B, posedirs.num_blocks(), posedirs.block_size * 3}, contrib.options());
+    out = out.index_add(1, posedirs.blocks, contrib);
+    return out.view({B, -1})
+        .narrow(1, 0, posedirs.num_vertices * 3)
+        .to(pose_feature.scalar_type());
+}
+} // namespace
+
+auto block_sparse_posedirs(const Tensor &posedirs, double threshold,
+                           int64_t block_size) -> BlockSparsePosedirs {
+    TORCH_CHECK(block_size > 0, "block_sparse_posedirs: block_size must be "
+                                "positive");
+    TORCH_CHECK(posedirs.dim() == 2 && posedirs.size(0) % 9 == 0 &&
+                    posedirs.size(1) % 3 == 0,
+                "block_sparse_posedirs: expected posedirs of shape "
+                "(9 * (J - 1), V * 3)");
+    torch::NoGradGuard no_grad;
+    auto dense = posedirs.to(torch::kCPU, torch::kFloat64);
+
+    BlockSparsePosedirs out;
+    out.block_size = block_size;
+    out.num_joints = dense.size(0) / 9;
+    out.num_vertices = dense.size(1) / 3;
+    out.threshold = threshold;
+    const auto num_blocks = (out.num_vertices + block_size - 1) / block_size;
+    const auto C = block_size * 3;
+
+    // (num_blocks, num_joints, 9, C), the last block zero padded.
+    auto blocked = torch::constant_pad_nd(
+                       dense, {0, num_blocks * C - dense.size(1)})
+                       .view({out.num_joints, 9, num_blocks, C})
+                       .permute({2, 0, 1, 3});
+    auto keep = blocked.abs().amax({2, 3}) > threshold;
+    // nonzero() is row-major, so the kept blocks come sorted by vertex block.
+    auto nz = keep.nonzero();
+    out.blocks = nz.select(1, 0).contiguous();
+    out.joints = nz.select(1, 1).contiguous();
+    out.values = blocked.index({out.blocks, out.joints}).contiguous();
+    out.block_ptr = torch::cat({torch::zeros({1}, torch::kLong),
+                                keep.sum(1).cumsum(0)});
+
+    std::tie(out.max_vertex_error, out.mean_vertex_error) =
+        pose_corrective_error(dense, [&](const Tensor &feature) {
+            return block_sparse_correctives(feature, out);
+        });
+
+    out.values = out.values.to(posedirs.device(), posedirs.scalar_type());
+    out.joints = out.joints.to(posedirs.device());
+    out.blocks = out.blocks.to(posedirs.device());
+    return out;
+}
+
+auto block_sparse_correctives(const Tensor &pose_feature,
+                              const BlockSparsePosedirs &posedirs) -> Tensor {
+    TORCH_CHECK(pose_feature.dim() == 2 &&
+                    pose_feature.size(1) == posedirs.num_joints * 9,
+                "block_sparse_correctives: expected pose_feature of shape "
+                "(B, 9 * (J - 1))");
+    const bool needs_grad =
+        torch::GradMode::is_enabled() &&
+        (pose_feature.requires_grad() || posedirs.values.requires_grad());
+    if (pose_feature.device().is_cpu() && posedirs.values.device().is_cpu() &&
+        !needs_grad) {
+        return block_sparse_forward_cpu(pose_feature, posedirs);
+    }
+    return block_sparse_forward_aten(pose_feature, posedirs);
+}
+
+auto block_sparse_correctives_backward(const Tensor &grad_offsets,
+                                       const BlockSparsePosedirs &posedirs)
+    -> Tensor {
+    const auto B = grad_offsets.size(0);
+    const auto C = posedirs.block_size * 3;
+    const auto &values = posedirs.values;
+    auto grad = torch::constant_pad_nd(
+                    grad_offsets.to(values.scalar_type()).reshape({B, -1}),
+                    {0, posedirs.num_blocks() * C - posedirs.num_vertices * 3})
+                    .view({B, posedirs.num_blocks(), C})
+                    .index_select(1, posedirs.blocks);
+    auto contrib = torch::einsum("bnc,nkc->bnk", {grad, values});
+    return torch::zeros({B, posedirs.num_joints, 9}, contrib.options())
+        .index_add(1, posedirs.joints, contrib)
+        .view({B, -1})
+        .to(grad_offsets.scalar_type());
+}
+
+auto factorize_posedirs(const Tensor &posedirs, std::optional<int64_t> rank,
+                        std::optional<double> tolerance) -> LowRankPosedirs {
+    TORCH_CHECK(rank.has_value() || tolerance.has_value(),
+                "factorize_posedirs: needs a rank or a tolerance");
+    // SVD in double, whatever the storage dtype.
+    auto dense = posedirs.to(torch::kCPU, torch::kFloat64);
+    auto [U, S, Vh] = torch::linalg_svd(dense, /*full_matrices=*/false);
+
+    int64_t r = 0;
+    if (rank.has_value()) {
+        r = std::min<int64_t>(*rank, S.size(0));
+    } else {
+        // Discarding singular values i >= r leaves a Frobenius error of
+        // sqrt(sum_{i >= r} s_i^2).
+        auto tail = S.pow(2).flip(0).cumsum(0).flip(0);
+        auto budget = *tolerance * *tolerance * tail[0].item<double>();
+        r = S.size(0);
+        auto t = tail.accessor<double, 1>();
+        while (r > 1 && t[r - 1] <= budget) {
+            --r;
+        }
+    }
+    TORCH_CHECK(r > 0, "factorize_posedirs: rank must be positive");
+
+    LowRankPosedirs out;
+    // Singular values folded into the left factor.
+    auto left = U.narrow(1, 0, r) * S.narrow(0, 0, r);
+    auto right = Vh.narrow(0, 0, r);
+    std::tie(out.max_vertex_error, out.mean_vertex_error) =
+        pose_corrective_error(dense, [&](const Tensor &feature) {
+            return torch::matmul(torch::matmul(feature, left), right);
+        });
+    out.left = left.to(posedirs.device(), posedirs.scalar_type()).contiguous();
+    out.right =
+        right.to(posedirs.device(), posedirs.scalar_type()).contiguous();
+    return out;
+}
+
+auto pose_benchmark_features(int64_t num_joints, int64_t num_poses,
+                             torch::Dtype dtype) -> Tensor {
+    auto gen = at::detail::createCPUGenerator(kPoseBenchmarkSeed);
+    auto aa = torch::randn({num_poses * num_joints, 3}, gen,
+                           torch::dtype(torch::kFloat64)) *
+              0.5;
+    auto rot_mats = rodrigues(aa).view({num_poses, num_joints, 3, 3});
+    auto ident = torch::eye(3, torch::dtype(torch::kFloat64));
+    return (rot_mats.narrow(1, 1, num_joints - 1) - ident)
+        .reshape({num_poses, -1})
+        .to(dtype);
+}
+
+auto pose_corrective_error(const Tensor &posedirs,
+                           const std::function<Tensor(const Tensor &)> &approx,
+                           int64_t num_poses) -> std::tuple<double, double> {
+    torch::NoGradGuard no_grad;
+    auto dense = posedirs.to(torch::kCPU, torch::kFloat64);
+    const auto num_joints = dense.size(0) / 9 + 1;
+    auto feature = pose_benchmark_features(num_joints, num_poses);
+    auto diff = (torch::matmul(feature, dense) -
+                 approx(feature).to(torch::kCPU, torch::kFloat64))
+                    .view({num_poses, -1, 3})
+                    .norm(2, -1);
+    return std::make_tuple(diff.max().item<double>(),
+                           diff.mean().item<double>());
+}
+
+} // namespace smplx::lbs
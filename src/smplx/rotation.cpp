@@ -0,0 +1,366 @@
+#include "rotation.hpp"
+#include <cmath>
+#include "ATen/Dispatch.h"
+#include "ATen/OpMathType.h"
+#include "ATen/Parallel.h"
+#include "torch/torch.h"
+
+namespace smplx::lbs {
+namespace {
+using torch::autograd::AutogradContext;
+using torch::autograd::tensor_list;
+
+// Rotations per task; one rotation is a few dozen flops.
+constexpr int64_t kRotationGrainSize = 1024;
+
+// Below this squared angle a, b and their derivatives use their Taylor
+// series; seven terms keep the truncation error under 1e-15 up to here,
+// while above it the closed forms no longer suffer from cancellation.
+constexpr double kSeriesThreshold = 0.25;
+
+// Series in s = t^2: a(s) = sum (-s)^n / (2n + 1)!, b(s) = sum (-s)^n / (2n + 2)!
+constexpr double kSinSeries[] = {1.0,
+                                 -1.0 / 6.0,
+                                 1.0 / 120.0,
+                                 -1.0 / 5040.0,
+                                 1.0 / 362880.0,
+                                 -1.0 / 39916800.0,
+                                 1.0 / 6227020800.0};
+constexpr double kCosSeries[] = {1.0 / 2.0,
+                                 -1.0 / 24.0,
+                                 1.0 / 720.0,
+                                 -1.0 / 40320.0,
+                                 1.0 / 3628800.0,
+                                 -1.0 / 479001600.0,
+                                 1.0 / 87178291200.0};
+constexpr int kSeriesTerms = sizeof(kSinSeries) / sizeof(kSinSeries[0]);
+
+// a, b and their derivatives w.r.t. s = t^2.
+template <typename acc_t> struct RodriguesCoeffs {
+    acc_t a, b, da, db;
+};
+
+template <typename acc_t>
+inline auto rodrigues_coeffs(acc_t s) -> RodriguesCoeffs<acc_t> {
+    RodriguesCoeffs<acc_t> c;
+    if (s < acc_t(kSeriesThreshold)) {
+        c.a = c.b = c.da = c.db = acc_t(0);
+        for (int n = kSeriesTerms - 1; n >= 0; --n) {
+            c.a = c.a * s + acc_t(kSinSeries[n]);
+            c.b = c.b * s + acc_t(kCosSeries[n]);
+        }
+        for (int n = kSeriesTerms - 1; n >= 1; --n) {
+            c.da = c.da * s + acc_t(n * kSinSeries[n]);
+            c.db = c.db * s + acc_t(n * kCosSeries[n]);
+        }
+        return c;
+    }
+    const acc_t t = std::sqrt(s);
+    const acc_t half_sin = std::sin(t / 2);
+    c.a = std::sin(t) / t;
+    c.b = 2 * half_sin * half_sin / s;
+    c.da = (std::cos(t) - c.a) / (2 * s);
+    c.db = (c.a - 2 * c.b) / (2 * s);
+    return c;
+}
+
+// R = I + a K + b (r r^T - s I), written out entry by entry.
+template <typename scalar_t, typename acc_t>
+inline void rodrigues_matrix(acc_t x, acc_t y, acc_t z, acc_t a, acc_t b,
+                             scalar_t *R) {
+    R[0] = static_cast<scalar_t>(1 - b * (y * y + z * z));
+    R[1] = static_cast<scalar_t>(b * x * y - a * z);
+    R[2] = static_cast<scalar_t>(b * x * z + a * y);
+    R[3] = static_cast<scalar_t>(b * x * y + a * z);
+    R[4] = static_cast<scalar_t>(1 - b * (x * x + z * z));
+    R[5] = static_cast<scalar_t>(b * y * z - a * x);
+    R[6] = static_cast<scalar_t>(b * x * z - a * y);
+    R[7] = static_cast<scalar_t>(b * y * z + a * x);
+    R[8] = static_cast<scalar_t>(1 - b * (x * x + y * y));
+}
+
+auto rodrigues_forward_cpu(const Tensor &rot_vecs, const Tensor &out)
+    -> void {
+    const auto N = rot_vecs.size(0);
+    AT_DISPATCH_FLOATING_TYPES_AND2(
+        at::kBFloat16, at::kHalf, rot_vecs.scalar_type(),
+        "rodrigues_forward_cpu", [&] {
+            using acc_t = at::opmath_type<scalar_t>;
+            const auto *r = rot_vecs.data_ptr<scalar_t>();
+            auto *o = out.data_ptr<scalar_t>();
+            at::parallel_for(
+                0, N, kRotationGrainSize, [&](int64_t begin, int64_t end) {
+                    for (int64_t i = begin; i < end; ++i) {
+                        const acc_t x = r[i * 3 + 0];
+                        const acc_t y = r[i * 3 + 1];
+                        const acc_t z = r[i * 3 + 2];
+                        const auto c = rodrigues_coeffs(x * x + y * y + z * z);
+                        rodrigues_matrix(x, y, z, c.a, c.b, o + i * 9);
+                    }
+                });
+        });
+}
+
+// With s = |r|^2, ga = <G, K>, gb = <G, r r^T - s I>:
+//   dL/dr = 2 r (a' ga + b' gb - b tr G) + a w + b (G + G^T) r
+// where w = (G21 - G12, G02 - G20, G10 - G01), so that ga = w . r.
+auto rodrigues_backward_cpu(const Tensor &grad, const Tensor &rot_vecs)
+    -> Tensor {
+    const auto N = rot_vecs.size(0);
+    auto grad_r = torch::empty_like(rot_vecs);
+    AT_DISPATCH_FLOATING_TYPES_AND2(
+        at::kBFloat16, at::kHalf, rot_vecs.scalar_type(),
+        "rodrigues_backward_cpu", [&] {
+            using acc_t = at::opmath_type<scalar_t>;
+            const auto *r = rot_vecs.data_ptr<scalar_t>();
+            const auto *g = grad.data_ptr<scalar_t>();
+            auto *gr = grad_r.data_ptr<scalar_t>();
+            at::parallel_for(
+                0, N, kRotationGrainSize, [&](int64_t begin, int64_t end) {
+                    for (int64_t i = begin; i < end; ++i) {
+                        const acc_t v[3] = {r[i * 3 + 0], r[i * 3 + 1],
+                                            r[i * 3 + 2]};
+                        acc_t G[9];
+                        for (int k = 0; k < 9; ++k) {
+                            G[k] = g[i * 9 + k];
+                        }
+                        const acc_t s =
+                            v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+                        const auto c = rodrigues_coeffs(s);
+
+                        const acc_t w[3] = {G[7] - G[5], G[2] - G[6],
+                                            G[3] - G[1]};
+                        const acc_t trace = G[0] + G[4] + G[8];
+                        acc_t sym_r[3]; // (G + G^T) r
+                        acc_t rGr = 0;
+                        for (int m = 0; m < 3; ++m) {
+                            sym_r[m] = 0;
+                            for (int n = 0; n < 3; ++n) {
+                                sym_r[m] += (G[m * 3 + n] + G[n * 3 + m]) * v[n];
+                                rGr += v[m] * G[m * 3 + n] * v[n];
+                            }
+                        }
+                        const acc_t ga = w[0] * v[0] + w[1] * v[1] + w[2] * v[2];
+                        const acc_t gb = rGr - s * trace;
+                        const acc_t radial =
+                            2 * (c.da * ga + c.db * gb - c.b * trace);
+                        for (int m = 0; m < 3; ++m) {
+                            gr[i * 3 + m] = static_cast<scalar_t>(
+                                radial * v[m] + c.a * w[m] + c.b * sym_r[m]);
+                        }
+                    }
+                });
+        });
+    return grad_r;
+}
+
+class RodriguesFunction : public torch::autograd::Function<RodriguesFunction> {
+  public:
+    static auto forward(AutogradContext *ctx, Tensor rot_vecs) -> Tensor {
+        rot_vecs = rot_vecs.contiguous();
+        ctx->save_for_backward({rot_vecs});
+        auto out = torch::empty({rot_vecs.size(0), 3, 3}, rot_vecs.options());
+        rodrigues_forward_cpu(rot_vecs, out);
+        return out;
+    }
+
+    static auto backward(AutogradContext *ctx, tensor_list grad_outputs)
+        -> tensor_list {
+        auto rot_vecs = ctx->get_saved_variables()[0];
+        return {rodrigues_backward_cpu(grad_outputs[0].contiguous(), rot_vecs)};
+    }
+};
+
+// Same closed form with ATen ops. The closed-form branch is evaluated on a
+// clamped s, so that the discarded values stay finite and torch::where
+// does not propagate NaN gradients.
+auto rodrigues_aten(const Tensor &rot_vecs) -> Tensor {
+    auto s = rot_vecs.pow(2).sum(1, true);
+    auto small = s < kSeriesThreshold;
+
+    auto a_series = torch::zeros_like(s), b_series = torch::zeros_like(s);
+    for (int n = kSeriesTerms - 1; n >= 0; --n) {
+        a_series = a_series * s + kSinSeries[n];
+        b_series = b_series * s + kCosSeries[n];
+    }
+    auto s_safe = torch::where(small, torch::ones_like(s), s);
+    auto t = s_safe.sqrt();
+    auto a = torch::where(small, a_series, t.sin() / t);
+    auto b = torch::where(small, b_series, 2 * (t / 2).sin().pow(2) / s_safe);
+
+    auto r = rot_vecs.unbind(1);
+    auto x = r[0].unsqueeze(1), y = r[1].unsqueeze(1), z = r[2].unsqueeze(1);
+    return torch::cat({1 - b * (y * y + z * z), b * x * y - a * z,
+                       b * x * z + a * y, b * x * y + a * z,
+                       1 - b * (x * x + z * z), b * y * z - a * x,
+                       b * x * z - a * y, b * y * z + a * x,
+                       1 - b * (x * x + y * y)},
+                      1)
+        .view({-1, 3, 3});
+}
+
+// R = I + s P(q), s = 2 / |q|^2, P the quadratic part of the standard
+// unit quaternion formula.
+template <typename scalar_t, typename acc_t>
+inline void quaternion_matrix(acc_t w, acc_t x, acc_t y, acc_t z, acc_t s,
+                              scalar_t *R) {
+    R[0] = static_cast<scalar_t>(1 - s * (y * y + z * z));
+    R[1] = static_cast<scalar_t>(s * (x * y - w * z));
+    R[2] = static_cast<scalar_t>(s * (x * z + w * y));
+    R[3] = static_cast<scalar_t>(s * (x * y + w * z));
+    R[4] = static_cast<scalar_t>(1 - s * (x * x + z * z));
+    R[5] = static_cast<scalar_t>(s * (y * z - w * x));
+    R[6] = static_cast<scalar_t>(s * (x * z - w * y));
+    R[7] = static_cast<scalar_t>(s * (y * z + w * x));
+    R[8] = static_cast<scalar_t>(1 - s * (x * x + y * y));
+}
+
+auto quaternion_forward_cpu(const Tensor &quats) -> Tensor {
+    const auto N = quats.size(0);
+    auto out = torch::empty({N, 3, 3}, quats.options());
+    AT_DISPATCH_FLOATING_TYPES_AND2(
+        at::kBFloat16, at::kHalf, quats.scalar_type(),
+        "quaternion_forward_cpu", [&] {
+            using acc_t = at::opmath_type<scalar_t>;
+            const auto *q = quats.data_ptr<scalar_t>();
+            auto *o = out.data_ptr<scalar_t>();
+            at::parallel_for(
+                0, N, kRotationGrainSize, [&](int64_t begin, int64_t end) {
+                    for (int64_t i = begin; i < end; ++i) {
+                        const acc_t w = q[i * 4 + 0], x = q[i * 4 + 1],
+                                    y = q[i * 4 + 2], z = q[i * 4 + 3];
+                        const acc_t s = 2 / (w * w + x * x + y * y + z * z);
+                        quaternion_matrix(w, x, y, z, s, o + i * 9);
+                    }
+                });
+        });
+    return out;
+}
+
+// dL/dq = s d<G, P>/dq - s^2 <G, P> q
+auto quaternion_backward_cpu(const Tensor &grad, const Tensor &quats)
+    -> Tensor {
+    const auto N = quats.size(0);
+    auto grad_q = torch::empty_like(quats);
+    AT_DISPATCH_FLOATING_TYPES_AND2(
+        at::kBFloat16, at::kHalf, quats.scalar_type(),
+        "quaternion_backward_cpu", [&] {
+            using acc_t = at::opmath_type<scalar_t>;
+            const auto *q = quats.data_ptr<scalar_t>();
+            const auto *g = grad.data_ptr<scalar_t>();
+            auto *gq = grad_q.data_ptr<scalar_t>();
+            at::parallel_for(
+                0, N, kRotationGrainSize, [&](int64_t begin, int64_t end) {
+                    for (int64_t i = begin; i < end; ++i) {
+                        const acc_t w = q[i * 4 + 0], x = q[i * 4 + 1],
+                                    y = q[i * 4 + 2], z = q[i * 4 + 3];
+                        acc_t G[9];
+                        for (int k = 0; k < 9; ++k) {
+                            G[k] = g[i * 9 + k];
+                        }
+                        const acc_t s = 2 / (w * w + x * x + y * y + z * z);
+
+                        // <G, P>
+                        const acc_t gp =
+                            -G[0] * (y * y + z * z) + G[1] * (x * y - w * z) +
+                            G[2] * (x * z + w * y) + G[3] * (x * y + w * z) -
+                            G[4] * (x * x + z * z) + G[5] * (y * z - w * x) +
+                            G[6] * (x * z - w * y) + G[7] * (y * z + w * x) -
+                            G[8] * (x * x + y * y);
+                        // d<G, P>/dq
+                        const acc_t dw = x * (G[7] - G[5]) +
+                                         y * (G[2] - G[6]) + z * (G[3] - G[1]);
+                        const acc_t dx = y * (G[1] + G[3]) + z * (G[2] + G[6]) -
+                                         2 * x * (G[4] + G[8]) +
+                                         w * (G[7] - G[5]);
+                        const acc_t dy = x * (G[1] + G[3]) + z * (G[5] + G[7]) -
+                                         2 * y * (G[0] + G[8]) +
+                                         w * (G[2] - G[6]);
+                        const acc_t dz = x * (G[2] + G[6]) + y * (G[5] + G[7]) -
+                                         2 * z * (G[0] + G[4]) +
+                                         w * (G[3] - G[1]);
+
+                        const acc_t radial = s * s * gp;
+                        gq[i * 4 + 0] = static_cast<scalar_t>(s * dw - radial * w);
+                        gq[i * 4 + 1] = static_cast<scalar_t>(s * dx - radial * x);
+                        gq[i * 4 + 2] = static_cast<scalar_t>(s * dy - radial * y);
+                        gq[i * 4 + 3] = static_cast<scalar_t>(s * dz - radial * z);
+                    }
+                });
+        });
+    return grad_q;
+}
+
+class QuaternionFunction
+    : public torch::autograd::Function<QuaternionFunction> {
+  public:
+    static auto forward(AutogradContext *ctx, Tensor quats) -> Tensor {
+        quats = quats.contiguous();
+        ctx->save_for_backward({quats});
+        return quaternion_forward_cpu(quats);
+    }
+
+    static auto backward(AutogradContext *ctx, tensor_list grad_outputs)
+        -> tensor_list {
+        auto quats = ctx->get_saved_variables()[0];
+        return {quaternion_backward_cpu(grad_outputs[0].contiguous(), quats)};
+    }
+};
+
+auto quaternion_aten(const Tensor &quats) -> Tensor {
+    auto q = quats.unbind(1);
+    auto w = q[0].unsqueeze(1), x = q[1].unsqueeze(1), y = q[2].unsqueeze(1),
+         z = q[3].unsqueeze(1);
+    auto s = 2 / quats.pow(2).sum(1, true);
+    return torch::cat({1 - s * (y * y + z * z), s * (x * y - w * z),
+                       s * (x * z + w * y), s * (x * y + w * z),
+                       1 - s * (x * x + z * z), s * (y * z - w * x),
+                       s * (x * z - w * y), s * (y * z + w * x),
+                       1 - s * (x * x + y * y)},
+                      1)
+        .view({-1, 3, 3});
+}
+} // namespace
+
+auto rodrigues(const Tensor &rot_vecs) -> Tensor {
+    TORCH_CHECK(rot_vecs.dim() == 2 && rot_vecs.size(1) == 3,
+                "rodrigues: expected (N, 3) axis-angle vectors");
+    if (!rot_vecs.is_cpu()) {
+        return rodrigues_aten(rot_vecs);
+    }
+    return RodriguesFunction::apply(rot_vecs);
+}
+
+auto rodrigues_out(const Tensor &rot_vecs, const Tensor &out) -> void {
+    TORCH_CHECK(rot_vecs.dim() == 2 && rot_vecs.size(1) == 3,
+                "rodrigues_out: expected (N, 3) axis-angle vectors");
+    TORCH_CHECK(rot_vecs.is_cpu() && rot_vecs.is_contiguous() &&
+                    out.is_contiguous() &&
+                    out.numel() == rot_vecs.size(0) * 9 &&
+                    out.scalar_type() == rot_vecs.scalar_type(),
+                "rodrigues_out: expected contiguous CPU tensors and an "
+                "(N, 3, 3) output of the same dtype");
+    rodrigues_forward_cpu(rot_vecs, out);
+}
+
+template <typename scalar_t>
+void rodrigues_single(const scalar_t *rot_vec, scalar_t *R) {
+    using acc_t = at::opmath_type<scalar_t>;
+    const acc_t x = rot_vec[0];
+    const acc_t y = rot_vec[1];
+    const acc_t z = rot_vec[2];
+    const auto c = rodrigues_coeffs(x * x + y * y + z * z);
+    rodrigues_matrix(x, y, z, c.a, c.b, R);
+}
+template void rodrigues_single<float>(const float *, float *);
+template void rodrigues_single<double>(const double *, double *);
+
+auto quaternion_to_rotation(const Tensor &quats) -> Tensor {
+    TORCH_CHECK(quats.dim() == 2 && quats.size(1) == 4,
+                "quaternion_to_rotation: expected (N, 4) quaternions");
+    if (!quats.is_cpu()) {
+        return quaternion_aten(quats);
+    }
+    return QuaternionFunction::apply(quats);
+}
+} // namespace smplx::lbs
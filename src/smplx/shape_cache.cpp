@@ -0,0 +1,95 @@
+#include "shape_cache.hpp"
+
+namespace smplx {
+
+namespace {
+
+// FNV-1a over the raw bytes; only computed for CPU tensors, elsewhere the
+// exact comparison is the only check.
+auto hash_values(const Tensor &t) -> uint64_t {
+    if (!t.is_cpu()) {
+        return 0;
+    }
+    auto c = t.contiguous();
+    const auto *bytes = static_cast<const uint8_t *>(c.data_ptr());
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < c.nbytes(); ++i) {
+        h = (h ^ bytes[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+// Inference tensors have no version counter.
+auto version_of(const Tensor &t) -> int64_t {
+    return t.is_inference() ? -1 : static_cast<int64_t>(t._version());
+}
+
+} // namespace
+
+auto ShapeCache::cacheable(const Tensor &betas) -> bool {
+    return !(betas.requires_grad() && torch::GradMode::is_enabled());
+}
+
+auto ShapeCache::matches(const Tensor &betas, uint64_t hash) const -> bool {
+    if (!key_.values.defined() || key_.values.sizes() != betas.sizes() ||
+        key_.values.scalar_type() != betas.scalar_type() ||
+        key_.values.device() != betas.device()) {
+        return false;
+    }
+    const auto version = version_of(betas);
+    if (key_.source.is_same(betas) && version >= 0 &&
+        version == key_.version) {
+        return true;
+    }
+    return hash == key_.hash && torch::equal(key_.values, betas);
+}
+
+auto ShapeCache::lookup(const Tensor &betas, int slot,
+                        const std::function<Shape()> &compute) -> Shape {
+    TORCH_CHECK(slot >= 0 && slot < kNumSlots, "ShapeCache: invalid slot");
+    if (!cacheable(betas)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.bypassed;
+        }
+        return compute();
+    }
+
+    const auto hash = hash_values(betas);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (matches(betas, hash) && slots_[slot].has_value()) {
+            ++stats_.hits;
+            return *slots_[slot];
+        }
+    }
+
+    // Computed outside the lock; concurrent misses simply race to store.
+    auto shape = compute();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.misses;
+    if (!matches(betas, hash)) {
+        key_.source = betas;
+        key_.version = version_of(betas);
+        key_.hash = hash;
+        key_.values = betas.detach().clone();
+        slots_.fill(std::nullopt);
+    }
+    slots_[slot] = shape;
+    return shape;
+}
+
+auto ShapeCache::stats() const -> Stats {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+auto ShapeCache::clear() -> void {
+    std::lock_guard<std::mutex> lock(mutex_);
+    key_ = Key{};
+    slots_.fill(std::nullopt);
+    stats_ = Stats{};
+}
+
+} // namespace smplx
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <iterator>
+#include "ATen/Dispatch.h"
+#include "single_pose.hpp"
+#include "smplx.hpp"
+
+// SMPL::forward_single_pose: batch-1 CPU inference through
+// lbs::single_pose_lbs, specialized on the SMPL kinematic tree.
+namespace smplx {
+namespace {
+constexpr size_t kNumJoints = std::size(SMPL::parents);
+
+template <typename scalar_t>
+auto single_pose_model(const Tensor &v_template, const Tensor &shapedirs,
+                       const Tensor &posedirs, const Tensor &lbs_weights,
+                       const lbs::Precomputed &precomputed,
+                       const lbs::KeypointRegressor &regressor)
+    -> lbs::SinglePoseModel<scalar_t> {
+    lbs::SinglePoseModel<scalar_t> m;
+    m.num_vertices = v_template.size(0);
+    m.num_betas = shapedirs.size(2);
+    m.v_template = v_template.data_ptr<scalar_t>();
+    m.shapedirs = shapedirs.data_ptr<scalar_t>();
+    if (precomputed.low_rank_posedirs.has_value()) {
+        const auto &low_rank = *precomputed.low_rank_posedirs;
+        m.low_rank_left = low_rank.left.data_ptr<scalar_t>();
+        m.low_rank_right = low_rank.right.data_ptr<scalar_t>();
+        m.rank = low_rank.rank();
+    } else {
+        m.posedirs = posedirs.data_ptr<scalar_t>();
+    }
+    if (precomputed.sparse_weights.has_value()) {
+        const auto &sparse = *precomputed.sparse_weights;
+        m.weight_indices = sparse.indices.data_ptr<int64_t>();
+        m.weight_values = sparse.values.data_ptr<scalar_t>();
+        m.weights_k = sparse.indices.size(1);
+    } else {
+        m.lbs_weights = lbs_weights.data_ptr<scalar_t>();
+    }
+    m.J_template = precomputed.J_template.data_ptr<scalar_t>();
+    m.J_shapedirs = precomputed.J_shapedirs.data_ptr<scalar_t>();
+    m.num_keypoints = regressor.num_keypoints();
+    m.keypoint_crow = regressor.crow_indices.data_ptr<int64_t>();
+    m.keypoint_col = regressor.col_indices.data_ptr<int64_t>();
+    m.keypoint_values = regressor.values.data_ptr<scalar_t>();
+    return m;
+}
+} // namespace
+
+auto SMPL::forward_single_pose(const SMPLInput &input) const
+    -> std::optional<SMPLOutput> {
+    const auto &betas = input.betas ? *input.betas : vars_.betas.value();
+    const auto &global_orient =
+        input.global_orient ? *input.global_orient
+                            : vars_.global_orient.value();
+    const auto &body_pose =
+        input.body_pose ? *input.body_pose : vars_.body_pose.value();
+    const auto &transl = input.transl ? *input.transl : vars_.transl.value();
+
+    const int64_t J = kNumJoints;
+    const auto width = input.pose2rot ? 3 : 9;
+    auto fits = [&](const Tensor &t) {
+        return t.is_cpu() && t.is_contiguous() &&
+               t.scalar_type() == compute_dtype_ && t.dim() >= 2 &&
+               t.size(0) == 1 &&
+               !(torch::GradMode::is_enabled() && t.requires_grad());
+    };
+    const bool eligible =
+        vars_.single_pose && device_.is_cpu() &&
+        !vars_.joint_mapper.has_value() &&
+        !precomputed_.block_sparse_posedirs.has_value() &&
+        (compute_dtype_ == torch::kFloat || compute_dtype_ == torch::kDouble) &&
+        shapedirs_.scalar_type() == compute_dtype_ && parents_.numel() == J &&
+        std::equal(std::begin(parents), std::end(parents),
+                   parents_.data_ptr<int64_t>()) &&
+        fits(betas) && fits(global_orient) && fits(body_pose) &&
+        fits(transl) && betas.size(1) == shapedirs_.size(2) &&
+        transl.numel() == 3 &&
+        global_orient.numel() + body_pose.numel() == J * width;
+    if (!eligible) {
+        return std::nullopt;
+    }
+
+    const bool full = input.return_verts;
+    const auto &subset = keypoint_vertices_;
+    const auto &regressor =
+        full ? keypoint_regressor_ : keypoint_subset_regressor_;
+    const auto K = regressor.num_keypoints();
+    auto options = torch::dtype(compute_dtype_);
+    auto joints = torch::empty({1, J + K, 3}, options);
+    auto vertices =
+        torch::empty({1, (full ? v_template_ : subset.v_template).size(0), 3},
+                     options);
+
+    AT_DISPATCH_FLOATING_TYPES(compute_dtype_, "forward_single_pose", [&] {
+        const auto m =
+            full ? single_pose_model<scalar_t>(v_template_, shapedirs_,
+                                               posedirs_, lbs_weights_,
+                                               precomputed_, regressor)
+                 : single_pose_model<scalar_t>(
+                       subset.v_template, subset.shapedirs, subset.posedirs,
+                       subset.lbs_weights, subset.precomputed, regressor);
+        scalar_t pose[kNumJoints * 9];
+        const auto root = global_orient.numel();
+        std::copy_n(global_orient.data_ptr<scalar_t>(), root, pose);
+        std::copy_n(body_pose.data_ptr<scalar_t>(), body_pose.numel(),
+                    pose + root);
+        lbs::single_pose_lbs<kNumJoints, SMPL::parents>(
+            m, betas.data_ptr<scalar_t>(), pose, input.pose2rot,
+            transl.data_ptr<scalar_t>(), vertices.data_ptr<scalar_t>(),
+            joints.data_ptr<scalar_t>());
+    });
+
+    return SMPLOutput{
+        full ? std::make_optional(vertices) : std::nullopt,
+        joints,
+        input.return_full_pose
+            ? std::make_optional(torch::cat({global_orient, body_pose}, 1))
+            : std::nullopt,
+        global_orient,
+        betas,
+        body_pose,
+        transl};
+}
+} // namespace smplx
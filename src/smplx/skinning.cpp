@@ -0,0 +1,434 @@
+#include "skinning.hpp"
+#include <tuple>
+#include "ATen/Dispatch.h"
+#include "ATen/OpMathType.h"
+#include "ATen/Parallel.h"
+#include "ATen/TensorIndexing.h"
+#include "torch/torch.h"
+
+namespace smplx::lbs {
+namespace {
+using torch::autograd::AutogradContext;
+using torch::autograd::tensor_list;
+
+// Vertices handled per task; one vertex is ~J * 12 FMAs.
+constexpr int64_t kSkinningGrainSize = 256;
+
+// The kernels below are written as branch-free loops of fixed width (12
+// for the 3x4 blend, 4 for a row of the apply) so that the compiler turns
+// them into SIMD code for every dispatched dtype; ATen's at::vec::Vectorized
+// only has real SIMD paths in ATen's own per-capability builds.
+
+// Blends the top 3x4 block of the joint transforms of one vertex:
+// T = sum_j w_j * A_j. Zero weights are multiplied through rather than
+// tested, which keeps the 12-wide accumulation vectorized.
+template <typename scalar_t, typename acc_t>
+inline void blend_transform(const scalar_t *w, const scalar_t *A, int64_t J,
+                            acc_t *T) {
+    for (int k = 0; k < 12; ++k) {
+        T[k] = acc_t(0);
+    }
+    for (int64_t j = 0; j < J; ++j) {
+        const acc_t wj = static_cast<acc_t>(w[j]);
+        const scalar_t *a = A + j * 16;
+        for (int k = 0; k < 12; ++k) {
+            T[k] += wj * static_cast<acc_t>(a[k]);
+        }
+    }
+}
+
+// Same blend over a fixed number of (joint index, weight) pairs. Top-k rows
+// of vertices with fewer than K influences are padded with zero weights,
+// whose (gathered) transforms are skipped.
+template <typename scalar_t, typename acc_t>
+inline void blend_transform_sparse(const int64_t *idx, const scalar_t *w,
+                                   const scalar_t *A, int64_t K, acc_t *T) {
+    for (int k = 0; k < 12; ++k) {
+        T[k] = acc_t(0);
+    }
+    for (int64_t n = 0; n < K; ++n) {
+        const acc_t wj = static_cast<acc_t>(w[n]);
+        if (wj == acc_t(0)) {
+            continue;
+        }
+        const scalar_t *a = A + idx[n] * 16;
+        for (int k = 0; k < 12; ++k) {
+            T[k] += wj * static_cast<acc_t>(a[k]);
+        }
+    }
+}
+
+// r = T [x, y, z, 1]^T for a blended 3x4 transform.
+template <typename acc_t>
+inline void apply_transform(const acc_t *T, const acc_t *vh, acc_t *r) {
+    for (int i = 0; i < 3; ++i) {
+        acc_t sum = acc_t(0);
+        for (int k = 0; k < 4; ++k) {
+            sum += T[i * 4 + k] * vh[k];
+        }
+        r[i] = sum;
+    }
+}
+
+// Weights are either dense (V, J), with `indices` undefined, or the values
+// (V, K) of a SparseWeights whose joint `indices` are (V, K).
+// transl is (B, 3) or (1, 3), broadcast over the batch.
+auto skinning_forward_cpu(const Tensor &v_posed, const Tensor &weights,
+                          const Tensor &indices, const Tensor &A,
+                          const Tensor &transl, const Tensor &out) -> void {
+    const auto B = v_posed.size(0);
+    const auto V = v_posed.size(1);
+    const auto J = A.size(1);
+    const auto K = weights.size(1);
+    const int64_t transl_stride = transl.size(0) == 1 ? 0 : 3;
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(
+        at::kBFloat16, at::kHalf, v_posed.scalar_type(),
+        "skinning_forward_cpu", [&] {
+            using acc_t = at::opmath_type<scalar_t>;
+            const auto *v = v_posed.data_ptr<scalar_t>();
+            const auto *w = weights.data_ptr<scalar_t>();
+            const auto *ix =
+                indices.defined() ? indices.data_ptr<int64_t>() : nullptr;
+            const auto *a = A.data_ptr<scalar_t>();
+            const auto *t = transl.data_ptr<scalar_t>();
+            auto *o = out.data_ptr<scalar_t>();
+
+            at::parallel_for(
+                0, B * V, kSkinningGrainSize, [&](int64_t begin, int64_t end) {
+                    acc_t T[12];
+                    for (int64_t idx = begin; idx < end; ++idx) {
+                        const int64_t b = idx / V;
+                        const int64_t vi = idx % V;
+                        if (ix == nullptr) {
+                            blend_transform(w + vi * K, a + b * J * 16, J, T);
+                        } else {
+                            blend_transform_sparse(ix + vi * K, w + vi * K,
+                                                   a + b * J * 16, K, T);
+                        }
+
+                        const acc_t vh[4] = {v[idx * 3 + 0], v[idx * 3 + 1],
+                                             v[idx * 3 + 2], acc_t(1)};
+                        acc_t r[3];
+                        apply_transform(T, vh, r);
+                        for (int i = 0; i < 3; ++i) {
+                            o[idx * 3 + i] = static_cast<scalar_t>(
+                                r[i] +
+                                static_cast<acc_t>(t[b * transl_stride + i]));
+                        }
+                    }
+                });
+        });
+}
+
+// Returns the gradient w.r.t. v_posed (T^T g, if requested) and the
+// per-vertex outer products M[b, v] = g[b, v] (x) [v_posed[b, v], 1] (B, V, 12)
+// from which the weight and transform gradients are reduced.
+auto skinning_backward_cpu(const Tensor &grad, const Tensor &v_posed,
+                           const Tensor &weights, const Tensor &indices,
+                           const Tensor &A, bool need_v, bool need_outer)
+    -> std::tuple<Tensor, Tensor> {
+    const auto B = v_posed.size(0);
+    const auto V = v_posed.size(1);
+    const auto J = A.size(1);
+    const auto K = weights.size(1);
+    Tensor grad_v, outer;
+    if (need_v) {
+        grad_v = torch::empty_like(v_posed);
+    }
+    if (need_outer) {
+        outer = torch::empty({B, V, 12}, v_posed.options());
+    }
+
+    AT_DISPATCH_FLOATING_TYPES_AND2(
+        at::kBFloat16, at::kHalf, v_posed.scalar_type(),
+        "skinning_backward_cpu", [&] {
+            using acc_t = at::opmath_type<scalar_t>;
+            const auto *g = grad.data_ptr<scalar_t>();
+            const auto *v = v_posed.data_ptr<scalar_t>();
+            const auto *w = weights.data_ptr<scalar_t>();
+            const auto *ix =
+                indices.defined() ? indices.data_ptr<int64_t>() : nullptr;
+            const auto *a = A.data_ptr<scalar_t>();
+            auto *gv = need_v ? grad_v.data_ptr<scalar_t>() : nullptr;
+            auto *m = need_outer ? outer.data_ptr<scalar_t>() : nullptr;
+
+            at::parallel_for(
+                0, B * V, kSkinningGrainSize, [&](int64_t begin, int64_t end) {
+                    acc_t T[12];
+                    for (int64_t idx = begin; idx < end; ++idx) {
+                        const acc_t g3[3] = {g[idx * 3 + 0], g[idx * 3 + 1],
+                                             g[idx * 3 + 2]};
+                        if (gv != nullptr) {
+                            const int64_t b = idx / V;
+                            const int64_t vi = idx % V;
+                            if (ix == nullptr) {
+                                blend_transform(w + vi * K, a + b * J * 16, J,
+                                                T);
+                            } else {
+                                blend_transform_sparse(ix + vi * K, w + vi * K,
+                                                       a + b * J * 16, K, T);
+                            }
+                            for (int k = 0; k < 3; ++k) {
+                                gv[idx * 3 + k] = static_cast<scalar_t>(
+                                    T[0 * 4 + k] * g3[0] +
+                                    T[1 * 4 + k] * g3[1] +
+                                    T[2 * 4 + k] * g3[2]);
+                            }
+                        }
+                        if (m != nullptr) {
+                            const acc_t vh[4] = {v[idx * 3 + 0],
+                                                 v[idx * 3 + 1],
+                                                 v[idx * 3 + 2], acc_t(1)};
+                            for (int i = 0; i < 3; ++i) {
+                                for (int k = 0; k < 4; ++k) {
+                                    m[idx * 12 + i * 4 + k] =
+                                        static_cast<scalar_t>(g3[i] * vh[k]);
+                                }
+                            }
+                        }
+                    }
+                });
+        });
+    return std::make_tuple(grad_v, outer);
+}
+
+// Pads a (B, J, 3, 4) gradient back to the (B, J, 4, 4) transforms.
+inline auto pad_transform_grad(const Tensor &grad) -> Tensor {
+    return torch::constant_pad_nd(grad, {0, 0, 0, 1});
+}
+
+class SkinningFunction : public torch::autograd::Function<SkinningFunction> {
+  public:
+    static auto forward(AutogradContext *ctx, Tensor v_posed,
+                        Tensor lbs_weights, Tensor A, Tensor transl)
+        -> Tensor {
+        v_posed = v_posed.contiguous();
+        lbs_weights = lbs_weights.contiguous();
+        A = A.contiguous();
+        ctx->save_for_backward({v_posed, lbs_weights, A});
+        auto out = torch::empty_like(v_posed);
+        skinning_forward_cpu(v_posed, lbs_weights, Tensor(), A,
+                             transl.contiguous(), out);
+        return out;
+    }
+
+    // First-order only: the kernels below are not themselves differentiable.
+    static auto backward(AutogradContext *ctx, tensor_list grad_outputs)
+        -> tensor_list {
+        auto saved = ctx->get_saved_variables();
+        const auto &v_posed = saved[0];
+        const auto &lbs_weights = saved[1];
+        const auto &A = saved[2];
+        auto grad = grad_outputs[0].contiguous();
+
+        const auto B = v_posed.size(0);
+        const auto J = lbs_weights.size(1);
+        const bool need_w = ctx->needs_input_grad(1);
+        const bool need_a = ctx->needs_input_grad(2);
+
+        auto [grad_v, outer] = skinning_backward_cpu(
+            grad, v_posed, lbs_weights, Tensor(), A, ctx->needs_input_grad(0),
+            need_w || need_a);
+
+        Tensor grad_w, grad_a, grad_t;
+        if (need_w) {
+            auto A12 = A.narrow(2, 0, 3).reshape({B, J, 12});
+            grad_w = torch::einsum("bvk,bjk->vj", {outer, A12});
+        }
+        if (need_a) {
+            grad_a = pad_transform_grad(
+                torch::matmul(lbs_weights.t(), outer).view({B, J, 3, 4}));
+        }
+        if (ctx->needs_input_grad(3)) {
+            grad_t = grad.sum(1);
+        }
+        return {grad_v, grad_w, grad_a, grad_t};
+    }
+};
+
+class SparseSkinningFunction
+    : public torch::autograd::Function<SparseSkinningFunction> {
+  public:
+    static auto forward(AutogradContext *ctx, Tensor v_posed, Tensor values,
+                        Tensor A, Tensor transl, Tensor indices) -> Tensor {
+        v_posed = v_posed.contiguous();
+        values = values.contiguous();
+        indices = indices.contiguous();
+        A = A.contiguous();
+        ctx->save_for_backward({v_posed, values, indices, A});
+        auto out = torch::empty_like(v_posed);
+        skinning_forward_cpu(v_posed, values, indices, A, transl.contiguous(),
+                             out);
+        return out;
+    }
+
+    static auto backward(AutogradContext *ctx, tensor_list grad_outputs)
+        -> tensor_list {
+        auto saved = ctx->get_saved_variables();
+        const auto &v_posed = saved[0];
+        const auto &values = saved[1];
+        const auto &indices = saved[2];
+        const auto &A = saved[3];
+        auto grad = grad_outputs[0].contiguous();
+
+        const auto B = v_posed.size(0);
+        const auto V = v_posed.size(1);
+        const auto J = A.size(1);
+        const auto K = values.size(1);
+        const bool need_w = ctx->needs_input_grad(1);
+        const bool need_a = ctx->needs_input_grad(2);
+
+        auto [grad_v, outer] = skinning_backward_cpu(
+            grad, v_posed, values, indices, A, ctx->needs_input_grad(0),
+            need_w || need_a);
+
+        Tensor grad_w, grad_a, grad_t;
+        if (need_w) {
+            // (B, V, K, 12) transforms of the selected joints
+            auto A12 = A.narrow(2, 0, 3).reshape({B, J, 12});
+            auto picked = A12.index_select(1, indices.view({-1}))
+                              .view({B, V, K, 12});
+            grad_w = torch::einsum("bvc,bvkc->vk", {outer, picked});
+        }
+        if (need_a) {
+            // Scatter M[b, v] * w[v, k] into the joint indices[v, k].
+            auto contrib = (outer.unsqueeze(2) * values.unsqueeze(-1))
+                               .view({B, V * K, 12});
+            grad_a = pad_transform_grad(
+                torch::zeros({B, J, 12}, outer.options())
+                    .index_add_(1, indices.view({-1}), contrib)
+                    .view({B, J, 3, 4}));
+        }
+        if (ctx->needs_input_grad(3)) {
+            grad_t = grad.sum(1);
+        }
+        return {grad_v, grad_w, grad_a, grad_t, Tensor()};
+    }
+};
+
+inline auto expand_transl(const Tensor &v_posed,
+                          const std::optional<Tensor> &transl) -> Tensor {
+    const auto B = v_posed.size(0);
+    return transl.has_value() ? transl->expand({B, 3})
+                              : torch::zeros({B, 3}, v_posed.options());
+}
+} // namespace
+
+auto SparseWeights::to_dense(int64_t num_joints) const -> Tensor {
+    return torch::zeros({values.size(0), num_joints}, values.options())
+        .scatter_(1, indices, values);
+}
+
+auto compress_weights(const Tensor &lbs_weights, int64_t k, bool renormalize)
+    -> SparseWeights {
+    TORCH_CHECK(k > 0 && k <= lbs_weights.size(1),
+                "compress_weights: k must be in [1, num_joints]");
+    auto [values, indices] = torch::topk(lbs_weights, k, 1);
+
+    SparseWeights out;
+    out.max_dropped_weight =
+        (lbs_weights.sum(1) - values.sum(1)).abs().max().item<double>();
+    if (renormalize) {
+        values = values * (lbs_weights.sum(1, true) / values.sum(1, true));
+    }
+    out.indices = indices.contiguous();
+    out.values = values.contiguous();
+    out.max_weight_error =
+        (out.to_dense(lbs_weights.size(1)) - lbs_weights)
+            .abs()
+            .max()
+            .item<double>();
+    return out;
+}
+
+auto skinning(const Tensor &v_posed, const Tensor &lbs_weights,
+              const Tensor &A, const std::optional<Tensor> &transl)
+    -> Tensor {
+    if (!v_posed.is_cpu()) {
+        return skinning_reference(v_posed, lbs_weights, A, transl);
+    }
+    TORCH_CHECK(lbs_weights.scalar_type() == v_posed.scalar_type() &&
+                    A.scalar_type() == v_posed.scalar_type(),
+                "skinning: v_posed, lbs_weights and A must share a dtype");
+    return SkinningFunction::apply(v_posed, lbs_weights, A,
+                                   expand_transl(v_posed, transl));
+}
+
+auto skinning(const Tensor &v_posed, const SparseWeights &weights,
+              const Tensor &A, const std::optional<Tensor> &transl)
+    -> Tensor {
+    if (!v_posed.is_cpu()) {
+        return skinning_reference(v_posed, weights.to_dense(A.size(1)), A,
+                                  transl);
+    }
+    TORCH_CHECK(weights.values.scalar_type() == v_posed.scalar_type() &&
+                    A.scalar_type() == v_posed.scalar_type(),
+                "skinning: v_posed, weights and A must share a dtype");
+    return SparseSkinningFunction::apply(v_posed, weights.values, A,
+                                         expand_transl(v_posed, transl),
+                                         weights.indices);
+}
+
+namespace {
+auto check_skinning_out(const Tensor &v_posed, const Tensor &weights,
+                        const Tensor &A, const Tensor &transl,
+                        const Tensor &out) -> void {
+    const auto dtype = v_posed.scalar_type();
+    TORCH_CHECK(v_posed.is_cpu() && v_posed.is_contiguous() &&
+                    weights.is_contiguous() && A.is_contiguous() &&
+                    transl.is_contiguous() && out.is_contiguous(),
+                "skinning_out: expected contiguous CPU tensors");
+    TORCH_CHECK(weights.scalar_type() == dtype && A.scalar_type() == dtype &&
+                    transl.scalar_type() == dtype &&
+                    out.scalar_type() == dtype,
+                "skinning_out: all tensors must share a dtype");
+    TORCH_CHECK(out.sizes() == v_posed.sizes() &&
+                    (transl.size(0) == 1 || transl.size(0) == v_posed.size(0)),
+                "skinning_out: expected a (B, V, 3) out and a (B, 3) or "
+                "(1, 3) transl");
+}
+} // namespace
+
+auto skinning_out(const Tensor &v_posed, const Tensor &lbs_weights,
+                  const Tensor &A, const Tensor &transl, const Tensor &out)
+    -> void {
+    check_skinning_out(v_posed, lbs_weights, A, transl, out);
+    skinning_forward_cpu(v_posed, lbs_weights, Tensor(), A, transl, out);
+}
+
+auto skinning_out(const Tensor &v_posed, const SparseWeights &weights,
+                  const Tensor &A, const Tensor &transl, const Tensor &out)
+    -> void {
+    check_skinning_out(v_posed, weights.values, A, transl, out);
+    skinning_forward_cpu(v_posed, weights.values, weights.indices, A, transl,
+                         out);
+}
+
+auto skinning_reference(const Tensor &v_posed, const Tensor &lbs_weights,
+                        const Tensor &A, const std::optional<Tensor> &transl)
+    -> Tensor {
+    const auto batch_size = v_posed.size(0);
+    const auto num_joints = lbs_weights.size(1);
+
+    auto W = lbs_weights.unsqueeze(0).expand({batch_size, -1, -1});
+
+    auto T = torch::matmul(W, A.reshape({batch_size, num_joints, 16}))
+                 .view({batch_size, -1, 4, 4});
+
+    auto homogen_coord = torch::ones({batch_size, v_posed.size(1), 1},
+                                     v_posed.options());
+
+    auto v_posed_homo = torch::cat({v_posed, homogen_coord}, 2);
+
+    auto v_homo = torch::matmul(T, torch::unsqueeze(v_posed_homo, -1));
+
+    auto vertices =
+        v_homo.index({Slice(None), Slice(None), Slice(None, 3), 0});
+    if (transl.has_value()) {
+        vertices = vertices + transl->unsqueeze(1);
+    }
+    return vertices;
+}
+
+} // namespace smplx::lbs
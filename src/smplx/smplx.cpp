@@ -1,78 +1,212 @@
 #include "smplx.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
 #include <memory>
+#include <sstream>
 
 #define DEBUG false
 namespace smplx {
 
 constexpr int SMPL::SHAPE_SPACE_DIM;
 
-auto SMPL::construct(const char *model_path) -> void {
-    vertex_joint_selector_ =
-        std::make_unique<VertexJointSelector>(vars_.vertex_ids, device_);
+const std::vector<std::string> SMPL::kRequiredNpzArrays = {
+    "shapedirs", "f", "v_template", "J_regressor", "posedirs", "weights"};
+
+namespace {
+
+// Factorizes posedirs, or reads the factors cached in
+// "<model>.posedirs-<rank|tolerance>.tsmx" (skipped when model_path is
+// empty). The cache also stores a checksum of posedirs, so that a different
+// model at the same path is detected.
+auto low_rank_posedirs(const Tensor &posedirs, const internal::option &opt,
+                       const std::string &model_path)
+    -> lbs::LowRankPosedirs {
+    std::ostringstream key;
+    if (opt.posedirs_rank.has_value()) {
+        key << "r" << opt.posedirs_rank.value();
+    } else {
+        // Enough digits to round-trip, so that close tolerances do not
+        // share a cache file.
+        key << "tol" << std::setprecision(17)
+            << opt.posedirs_tolerance.value();
+    }
+    const auto cache_path = model_path.empty()
+                                ? std::string()
+                                : model_path + ".posedirs-" + key.str() + "." +
+                                      kModelFileExtension;
+    auto host = posedirs.to(torch::kCPU, torch::kFloat64);
+    auto checksum = torch::stack({host.sum(), host.abs().sum()});
+
+    if (!cache_path.empty() && std::filesystem::exists(cache_path)) {
+        try {
+            MappedModelFile file(cache_path);
+            if (torch::allclose(file.tensor("checksum"), checksum, 1e-12, 0)) {
+                lbs::LowRankPosedirs out;
+                out.left = file.tensor("left");
+                out.right = file.tensor("right");
+                auto errors = file.tensor("errors");
+                out.max_vertex_error = errors[0].item<double>();
+                out.mean_vertex_error = errors[1].item<double>();
+                return out;
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "[WARNING] Ignoring posedirs cache " << cache_path
+                      << ": " << e.what() << std::endl;
+        }
+    }
+
+    auto out = lbs::factorize_posedirs(
+        host,
+        opt.posedirs_rank ? std::make_optional<int64_t>(*opt.posedirs_rank)
+                          : std::nullopt,
+        opt.posedirs_tolerance);
+    if (!cache_path.empty()) {
+        try {
+            save_model_file(
+                cache_path,
+                {{"left", out.left},
+                 {"right", out.right},
+                 {"errors", torch::tensor({out.max_vertex_error,
+                                           out.mean_vertex_error},
+                                          torch::kFloat64)},
+                 {"checksum", checksum}});
+        } catch (const std::exception &e) {
+            std::cerr << "[WARNING] Unable to cache posedirs factors: "
+                      << e.what() << std::endl;
+        }
+    }
+    return out;
+}
+
+} // namespace
 
+auto SMPL::construct(const char *model_path) -> void {
     ASSERT_MSG(std::filesystem::exists(model_path), "%s not exist", model_path);
-    ASSERT_MSG(check_file_ext(model_path, "npz"), "invalid extension %s",
-               std::filesystem::path(model_path).extension().string().c_str());
 
-    cnpy::npz_t data;
+    // float32 and float64 models load in their dtype; the others (whose
+    // blend shapes are cast down in build) and models without a model_dtype
+    // keep the stored one. A file already in that dtype then stays mapped
+    // rather than copied.
+    std::optional<torch::Dtype> dtype;
+    if (vars_.model_dtype == torch::kFloat32 ||
+        vars_.model_dtype == torch::kFloat64) {
+        dtype = vars_.model_dtype;
+    }
+    std::shared_ptr<const ModelData> data;
     try {
-        data = cnpy::npz_load(model_path);
+        data = std::make_shared<const ModelData>(
+            load_model_data(model_path, device_, dtype));
     } catch (const std::exception &e) {
-        throw std::runtime_error(std::string("Failed to load npz file: ") +
-                                 e.what());
+        std::cerr << "[ERROR] Model construction failed: " << e.what()
+                  << std::endl;
+        throw; // rethrow for upstream handling
     }
 
     std::cout << "SMPL model loaded: " << model_path << std::endl;
+    construct(std::move(data));
+}
 
-    auto load_required_tensor = [&](const std::string &name,
-                                    torch::Dtype dtype) -> torch::Tensor {
-        if (!data.count(name)) {
-            throw std::runtime_error("Missing tensor in npz: '" + name + "'");
-        }
-        try {
-            return cnpyToTensor(data.at(name), dtype).to(device_);
-        } catch (const std::exception &e) {
-            throw std::runtime_error("Failed to load tensor '" + name +
-                                     "': " + e.what());
+auto SMPL::construct(std::shared_ptr<const ModelData> data) -> void {
+    const auto &execution = vars_.execution;
+    if (execution.numa_local && !execution.cpu_affinity.empty() &&
+        device_.is_cpu()) {
+        run_on_cpus(execution.cpu_affinity,
+                    [&] { build(std::move(data), true); });
+    } else {
+        build(std::move(data), false);
+    }
+}
+
+auto SMPL::build(std::shared_ptr<const ModelData> data, bool private_buffers)
+    -> void {
+    vertex_joint_selector_ =
+        std::make_unique<VertexJointSelector>(vars_.vertex_ids, device_);
+
+    // detach() gives every handle its own TensorImpl over the shared storage,
+    // so Module::to() or set_data() on one handle never retargets the others.
+    data_ = std::move(data);
+    shapedirs_ = data_->shapedirs.detach();
+    faces_ = data_->faces.detach();
+    v_template_ = data_->v_template.detach();
+    J_regressor_ = data_->J_regressor.detach();
+    TORCH_CHECK(data_->posedirs.defined(),
+                "SMPL: the model data has no posedirs (dropped by a model "
+                "with low-rank posedirs that owned it)");
+    posedirs_ = data_->posedirs.detach();
+    lbs_weights_ = data_->lbs_weights.detach();
+    parents_ = data_->parents.detach();
+    if (private_buffers) {
+        for (auto *t : {&shapedirs_, &v_template_, &J_regressor_, &posedirs_,
+                        &lbs_weights_}) {
+            *t = t->clone();
         }
-    };
+    }
+
+    // Everything derived below is then an inference tensor. The shared model
+    // buffers stay normal tensors, which inference mode reads freely.
+    std::optional<c10::InferenceMode> inference_guard;
+    if (vars_.inference) {
+        inference_guard.emplace();
+    }
 
     try {
-        shapedirs_ = load_required_tensor("shapedirs", torch::kFloat64);
         auto num_betas = shapedirs_.size(2);
 
-        faces_ = load_required_tensor("f", torch::kUInt32);
-
         if (vars_.age == "kid" && vars_.kid_template_path.has_value()) {
             ASSERT_MSG(std::filesystem::exists(vars_.kid_template_path.value()),
                        "Kid template path does not exist");
 
-            cnpy::npz_t kid_data =
-                cnpy::npz_load(vars_.kid_template_path.value());
+            cnpy::npz_t kid_data = cnpy::npz_load_selected(
+                vars_.kid_template_path.value(), {"v_template"});
 
-            torch::Tensor v_template_adult =
-                load_required_tensor("v_template", torch::kFloat64);
             torch::Tensor v_template_kid =
-                cnpyToTensor(kid_data.at("v_template"), torch::kFloat64)
+                cnpyToTensor(kid_data.at("v_template"), shapedirs_.scalar_type())
                     .to(device_);
 
             v_template_kid -= torch::mean(v_template_kid, 0);
             auto v_template_diff =
-                torch::unsqueeze(v_template_kid - v_template_adult, 2);
+                torch::unsqueeze(v_template_kid - v_template_, 2);
             shapedirs_ = torch::cat({shapedirs_, v_template_diff}, 2);
             ++num_betas;
         }
 
         vars_.num_betas = num_betas;
-        register_buffer("shapedirs", shapedirs_);
-        register_buffer("faces_tensor", faces_);
+
+        // Storage and compute dtypes, see smplx::model_dtype(). Another
+        // dtype than that of shared data gives this handle its own copies
+        // of the blend shapes.
+        const auto storage_dtype = vars_.model_dtype.value_or(data_->dtype);
+        if (storage_dtype != data_->dtype && data_.use_count() > 1) {
+            TORCH_WARN("SMPL: model_dtype ", storage_dtype,
+                       " differs from the shared model data (",
+                       data_->dtype, "); this instance copies the model "
+                       "buffers instead of sharing them. Load the data in "
+                       "that dtype (ModelKey::dtype) to share it.");
+        }
+        switch (storage_dtype) {
+        case torch::kFloat64:
+        case torch::kFloat32:
+            compute_dtype_ = storage_dtype;
+            break;
+        case torch::kBFloat16:
+        case torch::kHalf:
+            compute_dtype_ = torch::kFloat32;
+            break;
+        default:
+            throw std::runtime_error(
+                std::string("Unsupported model dtype ") +
+                c10::toString(storage_dtype) +
+                ", expected float64, float32, bfloat16 or float16");
+        }
+        vars_.dtype = compute_dtype_;
 
         // Initialize parameters if missing
         if (!vars_.betas.has_value()) {
             vars_.betas.emplace(
                 torch::zeros({vars_.batch_size, vars_.num_betas},
                              torch::dtype(vars_.dtype).device(device_))
-                    .requires_grad_(true));
+                    .requires_grad_(!vars_.inference));
         }
         if (!vars_.global_orient.has_value()) {
             vars_.global_orient.emplace(
@@ -90,39 +224,137 @@ auto SMPL::construct(const char *model_path) -> void {
                              torch::dtype(vars_.dtype).device(device_)));
         }
 
-        v_template_ = load_required_tensor("v_template", torch::kFloat64);
         if (vars_.v_template.has_value()) {
-            v_template_ = vars_.v_template.value().clone().to(device_);
+            v_template_ = vars_.v_template.value().clone().to(
+                device_, v_template_.scalar_type());
         }
 
-        J_regressor_ = load_required_tensor("J_regressor", torch::kFloat64);
-
-        posedirs_ = load_required_tensor("posedirs", torch::kFloat64);
-        posedirs_ = posedirs_.reshape({-1, posedirs_.size(2)})
-                        .transpose(0, 1)
-                        .contiguous();
+        // Folded in the loaded precision, before any down-cast.
+        std::tie(precomputed_.J_template, precomputed_.J_shapedirs) =
+            lbs::regress_shape_joints(J_regressor_, v_template_, shapedirs_);
+        precomputed_.J_template = precomputed_.J_template.to(compute_dtype_);
+        precomputed_.J_shapedirs = precomputed_.J_shapedirs.to(compute_dtype_);
+
+        if (vars_.posedirs_rank.has_value() ||
+            vars_.posedirs_tolerance.has_value()) {
+            auto low_rank = low_rank_posedirs(
+                posedirs_, vars_, vars_.cache_posedirs_factors ? data_->path
+                                                               : "");
+            low_rank.left = low_rank.left.to(device_, storage_dtype);
+            low_rank.right = low_rank.right.to(device_, storage_dtype);
+            register_buffer("posedirs_left", low_rank.left);
+            register_buffer("posedirs_right", low_rank.right);
+            std::cout << "posedirs factorized to rank " << low_rank.rank()
+                      << ", vertex error on the pose benchmark: max "
+                      << low_rank.max_vertex_error * 1e3 << " mm, mean "
+                      << low_rank.mean_vertex_error * 1e3 << " mm"
+                      << std::endl;
+            precomputed_.low_rank_posedirs = std::move(low_rank);
+
+            // The factors replace the dense buffer everywhere. A ModelData
+            // that only this model holds gives it up too, so its memory is
+            // actually freed; shared ones keep it for the other handles.
+            posedirs_ = Tensor();
+            if (data_.use_count() == 1) {
+                auto trimmed = std::make_shared<ModelData>(*data_);
+                trimmed->posedirs = Tensor();
+                data_ = std::move(trimmed);
+            }
+        }
 
-        lbs_weights_ = load_required_tensor("weights", torch::kFloat64);
+        if (vars_.posedirs_block_threshold.has_value()) {
+            if (precomputed_.low_rank_posedirs.has_value()) {
+                throw std::runtime_error(
+                    "posedirs can be either low-rank or block-sparse");
+            }
+            auto block_sparse = lbs::block_sparse_posedirs(
+                posedirs_, vars_.posedirs_block_threshold.value(),
+                vars_.posedirs_block_size);
+            block_sparse.values = block_sparse.values.to(storage_dtype);
+            register_buffer("posedirs_blocks", block_sparse.values);
+            std::cout << "posedirs block-sparse: " << block_sparse.nnz()
+                      << " (joint, " << block_sparse.block_size
+                      << " vertices) blocks, "
+                      << block_sparse.density() * 100
+                      << "% dense, vertex error on the pose benchmark: max "
+                      << block_sparse.max_vertex_error * 1e3 << " mm, mean "
+                      << block_sparse.mean_vertex_error * 1e3 << " mm"
+                      << std::endl;
+            precomputed_.block_sparse_posedirs = std::move(block_sparse);
+        }
 
-        parents_ = torch::from_blob((void *)parents,
-                                    {sizeof(parents) / sizeof(parents[0])},
-                                    torch::kLong)
-                       .clone()
-                       .to(device_);
+        // Only the two large blend shape bases use the storage dtype. On
+        // matching dtypes these are no-ops and the buffers stay shared.
+        shapedirs_ = shapedirs_.to(storage_dtype);
+        if (posedirs_.defined()) {
+            posedirs_ = posedirs_.to(storage_dtype);
+        }
+        v_template_ = v_template_.to(compute_dtype_);
+        J_regressor_ = J_regressor_.to(compute_dtype_);
+        lbs_weights_ = lbs_weights_.to(compute_dtype_);
 
         // Register all buffers and parameters
+        register_buffer("shapedirs", shapedirs_);
+        register_buffer("faces_tensor", faces_);
         register_buffer("parents", parents_);
         register_buffer("lbs_weights", lbs_weights_);
         register_buffer("v_template", v_template_);
         register_buffer("J_regressor", J_regressor_);
-        register_buffer("posedirs", posedirs_);
+        if (posedirs_.defined()) {
+            register_buffer("posedirs", posedirs_);
+        }
+
+        register_buffer("J_template", precomputed_.J_template);
+        register_buffer("J_shapedirs", precomputed_.J_shapedirs);
+        precomputed_.kinematic_tree = lbs::build_kinematic_tree(parents_);
+
+        if (vars_.lbs_topk.has_value()) {
+            auto &sparse = precomputed_.sparse_weights;
+            sparse = lbs::compress_weights(lbs_weights_, vars_.lbs_topk.value(),
+                                           vars_.lbs_topk_renormalize);
+            register_buffer("lbs_weights_topk_indices", sparse->indices);
+            register_buffer("lbs_weights_topk_values", sparse->values);
+            std::cout << "Skinning weights compressed to top-"
+                      << vars_.lbs_topk.value() << ", max dropped weight "
+                      << sparse->max_dropped_weight << ", max weight error "
+                      << sparse->max_weight_error << std::endl;
+        }
 
-        register_parameter("betas", vars_.betas.value().requires_grad_(true));
-        register_parameter("global_orient",
-                           vars_.global_orient.value().requires_grad_(true));
-        register_parameter("body_pose",
-                           vars_.body_pose.value().requires_grad_(true));
-        register_parameter("transl", vars_.transl.value().requires_grad_(true));
+        const auto num_vertices = v_template_.size(0);
+        keypoint_regressor_ = lbs::vertex_regressor(
+            vertex_joint_selector_->extra_joints_idxs(), num_vertices,
+            compute_dtype_);
+        for (const auto &extra : vars_.extra_keypoints) {
+            if (extra.dim() != 2 || extra.size(1) != num_vertices) {
+                throw std::runtime_error(
+                    "extra_keypoints: expected a (K, " +
+                    std::to_string(num_vertices) + ") regressor");
+            }
+            keypoint_regressor_ = lbs::stack_regressors(
+                keypoint_regressor_,
+                lbs::sparse_regressor(extra.to(device_, compute_dtype_)));
+        }
+        Tensor keypoint_support;
+        std::tie(keypoint_support, keypoint_subset_regressor_) =
+            lbs::compact_regressor(keypoint_regressor_);
+        keypoint_vertices_ = lbs::select_vertices(
+            keypoint_support, v_template_, shapedirs_, posedirs_,
+            lbs_weights_, precomputed_);
+
+        if (vars_.arena && device_.is_cpu()) {
+            arena_ = std::make_shared<ArenaAllocator>(vars_.arena_max_bytes);
+        }
+
+        if (!vars_.inference) {
+            register_parameter("betas",
+                               vars_.betas.value().requires_grad_(true));
+            register_parameter("global_orient",
+                               vars_.global_orient.value().requires_grad_(true));
+            register_parameter("body_pose",
+                               vars_.body_pose.value().requires_grad_(true));
+            register_parameter("transl",
+                               vars_.transl.value().requires_grad_(true));
+        }
 
         // print first cell of each tensor
         if (DEBUG) {
@@ -142,41 +374,346 @@ auto SMPL::construct(const char *model_path) -> void {
     std::cout << "SMPL model construction completed." << std::endl;
 }
 
-auto SMPL::forward_impl() -> SMPLOutput {
-    auto full_pose =
-        torch::cat({vars_.global_orient.value(), vars_.body_pose.value()}, 1);
+auto SMPL::make_input(const internal::option &opt) -> SMPLInput {
+    SMPLInput input;
+    input.betas = opt.betas;
+    input.global_orient = opt.global_orient;
+    input.body_pose = opt.body_pose;
+    input.transl = opt.transl;
+    input.pose2rot = opt.pose2rot;
+    input.return_verts = opt.return_verts;
+    input.return_full_pose = opt.return_full_pose;
+    return input;
+}
 
-    auto batch_size =
-        mmax(vars_.betas.value().size(0), vars_.global_orient.value().size(0),
-             vars_.body_pose.value().size(0));
+auto SMPL::to_compute_dtype(const Tensor &t) const -> Tensor {
+    if (t.scalar_type() == compute_dtype_) {
+        return t;
+    }
+    TORCH_WARN_ONCE("SMPL inputs are converted to the model compute dtype (",
+                    compute_dtype_, "); got ", t.scalar_type(),
+                    ". Pass matching inputs or pick the model dtype with "
+                    "smplx::model_dtype().");
+    return t.to(compute_dtype_);
+}
+
+auto SMPL::resolve(const SMPLInput &input) const -> Resolved {
+    // Missing parameters fall back to the values given at construction.
+    // Nothing is written back, so concurrent calls never observe each other.
+    Resolved in;
+    in.betas =
+        to_compute_dtype(input.betas ? *input.betas : vars_.betas.value());
+    in.global_orient = to_compute_dtype(input.global_orient
+                                            ? *input.global_orient
+                                            : vars_.global_orient.value());
+    in.body_pose = to_compute_dtype(input.body_pose ? *input.body_pose
+                                                    : vars_.body_pose.value());
+    in.transl =
+        to_compute_dtype(input.transl ? *input.transl : vars_.transl.value());
+    in.full_pose = torch::cat({in.global_orient, in.body_pose}, 1);
+    in.pose2rot = input.pose2rot;
 
     // Ensure all tensors are of the same batch size
-    if (vars_.betas.value().size(0) != batch_size) {
-        vars_.betas = vars_.betas.value().expand(
-            {int(batch_size / vars_.betas.value().size(0)), -1});
+    auto batch_size = mmax(in.betas.size(0), in.global_orient.size(0),
+                           in.body_pose.size(0));
+    in.batch_betas = in.betas;
+    if (in.betas.size(0) != batch_size) {
+        in.batch_betas = in.betas.expand({batch_size, -1});
+    }
+    return in;
+}
+
+auto SMPL::run_lbs(const Resolved &in, const std::optional<Tensor> &transl,
+                   int slot, const Tensor &v_template, const Tensor &shapedirs,
+                   const Tensor &posedirs, const Tensor &lbs_weights,
+                   const lbs::Precomputed &precomputed) const
+    -> std::tuple<Tensor, Tensor> {
+    // While optimizing, the whole pipeline is a single autograd node that
+    // keeps far less state than the op-by-op graph.
+    const bool fused_autograd =
+        vars_.fused_autograd && torch::GradMode::is_enabled() &&
+        (in.betas.requires_grad() || in.full_pose.requires_grad() ||
+         (transl.has_value() && transl->requires_grad()));
+    if (fused_autograd) {
+        return lbs::lbs_fused(in.betas, in.full_pose, v_template, shapedirs,
+                              posedirs, lbs_weights, in.pose2rot, transl,
+                              precomputed);
+    }
+
+    // Otherwise the shape stage only depends on the (unexpanded) betas: it
+    // is cached per vertex set and broadcast over the batch by
+    // pose_and_skin().
+    auto compute = [&] {
+        return lbs::shape_blend(in.betas, v_template, shapedirs, J_regressor_,
+                                precomputed);
+    };
+    auto [v_shaped, rest_joints] =
+        vars_.shape_cache && slot != kNoShapeCache
+            ? shape_cache_.lookup(in.betas, slot, compute)
+            : compute();
+    return lbs::pose_and_skin(v_shaped, rest_joints, in.full_pose, posedirs,
+                              parents_, lbs_weights, in.pose2rot, transl,
+                              precomputed);
+}
+
+auto SMPL::forward(const SMPLInput &input) const -> SMPLOutput {
+    ExecutionGuard execution_guard(vars_.execution);
+    ArenaGuard arena_guard(arena_.get());
+    std::optional<c10::InferenceMode> inference_guard;
+    if (vars_.inference) {
+        inference_guard.emplace();
     }
-    auto [vertices, joints] = lbs::lbs(
-        vars_.betas.value(), full_pose, v_template_, shapedirs_, posedirs_,
-        J_regressor_, parents_, lbs_weights_, vars_.pose2rot);
+    if (auto out = forward_single_pose(input)) {
+        return *std::move(out);
+    }
+    if (const auto chunk_size = chunk_size_for(input); chunk_size > 0) {
+        return forward_chunked(input, chunk_size);
+    }
+    return forward_batch(input);
+}
 
-    vertices = vertices.to(device_);
-    joints = joints.to(device_);
-    joints = vertex_joint_selector_->forward(vertices, joints);
+auto SMPL::forward_batch(const SMPLInput &input, bool shape_cache) const
+    -> SMPLOutput {
+    const auto in = resolve(input);
+
+    // The translation is fused into the skinning pass, unless a joint mapper
+    // has to see the joints before they are translated.
+    const bool fuse_transl = !vars_.joint_mapper.has_value();
+    const auto lbs_transl =
+        fuse_transl ? std::make_optional(in.transl) : std::nullopt;
+
+    Tensor vertices, joints;
+    if (input.return_verts) {
+        std::tie(vertices, joints) =
+            run_lbs(in, lbs_transl, shape_cache ? kFullShape : kNoShapeCache,
+                    v_template_, shapedirs_, posedirs_, lbs_weights_,
+                    precomputed_);
+        vertices = vertices.to(device_);
+        joints = torch::cat(
+            {joints.to(device_),
+             lbs::regress_keypoints(keypoint_regressor_, vertices)},
+            1);
+    } else {
+        // Only the vertices used by the keypoint regressor are skinned.
+        const auto &subset = keypoint_vertices_;
+        auto [subset_vertices, body_joints] =
+            run_lbs(in, lbs_transl,
+                    shape_cache ? kKeypointShape : kNoShapeCache,
+                    subset.v_template, subset.shapedirs, subset.posedirs,
+                    subset.lbs_weights, subset.precomputed);
+        joints = torch::cat(
+                     {body_joints, lbs::regress_keypoints(
+                                       keypoint_subset_regressor_,
+                                       subset_vertices)},
+                     1)
+                     .to(device_);
+    }
 
-    if (vars_.joint_mapper.has_value()) {
+    if (!fuse_transl) {
         joints = vars_.joint_mapper.value()(joints);
+        joints += in.transl.unsqueeze(1);
+        if (vertices.defined()) {
+            vertices += in.transl.unsqueeze(1);
+        }
     }
 
-    joints += vars_.transl.value().unsqueeze(1);
-    vertices += vars_.transl.value().unsqueeze(1);
+    return {input.return_verts ? std::make_optional(vertices) : std::nullopt,
+            joints,
+            input.return_full_pose ? std::make_optional(in.full_pose)
+                                   : std::nullopt,
+            in.global_orient,
+            in.batch_betas,
+            in.body_pose,
+            in.transl};
+}
+
+auto SMPL::chunk_size_for(const SMPLInput &input) const -> int64_t {
+    const auto &betas = input.betas ? *input.betas : vars_.betas.value();
+    const auto &global_orient =
+        input.global_orient ? *input.global_orient
+                            : vars_.global_orient.value();
+    const auto &body_pose =
+        input.body_pose ? *input.body_pose : vars_.body_pose.value();
+    const auto &transl = input.transl ? *input.transl : vars_.transl.value();
+    const auto B = mmax(betas.size(0), global_orient.size(0), body_pose.size(0));
+
+    // Chunks are written into preallocated outputs, which autograd cannot
+    // follow.
+    if (torch::GradMode::is_enabled() &&
+        (betas.requires_grad() || global_orient.requires_grad() ||
+         body_pose.requires_grad() || transl.requires_grad())) {
+        return 0;
+    }
+    int64_t chunk_size = 0;
+    if (vars_.batch_chunk.has_value()) {
+        chunk_size = *vars_.batch_chunk;
+    } else if (device_.is_cpu() && B >= kAutoChunkMinBatch) {
+        chunk_size = this->chunk_size(input.return_verts);
+    }
+    return chunk_size > 0 && B > chunk_size ? chunk_size : 0;
+}
 
-    return {vars_.return_verts ? std::make_optional(vertices) : std::nullopt,
+auto SMPL::chunk_size(bool return_verts) const -> int64_t {
+    if (vars_.batch_chunk.has_value()) {
+        return *vars_.batch_chunk;
+    }
+    std::lock_guard<std::mutex> lock(chunk_mutex_);
+    auto &tuned = tuned_chunk_[return_verts ? 1 : 0];
+    if (tuned > 0) {
+        return tuned;
+    }
+
+    // Everything the best chunk size depends on, besides the machine.
+    std::ostringstream key;
+    key << "V" << v_template_.size(0) << "-J" << parents_.size(0) << "-K"
+        << keypoint_regressor_.num_keypoints() << "-L" << shapedirs_.size(2)
+        << "-" << c10::toString(compute_dtype_) << "-"
+        << c10::toString(shapedirs_.scalar_type()) << "-topk"
+        << (precomputed_.sparse_weights
+                ? precomputed_.sparse_weights->indices.size(1)
+                : 0)
+        << "-rank"
+        << (precomputed_.low_rank_posedirs
+                ? precomputed_.low_rank_posedirs->rank()
+                : 0)
+        << (precomputed_.block_sparse_posedirs ? "-blocks" : "") << "-threads"
+        << at::get_num_threads() << (return_verts ? "-verts" : "-joints")
+        << (device_.is_cpu() ? "-cpu" : "-" + device_.str());
+    const auto path = chunk_cache_path();
+    if (auto cached = load_chunk_size(path, key.str())) {
+        tuned = *cached;
+        return tuned;
+    }
+
+    // Bodies per candidate: enough calls to cover the largest candidate
+    // twice, so that every size moves the same amount of work. The runs
+    // bypass the shape cache, which keeps the caller's shape.
+    const auto bodies = 2 * kChunkCandidates.back();
+    auto opts = torch::dtype(compute_dtype_).device(device_);
+    auto seconds_per_body = [&](int64_t chunk) {
+        SMPLInput input;
+        input.betas = torch::randn({chunk, shapedirs_.size(2)}, opts);
+        input.global_orient = torch::randn({chunk, 3}, opts) * 0.3;
+        input.body_pose = torch::randn({chunk, NUM_BODY_JOINTS * 3}, opts) * 0.3;
+        input.transl = torch::zeros({chunk, 3}, opts);
+        input.return_verts = return_verts;
+        forward_batch(input, false);
+        const auto calls = std::max<int64_t>(2, bodies / chunk);
+        const auto start = std::chrono::steady_clock::now();
+        for (int64_t i = 0; i < calls; ++i) {
+            forward_batch(input, false);
+        }
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return elapsed.count() / double(calls * chunk);
+    };
+    {
+        torch::NoGradGuard no_grad;
+        tuned = autotune_chunk_size(kChunkCandidates, seconds_per_body);
+    }
+    store_chunk_size(path, key.str(), tuned);
+    return tuned;
+}
+
+auto SMPL::forward_chunked(const SMPLInput &input, int64_t chunk_size) const
+    -> SMPLOutput {
+    const auto in = resolve(input);
+    const auto B = in.batch_betas.size(0);
+    auto rows = [&](const Tensor &t, int64_t start, int64_t n) {
+        return t.size(0) == 1 ? t : t.narrow(0, start, n);
+    };
+
+    // Every chunk runs the whole pipeline, so only one chunk of
+    // intermediates is alive at a time.
+    Tensor vertices, joints;
+    for (int64_t start = 0; start < B; start += chunk_size) {
+        const auto n = std::min(chunk_size, B - start);
+        SMPLInput chunk;
+        chunk.betas = rows(in.betas, start, n);
+        chunk.global_orient = rows(in.global_orient, start, n);
+        chunk.body_pose = rows(in.body_pose, start, n);
+        chunk.transl = rows(in.transl, start, n);
+        chunk.pose2rot = input.pose2rot;
+        chunk.return_verts = input.return_verts;
+        auto out = forward_batch(chunk);
+
+        if (!joints.defined()) {
+            auto sizes = out.joints->sizes().vec();
+            sizes[0] = B;
+            joints = torch::empty(sizes, out.joints->options());
+            if (input.return_verts) {
+                sizes = out.vertices->sizes().vec();
+                sizes[0] = B;
+                vertices = torch::empty(sizes, out.vertices->options());
+            }
+        }
+        joints.narrow(0, start, n).copy_(*out.joints);
+        if (input.return_verts) {
+            vertices.narrow(0, start, n).copy_(*out.vertices);
+        }
+    }
+
+    return {input.return_verts ? std::make_optional(vertices) : std::nullopt,
             joints,
-            vars_.return_full_pose ? std::make_optional(full_pose)
+            input.return_full_pose ? std::make_optional(in.full_pose)
+                                   : std::nullopt,
+            in.global_orient,
+            in.batch_betas,
+            in.body_pose,
+            in.transl};
+}
+
+auto SMPL::vertex_subset(const Tensor &vertex_ids) const -> lbs::VertexSubset {
+    TORCH_CHECK(vertex_ids.dim() == 1, "vertex_subset: expected 1-D indices");
+    return lbs::select_vertices(vertex_ids.to(device_), v_template_,
+                                shapedirs_, posedirs_, lbs_weights_,
+                                precomputed_);
+}
+
+auto SMPL::forward(const SMPLInput &input,
+                   const lbs::VertexSubset &subset) const -> SMPLOutput {
+    ExecutionGuard execution_guard(vars_.execution);
+    ArenaGuard arena_guard(arena_.get());
+    std::optional<c10::InferenceMode> inference_guard;
+    if (vars_.inference) {
+        inference_guard.emplace();
+    }
+    const auto in = resolve(input);
+    // Subsets are not cached: several of them may share the same betas.
+    auto [vertices, joints] =
+        run_lbs(in, in.transl, kNoShapeCache, subset.v_template,
+                subset.shapedirs, subset.posedirs, subset.lbs_weights,
+                subset.precomputed);
+
+    return {vertices.to(device_),
+            joints.to(device_),
+            input.return_full_pose ? std::make_optional(in.full_pose)
                                    : std::nullopt,
-            vars_.global_orient,
-            vars_.betas,
-            vars_.body_pose};
+            in.global_orient,
+            in.batch_betas,
+            in.body_pose,
+            in.transl};
+}
+
+auto SMPL::sparse_weights_error(const SMPLInput &input) const -> double {
+    if (!precomputed_.sparse_weights.has_value()) {
+        return 0;
+    }
+    torch::NoGradGuard no_grad;
+    const auto in = resolve(input);
+
+    auto dense = precomputed_;
+    dense.sparse_weights.reset();
+    auto skin = [&](const lbs::Precomputed &precomputed) {
+        return std::get<0>(lbs::lbs(in.batch_betas, in.full_pose, v_template_,
+                                    shapedirs_, posedirs_, J_regressor_,
+                                    parents_, lbs_weights_, in.pose2rot,
+                                    std::nullopt, precomputed));
+    };
+    return (skin(precomputed_) - skin(dense))
+        .norm(2, -1)
+        .max()
+        .item<double>();
 }
 
 } // namespace smplx
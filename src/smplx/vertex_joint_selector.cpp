@@ -50,7 +50,8 @@ VertexJointSelector::VertexJointSelector(const VertexIDsT &vertex_ids,
         register_buffer("extra_joints_idxs", extra_joints_idxs);
 }
 
-auto VertexJointSelector::forward(Tensor &vertices, Tensor &joints) -> Tensor {
+auto VertexJointSelector::forward(const Tensor &vertices,
+                                  const Tensor &joints) const -> Tensor {
     auto extra_joints = torch::index_select(vertices, 1, extra_joints_idxs_);
 
     return torch::cat({joints, extra_joints}, 1);
@@ -85,5 +85,18 @@ int main() {
         std::cout << std::endl;
     }
 
+    // Casting the stored float64 data to float32 must preserve the values.
+    if (npz_file.count("J_regressor")) {
+        auto f64 = cnpyToTensor(npz_file.at("J_regressor"), torch::kFloat64);
+        auto f32 = cnpyToTensor(npz_file.at("J_regressor"), torch::kFloat32);
+        std::cout << "- J_regressor float64 -> float32 cast\n";
+        if (f32.scalar_type() != torch::kFloat32 ||
+            !torch::allclose(f32.to(torch::kFloat64), f64, 1e-6, 1e-7)) {
+            std::cerr << "  ❌ Cast mismatch\n";
+        } else {
+            std::cout << "  ✅ Cast OK\n";
+        }
+    }
+
     return 0;
 }
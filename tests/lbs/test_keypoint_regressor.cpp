@@ -0,0 +1,47 @@
+#include <torch/torch.h>
+#include <iostream>
+#include "keypoint_regressor.hpp"
+#include "../test_utils.hpp"
+
+// Compares the CSR keypoint regressor (CPU kernel, ATen fallback with
+// gradients, compacted columns) against the dense einsum.
+using namespace smplx::test;
+
+int main() {
+    torch::manual_seed(0);
+    const int64_t B = 3, V = 400, K = 24;
+    auto opts = torch::dtype(torch::kFloat64);
+
+    auto regressor = torch::rand({K, V}, opts);
+    regressor *= (torch::rand({K, V}, opts) < 0.05);
+    auto vertex_ids = torch::tensor({7, 123, 399, 0}, torch::kLong);
+    auto dense = torch::cat(
+        {torch::nn::functional::one_hot(vertex_ids, V).to(torch::kFloat64),
+         regressor});
+
+    auto sparse = smplx::lbs::stack_regressors(
+        smplx::lbs::vertex_regressor(vertex_ids, V, torch::kFloat64),
+        smplx::lbs::sparse_regressor(regressor));
+    auto vertices = torch::randn({B, V, 3}, opts);
+    auto expected = torch::einsum("bik,ji->bjk", {vertices, dense});
+
+    const double tol = 1e-12;
+    check("CSR kernel", smplx::lbs::regress_keypoints(sparse, vertices),
+          expected, tol);
+
+    auto v = vertices.clone().requires_grad_(true);
+    auto out = smplx::lbs::regress_keypoints(sparse, v);
+    check("CSR aten", out, expected, tol);
+    auto grad_out = torch::randn_like(expected);
+    check("CSR grad", torch::autograd::grad({out}, {v}, {grad_out})[0],
+          torch::einsum("bjk,ji->bik", {grad_out, dense}), tol);
+
+    auto [support, compact] = smplx::lbs::compact_regressor(sparse);
+    std::cout << "  " << support.size(0) << " of " << V
+              << " vertices used\n";
+    check("compacted", smplx::lbs::regress_keypoints(
+                           compact, vertices.index_select(1, support)),
+          expected, tol);
+
+    return ok ? 0 : 1;
+}
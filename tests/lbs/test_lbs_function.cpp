@@ -0,0 +1,117 @@
+#include <torch/torch.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include "lbs.hpp"
+#include "smplx.hpp"
+#include "../test_utils.hpp"
+
+// Compares lbs_fused() (single autograd node, analytic backward) with the
+// op-by-op lbs() on a random SMPL-sized kinematic tree: outputs and
+// gradients w.r.t. betas, pose and transl.
+using namespace smplx::test;
+
+int main() {
+    torch::manual_seed(0);
+    const int64_t B = 4, V = 300, J = 24, L = 10;
+    auto opts = torch::dtype(torch::kFloat64);
+
+    auto v_template = torch::randn({V, 3}, opts);
+    auto shapedirs = torch::randn({V, 3, L}, opts) * 0.1;
+    auto posedirs = torch::randn({(J - 1) * 9, V * 3}, opts) * 0.01;
+    auto lbs_weights = torch::softmax(torch::randn({V, J}, opts) * 4, 1);
+    auto J_regressor = torch::softmax(torch::randn({J, V}, opts) * 4, 1);
+    auto parents = torch::tensor(
+        std::vector<int64_t>(std::begin(smplx::SMPL::parents),
+                             std::end(smplx::SMPL::parents)));
+
+    smplx::lbs::Precomputed precomputed;
+    std::tie(precomputed.J_template, precomputed.J_shapedirs) =
+        smplx::lbs::regress_shape_joints(J_regressor, v_template, shapedirs);
+    precomputed.kinematic_tree = smplx::lbs::build_kinematic_tree(parents);
+
+    // betas shared by the whole batch, to also cover the broadcast.
+    auto betas = torch::randn({1, L}, opts).requires_grad_(true);
+    auto pose = (torch::randn({B, J * 3}, opts) * 0.5).requires_grad_(true);
+    auto transl = torch::randn({B, 3}, opts).requires_grad_(true);
+    auto grad_verts = torch::randn({B, V, 3}, opts);
+    auto grad_joints = torch::randn({B, J, 3}, opts);
+
+    auto run = [&](bool fused, const smplx::lbs::Precomputed &pre) {
+        auto [verts, joints] =
+            fused ? smplx::lbs::lbs_fused(betas, pose, v_template, shapedirs,
+                                          posedirs, lbs_weights, true, transl,
+                                          pre)
+                  : smplx::lbs::lbs(betas.expand({B, -1}), pose, v_template,
+                                    shapedirs, posedirs, J_regressor, parents,
+                                    lbs_weights, true, transl, pre);
+        auto grads = torch::autograd::grad({verts, joints},
+                                           {betas, pose, transl},
+                                           {grad_verts, grad_joints});
+        grads.insert(grads.begin(), {verts, joints});
+        return grads;
+    };
+
+    const char *names[] = {"vertices", "joints", "grad betas", "grad pose",
+                           "grad transl"};
+    auto compare = [&](const std::string &label,
+                       const smplx::lbs::Precomputed &pre) {
+        auto fused = run(true, pre);
+        auto reference = run(false, pre);
+        for (size_t i = 0; i < fused.size(); ++i) {
+            check(label + names[i], fused[i], reference[i]);
+        }
+    };
+
+    compare("", precomputed);
+    auto sparse = precomputed;
+    sparse.sparse_weights = smplx::lbs::compress_weights(lbs_weights, 4);
+    compare("top-4 ", sparse);
+
+    // Finite differences of the fused path on its own, for the global
+    // orientation (the root of the chain) and the betas it moves through
+    // the root rest joint.
+    {
+        auto grads = run(true, precomputed);
+        auto loss = [&](const torch::Tensor &b, const torch::Tensor &p) {
+            auto [verts, joints] = smplx::lbs::lbs_fused(
+                b, p, v_template, shapedirs, posedirs, lbs_weights, true,
+                transl, precomputed);
+            return ((verts * grad_verts).sum() + (joints * grad_joints).sum())
+                .item<double>();
+        };
+        torch::NoGradGuard no_grad;
+        const double eps = 1e-5;
+        double err = 0;
+        for (int64_t k = 0; k < 3; ++k) {
+            for (int64_t b = 0; b < B; ++b) {
+                auto plus = pose.detach().clone(), minus = plus.clone();
+                plus[b][k] += eps;
+                minus[b][k] -= eps;
+                const double numeric =
+                    (loss(betas.detach(), plus) - loss(betas.detach(), minus)) /
+                    (2 * eps);
+                err = std::max(err, std::abs(numeric -
+                                             grads[3][b][k].item<double>()));
+            }
+        }
+        for (int64_t l = 0; l < L; ++l) {
+            auto plus = betas.detach().clone(), minus = plus.clone();
+            plus[0][l] += eps;
+            minus[0][l] -= eps;
+            const double numeric =
+                (loss(plus, pose.detach()) - loss(minus, pose.detach())) /
+                (2 * eps);
+            err = std::max(err,
+                           std::abs(numeric - grads[2][0][l].item<double>()));
+        }
+        std::ostringstream what;
+        what << "global_orient and betas vs finite differences, max abs "
+                "error: "
+             << err;
+        expect(err < 1e-5, what.str());
+    }
+
+    return ok ? 0 : 1;
+}
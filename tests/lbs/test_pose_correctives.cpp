@@ -0,0 +1,55 @@
+#include <torch/torch.h>
+#include <iostream>
+#include "pose_correctives.hpp"
+#include "../test_utils.hpp"
+
+// Checks the compressed pose correctives against the dense product: the
+// block-sparse kernel (with some joints at rest), its ATen fallback and
+// backward, and a full-rank factorization.
+using namespace smplx::test;
+
+int main() {
+    torch::manual_seed(0);
+    const int64_t B = 4, V = 300, NJ = 23;
+    auto opts = torch::dtype(torch::kFloat64);
+
+    // Each joint only moves a contiguous range of vertices.
+    auto posedirs = torch::zeros({NJ * 9, V * 3}, opts);
+    for (int64_t j = 0; j < NJ; ++j) {
+        const int64_t begin = (j * 13) % (V - 40);
+        posedirs.narrow(0, j * 9, 9)
+            .narrow(1, begin * 3, 120)
+            .copy_(torch::randn({9, 120}, opts) * 1e-2);
+    }
+    auto feature = torch::randn({B, NJ * 9}, opts);
+    feature.narrow(1, 3 * 9, 9).zero_();
+    feature.narrow(1, 10 * 9, 18).zero_();
+    auto dense = torch::matmul(feature, posedirs);
+
+    auto block_sparse = smplx::lbs::block_sparse_posedirs(posedirs, 0, 32);
+    std::cout << "  kept " << block_sparse.nnz() << " blocks ("
+              << block_sparse.density() * 100 << "% dense)\n";
+    check("block-sparse kernel",
+          smplx::lbs::block_sparse_correctives(feature, block_sparse), dense);
+
+    auto f = feature.clone().requires_grad_(true);
+    auto out = smplx::lbs::block_sparse_correctives(f, block_sparse);
+    check("block-sparse aten", out, dense);
+
+    auto grad_out = torch::randn({B, V * 3}, opts);
+    check("block-sparse backward",
+          smplx::lbs::block_sparse_correctives_backward(grad_out, block_sparse),
+          torch::matmul(grad_out, posedirs.t()));
+    check("block-sparse autograd",
+          torch::autograd::grad({out}, {f}, {grad_out})[0],
+          torch::matmul(grad_out, posedirs.t()));
+
+    auto low_rank = smplx::lbs::factorize_posedirs(posedirs, NJ * 9);
+    check("full-rank factors",
+          torch::matmul(torch::matmul(feature, low_rank.left), low_rank.right),
+          dense);
+    std::cout << "  full-rank benchmark error: " << low_rank.max_vertex_error
+              << "\n";
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <torch/torch.h>
+#include <iostream>
+#include "rotation.hpp"
+#include "../test_utils.hpp"
+
+// Checks the fused Rodrigues and quaternion kernels against the textbook
+// formulas, and their analytic gradients against central differences.
+namespace {
+auto rodrigues_textbook(const torch::Tensor &r) -> torch::Tensor {
+    auto angle = r.norm(2, 1, true).unsqueeze(-1);
+    auto k = r / r.norm(2, 1, true);
+    auto zeros = torch::zeros({r.size(0)}, r.options());
+    auto K = torch::stack({zeros, -k.select(1, 2), k.select(1, 1),
+                           k.select(1, 2), zeros, -k.select(1, 0),
+                           -k.select(1, 1), k.select(1, 0), zeros},
+                          1)
+                 .view({-1, 3, 3});
+    return torch::eye(3, r.options()) + angle.sin() * K +
+           (1 - angle.cos()) * torch::bmm(K, K);
+}
+
+// Gradient of sum(G * f(x)) by central differences.
+auto numeric_grad(const std::function<torch::Tensor(torch::Tensor)> &f,
+                  const torch::Tensor &x, const torch::Tensor &G,
+                  double h = 1e-6) -> torch::Tensor {
+    auto grad = torch::zeros_like(x);
+    auto flat = grad.view({-1});
+    for (int64_t i = 0; i < x.numel(); ++i) {
+        auto xp = x.clone(), xm = x.clone();
+        xp.view({-1})[i] += h;
+        xm.view({-1})[i] -= h;
+        flat[i] = ((f(xp) - f(xm)) * G).sum() / (2 * h);
+    }
+    return grad;
+}
+} // namespace
+
+using namespace smplx::test;
+
+int main() {
+    torch::manual_seed(0);
+    auto opts = torch::dtype(torch::kFloat64);
+
+    // Mix of regular, small and exactly zero angles.
+    auto r = torch::cat({torch::randn({64, 3}, opts) * 2,
+                         torch::randn({16, 3}, opts) * 1e-4,
+                         torch::zeros({1, 3}, opts)});
+    auto R = smplx::lbs::rodrigues(r);
+    auto nonzero = torch::indexing::Slice(0, 80);
+    check("rodrigues", R.index({nonzero}),
+          rodrigues_textbook(r.index({nonzero})), 1e-12);
+    check("rodrigues(0)", R[80], torch::eye(3, opts), 0);
+
+    auto G = torch::randn({81, 3, 3}, opts);
+    auto rv = r.clone().requires_grad_(true);
+    auto grad = torch::autograd::grad({smplx::lbs::rodrigues(rv)}, {rv}, {G})[0];
+    auto f = [](torch::Tensor x) { return smplx::lbs::rodrigues(x); };
+    check("rodrigues grad", grad, numeric_grad(f, r, G), 1e-7);
+    check("rodrigues grad finite", grad.isfinite().all().to(opts.dtype()),
+          torch::ones({}, opts), 0);
+
+    // A quaternion of the same rotation gives the same matrix.
+    auto angle = r.index({nonzero}).norm(2, 1, true);
+    auto q = torch::cat({(angle / 2).cos(),
+                         (angle / 2).sin() * r.index({nonzero}) / angle},
+                        1) *
+             3; // unnormalized on purpose
+    check("quaternion", smplx::lbs::quaternion_to_rotation(q),
+          R.index({nonzero}), 1e-12);
+
+    auto Gq = G.index({nonzero});
+    auto qv = q.clone().requires_grad_(true);
+    auto grad_q = torch::autograd::grad(
+        {smplx::lbs::quaternion_to_rotation(qv)}, {qv}, {Gq})[0];
+    auto fq = [](torch::Tensor x) {
+        return smplx::lbs::quaternion_to_rotation(x);
+    };
+    check("quaternion grad", grad_q, numeric_grad(fq, q, Gq), 1e-7);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+#include "arena_allocator.hpp"
+#include "torch/torch.h"
+#include "../test_utils.hpp"
+
+// Checks the bucketing, caching and statistics of ArenaAllocator, the
+// routing of ArenaGuard (nested and null guards), and blocks that outlive
+// their arena.
+//
+//   ./test_arena_allocator
+
+using namespace smplx::test;
+
+namespace {
+// A CPU tensor of n bytes, allocated through whatever the guards route to.
+auto bytes(int64_t n) -> torch::Tensor {
+    return torch::empty({n}, torch::dtype(torch::kUInt8));
+}
+} // namespace
+
+int main() {
+    using smplx::ArenaAllocator;
+
+    // Buckets: at least 512 bytes, then four per power of two.
+    expect(ArenaAllocator::bucket_size(1) == 512 &&
+               ArenaAllocator::bucket_size(512) == 512 &&
+               ArenaAllocator::bucket_size(513) == 640 &&
+               ArenaAllocator::bucket_size(1000) == 1024 &&
+               ArenaAllocator::bucket_size(1025) == 1280,
+           "bucket sizes");
+    bool bounded = true;
+    for (size_t n = 513; n < (1 << 20); n = n * 5 / 4 + 7) {
+        const auto b = ArenaAllocator::bucket_size(n);
+        bounded &= b >= n && b - n <= n / 4 && b % 64 == 0;
+    }
+    expect(bounded, "buckets hold the request with at most 25% slack");
+
+    {
+        ArenaAllocator arena;
+        { auto block = arena.allocate(1000); }
+        auto stats = arena.stats();
+        expect(stats.misses == 1 && stats.hits == 0 &&
+                   stats.bytes_held == 1024 && stats.bytes_in_use == 0,
+               "a freed block stays cached");
+
+        auto block = arena.allocate(900); // same bucket
+        stats = arena.stats();
+        expect(stats.hits == 1 && stats.misses == 1 &&
+                   stats.bytes_in_use == 1024 && stats.bytes_held == 1024,
+               "hit after a free");
+        expect(reinterpret_cast<uintptr_t>(block.get()) % 64 == 0,
+               "blocks are 64-byte aligned");
+
+        auto other = arena.allocate(4096);
+        stats = arena.stats();
+        expect(stats.peak_bytes_held == 1024 + 4096, "peak bytes held");
+        other.clear();
+        block.clear();
+        arena.reset_stats();
+        stats = arena.stats();
+        expect(stats.hits == 0 && stats.misses == 0 &&
+                   stats.peak_bytes_held == stats.bytes_held,
+               "reset_stats keeps what is held");
+        arena.release_cached();
+        expect(arena.stats().bytes_held == 0, "release_cached");
+    }
+
+    {
+        // Over max_bytes_held, freed blocks go back to the system.
+        ArenaAllocator arena(/*max_bytes_held=*/1024);
+        auto a = arena.allocate(1000);
+        auto b = arena.allocate(1000);
+        expect(arena.stats().bytes_held == 2048, "held while in use");
+        a.clear();
+        expect(arena.stats().bytes_held == 1024,
+               "block freed over max_bytes_held is released");
+        b.clear();
+        expect(arena.stats().bytes_held == 1024,
+               "block freed within max_bytes_held is cached");
+    }
+
+    {
+        ArenaAllocator outer, inner;
+        {
+            smplx::ArenaGuard guard(&outer);
+            auto t = bytes(1000);
+            expect(outer.stats().misses == 1, "guard routes to its arena");
+            {
+                smplx::ArenaGuard nested(&inner);
+                auto u = bytes(1000);
+                expect(inner.stats().misses == 1 && outer.stats().misses == 1,
+                       "nested guard routes to the inner arena");
+            }
+            {
+                smplx::ArenaGuard null_guard(nullptr);
+                auto u = bytes(3000);
+                expect(outer.stats().misses == 2,
+                       "null guard keeps the enclosing arena");
+            }
+            auto u = bytes(1000);
+            expect(inner.stats().misses == 1 && outer.stats().misses == 3,
+                   "enclosing arena restored after the nested guard");
+        }
+        const auto before = outer.stats();
+        auto t = bytes(1000);
+        const auto after = outer.stats();
+        expect(after.hits == before.hits && after.misses == before.misses,
+               "no routing outside a guard");
+    }
+
+    {
+        // Tensors and blocks may outlive their arena.
+        auto arena = std::make_unique<ArenaAllocator>();
+        torch::Tensor t;
+        c10::DataPtr block;
+        {
+            smplx::ArenaGuard guard(arena.get());
+            t = torch::ones({1000}, torch::dtype(torch::kFloat64));
+        }
+        block = arena->allocate(100);
+        arena.reset();
+        expect(t.sum().item<double>() == 1000, "tensor outlives its arena");
+        t.reset();
+        block.clear();
+        expect(true, "blocks freed after their arena");
+    }
+    return ok ? 0 : 1;
+}
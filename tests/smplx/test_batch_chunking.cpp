@@ -0,0 +1,73 @@
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include "smplx.hpp"
+#include "../test_utils.hpp"
+
+// Checks that chunked forwards match the whole-batch forward, that the
+// autotuned chunk size is persisted and read back without touching the
+// shape cache, and that the cache file keeps one line per key.
+//
+//   ./test_batch_chunking [SMPL_MALE.npz]
+
+using namespace smplx::test;
+
+int main(int argc, char **argv) {
+    const char *model_path = argc > 1 ? argv[1] : "SMPL_MALE.npz";
+    const auto cache_dir =
+        std::filesystem::temp_directory_path() / "smplx_test_batch_chunking";
+    std::filesystem::remove_all(cache_dir);
+    setenv("SMPLX_CACHE_DIR", cache_dir.c_str(), 1);
+    torch::NoGradGuard no_grad;
+
+    // Cache file round trip.
+    const auto path = smplx::chunk_cache_path();
+    expect(path == (cache_dir / "batch_chunks.txt").string(),
+           "cache path from SMPLX_CACHE_DIR");
+    smplx::store_chunk_size(path, "a", 256);
+    smplx::store_chunk_size(path, "b", 64);
+    smplx::store_chunk_size(path, "a", 512);
+    expect(smplx::load_chunk_size(path, "a") == 512, "key a updated");
+    expect(smplx::load_chunk_size(path, "b") == 64, "key b kept");
+    expect(!smplx::load_chunk_size(path, "c").has_value(), "missing key");
+
+    // Chunked vs whole batch, with a partial last chunk and broadcast betas.
+    smplx::SMPL chunked(model_path, torch::kCPU, smplx::batch_chunk(300));
+    smplx::SMPL whole(model_path, torch::kCPU, smplx::batch_chunk(0));
+    const int64_t B = 1000;
+    auto opts = torch::dtype(torch::kFloat64);
+    smplx::SMPLInput input;
+    input.betas = torch::randn({1, 10}, opts);
+    input.global_orient = torch::randn({B, 3}, opts) * 0.3;
+    input.body_pose = torch::randn({B, 69}, opts) * 0.3;
+    input.transl = torch::randn({B, 3}, opts);
+    input.return_verts = true;
+    input.return_full_pose = true;
+    auto out = chunked.forward(input);
+    auto expected = whole.forward(input);
+    check("vertices", *out.vertices, *expected.vertices);
+    check("joints", *out.joints, *expected.joints);
+    check("full pose", *out.full_pose, *expected.full_pose);
+    expect(out.betas->size(0) == B, "betas broadcast over the batch");
+
+    input.return_verts = false;
+    check("joints only", *chunked.forward(input).joints,
+          *whole.forward(input).joints);
+
+    // The autotuned size is stored once and reused by a new model, and the
+    // autotune leaves the cached shape of the caller's betas alone.
+    smplx::SMPL tuned(model_path, torch::kCPU);
+    tuned.forward(input);
+    const auto before = tuned.shape_cache_stats();
+    const auto chunk = tuned.chunk_size(false);
+    tuned.forward(input);
+    const auto after = tuned.shape_cache_stats();
+    expect(after.hits == before.hits + 1 && after.misses == before.misses,
+           "autotune keeps the cached shape");
+    smplx::SMPL reloaded(model_path, torch::kCPU);
+    expect(reloaded.chunk_size(false) == chunk,
+           "autotuned chunk size " + std::to_string(chunk) + " reloaded");
+
+    std::filesystem::remove_all(cache_dir);
+    return ok ? 0 : 1;
+}
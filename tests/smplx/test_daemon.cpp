@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include "daemon.hpp"
+#include "../test_utils.hpp"
+
+// Checks that several client processes served by one DaemonServer get the
+// same results as a local forward, that their requests are batched
+// together, and that a client stuck before its hello blocks nobody.
+//
+//   ./test_daemon [SMPL_MALE.npz]
+
+using namespace smplx::test;
+
+namespace {
+// One client process: a few threads with requests in flight, compared with
+// the forward of a local copy of the model.
+auto run_client(const std::string &socket_path, const char *model_path,
+                int index) -> int {
+    torch::manual_seed(index);
+    torch::NoGradGuard no_grad;
+    smplx::SMPL local(model_path, torch::kCPU, smplx::inference());
+    smplx::DaemonClient client(socket_path, "model", {/*max_rows=*/4,
+                                                      /*num_slots=*/8});
+    const int threads = 2, per_thread = 40;
+    std::vector<std::thread> workers;
+    std::vector<double> errors(threads, 0);
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            torch::NoGradGuard no_grad;
+            std::vector<smplx::SMPLInput> inputs;
+            std::vector<std::future<smplx::SMPLOutput>> futures;
+            for (int i = 0; i < per_thread; ++i) {
+                inputs.push_back(random_input(1 + i % 3, i % 2 == 0));
+                futures.push_back(client.submit(inputs.back()));
+                if (futures.size() < 4 && i + 1 < per_thread) {
+                    continue;
+                }
+                // Outputs hold their slot: compare and drop them.
+                for (size_t j = 0; j < futures.size(); ++j) {
+                    auto out = futures[j].get();
+                    auto expected = local.forward(inputs[j]);
+                    double err = max_abs(*out.joints, *expected.joints);
+                    if (inputs[j].return_verts) {
+                        err = std::max(err, max_abs(*out.vertices,
+                                                    *expected.vertices));
+                    }
+                    errors[t] = std::max(errors[t], err);
+                }
+                inputs.clear();
+                futures.clear();
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+    const double error = *std::max_element(errors.begin(), errors.end());
+    std::cout << "  client " << index << ": max abs error " << error << "\n";
+    return error < 1e-9 ? 0 : 1;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc > 4 && std::string(argv[1]) == "--client") {
+        return run_client(argv[2], argv[3], std::stoi(argv[4]));
+    }
+    const char *model_path = argc > 1 ? argv[1] : "SMPL_MALE.npz";
+    const std::string socket_path =
+        "/tmp/smplx_test_daemon." + std::to_string(getpid()) + ".sock";
+
+    smplx::ExecutorOptions options;
+    options.max_batch = 32;
+    options.max_wait = std::chrono::milliseconds(2);
+    smplx::DaemonServer server(socket_path, options);
+    server.add_model("model", std::make_shared<const smplx::SMPL>(
+                                  model_path, torch::kCPU, smplx::inference()));
+    server.start();
+
+    const int clients = 3;
+    std::vector<pid_t> children;
+    for (int c = 0; c < clients; ++c) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            const std::string index = std::to_string(c);
+            execl("/proc/self/exe", argv[0], "--client", socket_path.c_str(),
+                  model_path, index.c_str(), static_cast<char *>(nullptr));
+            _exit(127);
+        }
+        children.push_back(pid);
+    }
+    int passed = 0;
+    for (const pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        passed += WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    expect(passed == clients, std::to_string(passed) + "/" +
+                                  std::to_string(clients) +
+                                  " clients match forward()");
+
+    // A client that never says hello does not hold up the others.
+    {
+        const int silent = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, socket_path.c_str());
+        connect(silent, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        torch::NoGradGuard no_grad;
+        smplx::DaemonClient client(socket_path, "model");
+        smplx::SMPL local(model_path, torch::kCPU, smplx::inference());
+        const auto input = random_input(2, true);
+        check("vertices while another client is silent",
+              *client.forward(input).vertices, *local.forward(input).vertices);
+        close(silent);
+    }
+
+    // An unknown model is refused at connect.
+    bool refused = false;
+    try {
+        smplx::DaemonClient client(socket_path, "nope");
+    } catch (const c10::Error &) {
+        refused = true;
+    }
+    expect(refused, "unknown model refused");
+
+    server.stop();
+    const auto stats = server.stats("model");
+    std::cout << "  requests " << stats.requests << ", batches "
+              << stats.batches << ", mean batch " << stats.mean_batch_size
+              << ", p50 " << stats.p50_ms << " ms, p99 " << stats.p99_ms
+              << " ms\n";
+    expect(stats.requests == clients * 2 * 40 + 1, "every request served");
+    expect(stats.batches < stats.requests, "requests were batched");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include "executor.hpp"
+#include "../test_utils.hpp"
+
+// Checks that requests submitted concurrently to an Executor get the same
+// results as their own forward, that they are coalesced, that requests
+// which cannot join others still run, and that a malformed request fails
+// without failing others.
+//
+//   ./test_executor [SMPL_MALE.npz]
+
+using namespace smplx::test;
+
+int main(int argc, char **argv) {
+    const char *model_path = argc > 1 ? argv[1] : "SMPL_MALE.npz";
+    torch::NoGradGuard no_grad;
+    auto model = std::make_shared<const smplx::SMPL>(model_path, torch::kCPU,
+                                                     smplx::inference());
+
+    smplx::ExecutorOptions options;
+    options.num_workers = 2;
+    options.max_batch = 32;
+    options.max_wait = std::chrono::milliseconds(2);
+    smplx::Executor executor(model, options);
+
+    // 4 clients x 50 requests of 1 or 2 bodies, with and without vertices.
+    const int clients = 4, per_client = 50;
+    std::vector<std::thread> threads;
+    std::vector<double> errors(clients, 0);
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            torch::NoGradGuard no_grad;
+            std::vector<smplx::SMPLInput> inputs;
+            std::vector<std::future<smplx::SMPLOutput>> futures;
+            for (int i = 0; i < per_client; ++i) {
+                inputs.push_back(random_input(1 + i % 2, c % 2 == 0));
+                futures.push_back(executor.submit(inputs.back()));
+            }
+            for (int i = 0; i < per_client; ++i) {
+                auto out = futures[i].get();
+                auto expected = model->forward(inputs[i]);
+                double err = max_abs(*out.joints, *expected.joints);
+                if (inputs[i].return_verts) {
+                    err = std::max(err,
+                                   max_abs(*out.vertices, *expected.vertices));
+                }
+                errors[c] = std::max(errors[c], err);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    const double error = *std::max_element(errors.begin(), errors.end());
+    expect(error < 1e-9,
+           "results match forward(), max abs error " + std::to_string(error));
+
+    // A request without transl uses the model default and runs alone.
+    auto alone = random_input(1, false);
+    alone.transl.reset();
+    auto out = executor.submit(alone).get();
+    expect(out.joints->size(0) == 1, "request with defaults");
+
+    // Row counts that do not broadcast fail that request only, not the ones
+    // queued with it.
+    auto bad = random_input(4, false);
+    bad.betas = torch::randn({3, 10}, torch::kFloat64);
+    auto first = executor.submit(random_input(2, false));
+    auto failing = executor.submit(bad);
+    auto last = executor.submit(random_input(2, false));
+    bool failed = false;
+    try {
+        failing.get();
+    } catch (const std::exception &) {
+        failed = true;
+    }
+    expect(failed && first.get().joints->size(0) == 2 &&
+               last.get().joints->size(0) == 2,
+           "a malformed request fails alone");
+
+    const auto stats = executor.stats();
+    std::cout << "  requests " << stats.requests << ", batches "
+              << stats.batches << ", mean batch " << stats.mean_batch_size
+              << ", p50 " << stats.p50_ms << " ms, p99 " << stats.p99_ms
+              << " ms\n";
+    expect(stats.requests == clients * per_client + 4, "every request counted");
+    expect(stats.batches < stats.requests, "requests were coalesced");
+    int64_t largest = 0;
+    for (const auto &[size, count] : stats.batch_sizes) {
+        largest = std::max(largest, size);
+    }
+    expect(largest <= options.max_batch, "batches within max_batch");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "c10/core/CPUAllocator.h"
+#include "smplx.hpp"
+#include "../test_utils.hpp"
+
+// Checks that SMPL::forward_into matches forward() and that, once the
+// workspace has seen a call of the same shape, it performs no heap
+// allocation: neither through operator new (TensorImpls, vectors, ...) nor
+// through the CPU tensor allocator.
+//
+//   ./test_forward_into [SMPL_MALE.npz]
+
+namespace {
+std::atomic<bool> counting{false};
+std::atomic<int64_t> allocations{0};
+
+auto counted_malloc(std::size_t size) -> void * {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void *p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Counts the tensor storages allocated by the CPU allocator.
+class CountingAllocator final : public c10::Allocator {
+  public:
+    explicit CountingAllocator(c10::Allocator *base) : base_(base) {}
+
+    auto allocate(size_t n) -> c10::DataPtr override {
+        if (counting.load(std::memory_order_relaxed)) {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        return base_->allocate(n);
+    }
+    auto raw_deleter() const -> c10::DeleterFnPtr override {
+        return base_->raw_deleter();
+    }
+    void copy_data(void *dest, const void *src, size_t count) const override {
+        base_->copy_data(dest, src, count);
+    }
+
+  private:
+    c10::Allocator *base_;
+};
+} // namespace
+
+using namespace smplx::test;
+
+auto operator new(std::size_t size) -> void * { return counted_malloc(size); }
+auto operator new[](std::size_t size) -> void * { return counted_malloc(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+int main(int argc, char **argv) {
+    const char *model_path = argc > 1 ? argv[1] : "SMPL_MALE.npz";
+    static CountingAllocator allocator(c10::GetCPUAllocator());
+    c10::SetCPUAllocator(&allocator, /*priority=*/1);
+
+    torch::NoGradGuard no_grad;
+    smplx::SMPL smpl(model_path, torch::kCPU);
+
+    const int64_t B = 16;
+    auto opts = torch::dtype(torch::kFloat64);
+    smplx::SMPLInput input;
+    input.betas = torch::randn({B, 10}, opts);
+    input.global_orient = torch::randn({B, 3}, opts) * 0.3;
+    input.body_pose = torch::randn({B, 69}, opts) * 0.3;
+    input.transl = torch::randn({B, 3}, opts);
+    input.return_verts = true;
+
+    auto workspace = smpl.make_workspace(B);
+    auto expected = smpl.forward(input);
+    auto out = smpl.forward_into(input, workspace);
+
+    check("vertices", *out.vertices, *expected.vertices);
+    check("joints", *out.joints, *expected.joints);
+
+    // Joints-only calls use the keypoint vertex subset.
+    input.return_verts = false;
+    expected = smpl.forward(input);
+    out = smpl.forward_into(input, workspace);
+    check("joints only", *out.joints, *expected.joints);
+
+    // Steady state: same-shaped calls on a warm workspace.
+    input.return_verts = true;
+    smpl.forward_into(input, workspace);
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < 100; ++i) {
+        smpl.forward_into(input, workspace);
+    }
+    counting = false;
+    const auto count = allocations.load();
+    expect(count == 0, "allocations in 100 steady-state calls: " +
+                           std::to_string(count));
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unistd.h>
+#include "model_file.hpp"
+#include "model_registry.hpp"
+#include "smplx.hpp"
+#include "../test_utils.hpp"
+
+// Checks that save_model_file / MappedModelFile round-trip tensors of every
+// supported dtype bit for bit with aligned data, that corrupt entries are
+// refused, that a converted .tsmx model loads the same buffers as its .npz,
+// and that models keep the dtype and buffers of the data they are built on.
+//
+//   ./test_model_file [SMPL_MALE.npz]
+
+using namespace smplx::test;
+
+namespace {
+// Same dtype, shape and bytes.
+auto identical(const torch::Tensor &a, const torch::Tensor &b) -> bool {
+    if (a.scalar_type() != b.scalar_type() || a.sizes() != b.sizes()) {
+        return false;
+    }
+    auto x = a.contiguous(), y = b.contiguous();
+    return x.nbytes() == y.nbytes() &&
+           (x.nbytes() == 0 ||
+            std::memcmp(x.data_ptr(), y.data_ptr(), x.nbytes()) == 0);
+}
+
+auto aligned(const torch::Tensor &t) -> bool {
+    return reinterpret_cast<uintptr_t>(t.data_ptr()) %
+               smplx::kModelFileAlignment ==
+           0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *npz_path = argc > 1 ? argv[1] : "SMPL_MALE.npz";
+    const std::string tmp =
+        "/tmp/smplx_test_model_file." + std::to_string(getpid());
+
+    // Round-trip of odd shapes and every dtype the models use.
+    torch::manual_seed(0);
+    std::vector<uint32_t> u32 = {0, 1, 7, 23, 0xffffffffu, 42};
+    std::vector<std::pair<std::string, torch::Tensor>> buffers = {
+        {"f64", torch::randn({7, 3, 5}, torch::kFloat64)},
+        {"f32", torch::randn({13}, torch::kFloat32)},
+        {"i64", torch::randint(-1000, 1000, {4, 3}, torch::kInt64)},
+        {"u32", torch::from_blob(u32.data(), {3, 2}, torch::kUInt32)},
+        {"scalar", torch::tensor(3.5, torch::kFloat64)},
+        {"empty", torch::empty({0, 3}, torch::kFloat32)},
+        // Saved contiguous.
+        {"transposed", torch::randn({6, 4}, torch::kFloat64).t()},
+    };
+    const auto round_trip = tmp + ".roundtrip.tsmx";
+    smplx::save_model_file(round_trip, buffers);
+    {
+        smplx::MappedModelFile file(round_trip);
+        expect(file.names().size() == buffers.size(), "every entry listed");
+        bool same = true, all_aligned = true;
+        for (const auto &[name, tensor] : buffers) {
+            auto loaded = file.tensor(name);
+            const bool equal = identical(loaded, tensor);
+            if (!equal) {
+                std::cout << "    mismatch in " << name << "\n";
+            }
+            same &= equal;
+            all_aligned &= loaded.numel() == 0 || aligned(loaded);
+        }
+        expect(same, "round-trip keeps dtypes, shapes and bytes");
+        expect(all_aligned, "buffers are 64-byte aligned");
+    }
+
+    bool refused = false;
+    try {
+        smplx::save_model_file(tmp + ".f16.tsmx",
+                               {{"f16", torch::ones({3}, torch::kFloat16)}});
+    } catch (const std::runtime_error &) {
+        refused = true;
+    }
+    expect(refused, "unsupported dtype refused at save");
+
+    // Corrupt entries are refused at load rather than mapped past the end.
+    auto corrupt = [&](const char *what, auto patch) {
+        std::ifstream in(round_trip, std::ios::binary);
+        std::vector<char> bytes(std::istreambuf_iterator<char>(in), {});
+        smplx::ModelFileEntry entry{};
+        const auto at = sizeof(smplx::ModelFileHeader);
+        std::memcpy(&entry, bytes.data() + at, sizeof(entry));
+        patch(entry);
+        std::memcpy(bytes.data() + at, &entry, sizeof(entry));
+        const auto path = tmp + ".corrupt.tsmx";
+        std::ofstream(path, std::ios::binary)
+            .write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        bool rejected = false;
+        try {
+            smplx::MappedModelFile file(path);
+        } catch (const std::runtime_error &) {
+            rejected = true;
+        }
+        std::remove(path.c_str());
+        expect(rejected, std::string("rejects ") + what);
+    };
+    corrupt("a wrapping offset + nbytes", [](smplx::ModelFileEntry &e) {
+        e.nbytes = UINT64_MAX - e.offset + 1 + smplx::kModelFileAlignment;
+    });
+    corrupt("nbytes smaller than the shape", [](smplx::ModelFileEntry &e) {
+        e.nbytes -= 8;
+    });
+    corrupt("a shape larger than nbytes", [](smplx::ModelFileEntry &e) {
+        e.shape[0] *= 2;
+    });
+    corrupt("a negative dim", [](smplx::ModelFileEntry &e) {
+        e.shape[0] = -e.shape[0];
+    });
+    corrupt("an unknown dtype", [](smplx::ModelFileEntry &e) {
+        e.dtype = 1000;
+    });
+    std::remove(round_trip.c_str());
+
+    // A converted model loads the same buffers as the npz.
+    for (auto dtype : {torch::kFloat64, torch::kFloat32}) {
+        const auto converted = tmp + ".model.tsmx";
+        smplx::convert_npz_to_model_file(npz_path, converted, dtype);
+        const auto npz = smplx::load_model_data(npz_path, torch::kCPU, dtype);
+        const auto mapped =
+            smplx::load_model_data(converted, torch::kCPU, dtype);
+        const auto stored =
+            smplx::load_model_data(converted, torch::kCPU, std::nullopt);
+        // A model of the file's dtype keeps the mapped buffers.
+        smplx::SMPL smpl(converted.c_str(), torch::kCPU,
+                         smplx::model_dtype(dtype));
+        std::remove(converted.c_str());
+
+        const std::pair<const char *, const torch::Tensor *> pairs[] = {
+            {"shapedirs", &npz.shapedirs},
+            {"v_template", &npz.v_template},
+            {"J_regressor", &npz.J_regressor},
+            {"posedirs", &npz.posedirs},
+            {"weights", &npz.lbs_weights},
+            {"f", &npz.faces},
+            {"parents", &npz.parents}};
+        const torch::Tensor *loaded[] = {
+            &mapped.shapedirs, &mapped.v_template, &mapped.J_regressor,
+            &mapped.posedirs,  &mapped.lbs_weights, &mapped.faces,
+            &mapped.parents};
+        bool same = true, all_aligned = true;
+        for (size_t i = 0; i < std::size(pairs); ++i) {
+            const bool equal = identical(*loaded[i], *pairs[i].second);
+            if (!equal) {
+                std::cout << "    mismatch in " << pairs[i].first << "\n";
+            }
+            same &= equal;
+            all_aligned &= aligned(*loaded[i]);
+        }
+        const std::string label =
+            dtype == torch::kFloat64 ? "float64" : "float32";
+        expect(same, label + " .tsmx matches the npz bit for bit");
+        expect(all_aligned, label + " .tsmx buffers are 64-byte aligned");
+        expect(npz.posedirs.scalar_type() == dtype &&
+                   mapped.faces.scalar_type() == torch::kInt64 &&
+                   mapped.parents.scalar_type() == torch::kInt64,
+               label + " buffer dtypes");
+        expect(stored.dtype == dtype &&
+                   stored.shapedirs.scalar_type() == dtype,
+               label + " .tsmx loads in its stored dtype");
+        const auto &data = *smpl.model_data();
+        expect(data.dtype == dtype &&
+                   smpl.named_buffers()["shapedirs"].data_ptr() ==
+                       data.shapedirs.data_ptr(),
+               label + " model shares its loaded buffers");
+    }
+
+    // Handles over a float32 registry entry share its buffers.
+    auto shared = smplx::ModelRegistry::instance().get(
+        {npz_path, "male", torch::kFloat32});
+    smplx::SMPL first(shared), second(shared);
+    expect(first.compute_dtype() == torch::kFloat32 &&
+               first.named_buffers()["shapedirs"].data_ptr() ==
+                   shared->shapedirs.data_ptr() &&
+               second.named_buffers()["shapedirs"].data_ptr() ==
+                   shared->shapedirs.data_ptr(),
+           "models over float32 shared data keep its dtype and buffers");
+    return ok ? 0 : 1;
+}
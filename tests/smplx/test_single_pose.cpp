@@ -0,0 +1,93 @@
+#include <chrono>
+#include <iostream>
+#include "rotation.hpp"
+#include "smplx.hpp"
+#include "../test_utils.hpp"
+
+// Checks that batch-1 forwards through the single-pose kernel match the
+// batched ATen path, with full and top-k skinning weights and low-rank
+// posedirs, and reports their latency.
+//
+//   ./test_single_pose [SMPL_MALE.npz]
+
+using namespace smplx::test;
+
+namespace {
+auto latency_us(const smplx::SMPL &smpl, const smplx::SMPLInput &input)
+    -> double {
+    const int iterations = 1000;
+    for (int i = 0; i < 10; ++i) {
+        smpl.forward(input);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        smpl.forward(input);
+    }
+    std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+void compare(const char *name, const smplx::SMPL &fast,
+             const smplx::SMPL &batched, smplx::SMPLInput input) {
+    std::cout << name << "\n";
+    input.return_verts = true;
+    auto out = fast.forward(input);
+    auto expected = batched.forward(input);
+    check("vertices", *out.vertices, *expected.vertices);
+    check("joints", *out.joints, *expected.joints);
+    std::cout << "     full mesh: " << latency_us(fast, input) << " us vs "
+              << latency_us(batched, input) << " us\n";
+
+    input.return_verts = false;
+    out = fast.forward(input);
+    expected = batched.forward(input);
+    check("joints only", *out.joints, *expected.joints);
+    std::cout << "     joints:    " << latency_us(fast, input) << " us vs "
+              << latency_us(batched, input) << " us\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *model_path = argc > 1 ? argv[1] : "SMPL_MALE.npz";
+    torch::NoGradGuard no_grad;
+    torch::set_num_threads(1);
+
+    auto opts = torch::dtype(torch::kFloat64);
+    smplx::SMPLInput input;
+    input.betas = torch::randn({1, 10}, opts);
+    input.global_orient = torch::randn({1, 3}, opts) * 0.3;
+    input.body_pose = torch::randn({1, 69}, opts) * 0.3;
+    input.transl = torch::randn({1, 3}, opts);
+
+    {
+        smplx::SMPL fast(model_path, torch::kCPU);
+        smplx::SMPL batched(model_path, torch::kCPU,
+                            smplx::single_pose(false));
+        compare("dense", fast, batched, input);
+
+        // Rotation matrices instead of axis-angle.
+        auto rot = smplx::lbs::rodrigues(
+            torch::cat({*input.global_orient, *input.body_pose}, 1)
+                .view({-1, 3}));
+        smplx::SMPLInput matrices = input;
+        matrices.global_orient = rot.narrow(0, 0, 1).reshape({1, 9});
+        matrices.body_pose = rot.narrow(0, 1, 23).reshape({1, 23 * 9});
+        matrices.pose2rot = false;
+        compare("rotation matrices", fast, batched, matrices);
+    }
+    {
+        smplx::SMPL fast(model_path, torch::kCPU, smplx::lbs_topk(4));
+        smplx::SMPL batched(model_path, torch::kCPU, smplx::lbs_topk(4),
+                            smplx::single_pose(false));
+        compare("top-4 weights", fast, batched, input);
+    }
+    {
+        smplx::SMPL fast(model_path, torch::kCPU, smplx::posedirs_rank(32));
+        smplx::SMPL batched(model_path, torch::kCPU, smplx::posedirs_rank(32),
+                            smplx::single_pose(false));
+        compare("rank-32 posedirs", fast, batched, input);
+    }
+
+    return ok ? 0 : 1;
+}
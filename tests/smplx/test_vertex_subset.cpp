@@ -0,0 +1,68 @@
+#include <iostream>
+#include "smplx.hpp"
+#include "../test_utils.hpp"
+
+// Checks that SMPL::forward over a vertex subset gives the rows of the full
+// forward at those vertices, the model joints, and the same gradients with
+// respect to the parameters.
+//
+//   ./test_vertex_subset [SMPL_MALE.npz]
+
+using namespace smplx::test;
+
+int main(int argc, char **argv) {
+    const char *model_path = argc > 1 ? argv[1] : "SMPL_MALE.npz";
+    torch::manual_seed(0);
+
+    for (const bool fused : {false, true}) {
+        smplx::SMPL smpl(model_path, torch::kCPU,
+                         smplx::fused_autograd(fused));
+        const std::string label = fused ? "fused autograd: " : "autograd: ";
+        const int64_t num_vertices = smpl.model_data().v_template.size(0);
+
+        // Unordered ids with a repeat.
+        auto ids = torch::randint(0, num_vertices, {200}, torch::kInt64);
+        ids[7] = ids[3];
+        const auto subset = smpl.vertex_subset(ids);
+
+        auto opts = torch::dtype(torch::kFloat64);
+        auto betas = torch::randn({4, 10}, opts).requires_grad_();
+        auto global_orient = (torch::randn({4, 3}, opts) * 0.5).requires_grad_();
+        auto body_pose = (torch::randn({4, 69}, opts) * 0.3).requires_grad_();
+        auto transl = torch::randn({4, 3}, opts).requires_grad_();
+        smplx::SMPLInput input;
+        input.betas = betas;
+        input.global_orient = global_orient;
+        input.body_pose = body_pose;
+        input.transl = transl;
+        input.return_verts = true;
+
+        const auto part = smpl.forward(input, subset);
+        const auto full = smpl.forward(input);
+        const auto expected = full.vertices->index_select(1, ids);
+        expect(part.vertices->sizes() == expected.sizes() &&
+                   max_abs(*part.vertices, expected) < 1e-10,
+               label + "subset vertices match forward().vertices[:, ids]");
+        const auto num_joints = part.joints.size(1);
+        expect(max_abs(part.joints, full.joints.narrow(1, 0, num_joints)) <
+                   1e-10,
+               label + "subset joints are the model joints");
+
+        // The same loss through both paths.
+        const auto weights = torch::randn(expected.sizes(), opts);
+        const std::vector<torch::Tensor> params = {betas, global_orient,
+                                                   body_pose, transl};
+        const auto subset_grads = torch::autograd::grad(
+            {(*part.vertices * weights).sum()}, params);
+        const auto full_grads =
+            torch::autograd::grad({(expected * weights).sum()}, params);
+        bool same = true, nonzero = true;
+        for (size_t i = 0; i < params.size(); ++i) {
+            same &= max_abs(subset_grads[i], full_grads[i]) < 1e-8;
+            nonzero &= subset_grads[i].abs().max().item<double>() > 0;
+        }
+        expect(nonzero, label + "gradients flow through the subset");
+        expect(same, label + "subset gradients match the full forward");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#ifndef SMPLX_TEST_UTILS_HPP
+#define SMPLX_TEST_UTILS_HPP
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "smplx.hpp"
+
+// Helpers shared by the test executables: each prints one line per check
+// and returns test::ok ? 0 : 1 from main().
+namespace smplx::test {
+// Whether every check so far passed.
+inline bool ok = true;
+
+inline void expect(bool pass, const std::string &what) {
+    ok &= pass;
+    std::cout << (pass ? "  ✅ " : "  ❌ ") << what << "\n";
+}
+
+inline auto max_abs(const torch::Tensor &a, const torch::Tensor &b) -> double {
+    return (a - b).abs().max().item<double>();
+}
+
+// expect() that a and b differ by at most tol, with the error.
+inline void check(const std::string &name, const torch::Tensor &a,
+                  const torch::Tensor &b, double tol = 1e-9) {
+    const auto err = max_abs(a, b);
+    std::ostringstream what;
+    what << name << " max abs error: " << err;
+    expect(err <= tol, what.str());
+}
+
+// Float64 parameters of rows bodies sharing one set of betas.
+inline auto random_input(int64_t rows, bool return_verts) -> SMPLInput {
+    auto opts = torch::dtype(torch::kFloat64);
+    SMPLInput input;
+    input.betas = torch::randn({1, 10}, opts);
+    input.global_orient = torch::randn({rows, 3}, opts) * 0.3;
+    input.body_pose = torch::randn({rows, 69}, opts) * 0.3;
+    input.transl = torch::randn({rows, 3}, opts);
+    input.return_verts = return_verts;
+    return input;
+}
+} // namespace smplx::test
+#endif
@@ -2,6 +2,7 @@
 
 // #include <torch/extension.h>
 #include <torch/torch.h>
+#include <ATen/Parallel.h>
 #include <queue>
 #include <tuple>
 
@@ -24,12 +25,18 @@ KNearestNeighborIdxCpu(const at::Tensor &p1, const at::Tensor &p2,
     auto idxs_a = idxs.accessor<int64_t, 3>();
     auto dists_a = dists.accessor<float, 3>();
 
-    for (int n = 0; n < N; ++n) {
-        const int64_t length1 = lengths1_a[n];
-        const int64_t length2 = lengths2_a[n];
-        for (int64_t i1 = 0; i1 < length1; ++i1) {
-            // Use a priority queue to store (distance, index) tuples.
-            std::priority_queue<std::tuple<float, int>> q;
+    // Every query point is independent: split the (n, i1) pairs over the
+    // intra-op threads.
+    at::parallel_for(0, int64_t(N) * P1, 16, [&](int64_t begin, int64_t end) {
+        // Use a priority queue to store (distance, index) tuples.
+        std::priority_queue<std::tuple<float, int>> q;
+        for (int64_t item = begin; item < end; ++item) {
+            const int64_t n = item / P1;
+            const int64_t i1 = item % P1;
+            const int64_t length2 = lengths2_a[n];
+            if (i1 >= lengths1_a[n]) {
+                continue;
+            }
             for (int64_t i2 = 0; i2 < length2; ++i2) {
                 float dist = 0;
                 for (int d = 0; d < D; ++d) {
@@ -52,7 +59,7 @@ KNearestNeighborIdxCpu(const at::Tensor &p1, const at::Tensor &p2,
                 idxs_a[n][i1][k] = std::get<1>(t);
             }
         }
-    }
+    });
     return std::make_tuple(idxs, dists);
 }
 
@@ -83,21 +90,25 @@ KNearestNeighborBackwardCpu(const at::Tensor &p1, const at::Tensor &p2,
     auto grad_p1_a = grad_p1.accessor<float, 3>();
     auto grad_p2_a = grad_p2.accessor<float, 3>();
 
-    for (int n = 0; n < N; ++n) {
-        const int64_t length1 = lengths1_a[n];
-        int64_t length2 = lengths2_a[n];
-        length2 = (length2 < K) ? length2 : K;
-        for (int64_t i1 = 0; i1 < length1; ++i1) {
-            for (int64_t k = 0; k < length2; ++k) {
-                const int64_t i2 = idxs_a[n][i1][k];
-                for (int64_t d = 0; d < D; ++d) {
-                    const float diff = 2.0f * grad_dists_a[n][i1][k] *
-                                       (p1_a[n][i1][d] - p2_a[n][i2][d]);
-                    grad_p1_a[n][i1][d] += diff;
-                    grad_p2_a[n][i2][d] += -1.0f * diff;
+    // grad_p2 rows are shared by the queries of one cloud, so the clouds
+    // (not the points) are split over the threads.
+    at::parallel_for(0, N, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t n = begin; n < end; ++n) {
+            const int64_t length1 = lengths1_a[n];
+            int64_t length2 = lengths2_a[n];
+            length2 = (length2 < K) ? length2 : K;
+            for (int64_t i1 = 0; i1 < length1; ++i1) {
+                for (int64_t k = 0; k < length2; ++k) {
+                    const int64_t i2 = idxs_a[n][i1][k];
+                    for (int64_t d = 0; d < D; ++d) {
+                        const float diff = 2.0f * grad_dists_a[n][i1][k] *
+                                           (p1_a[n][i1][d] - p2_a[n][i2][d]);
+                        grad_p1_a[n][i1][d] += diff;
+                        grad_p2_a[n][i2][d] += -1.0f * diff;
+                    }
                 }
             }
         }
-    }
+    });
     return std::make_tuple(grad_p1, grad_p2);
 }
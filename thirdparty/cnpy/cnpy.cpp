@@ -11,6 +11,12 @@
 #include<stdint.h>
 #include<stdexcept>
 #include <regex>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <set>
+#include <thread>
 
 char cnpy::BigEndianTest() {
     int x = 1;
@@ -59,7 +65,7 @@ template<> std::vector<char>& cnpy::operator+=(std::vector<char>& lhs, const cha
     return lhs;
 }
 
-void cnpy::parse_npy_header(unsigned char* buffer,size_t& word_size, std::vector<size_t>& shape, bool& fortran_order) {
+void cnpy::parse_npy_header(unsigned char* buffer,size_t& word_size, std::vector<size_t>& shape, bool& fortran_order, char* type_code) {
     //std::string magic_string(buffer,6);
     uint8_t major_version = *reinterpret_cast<uint8_t*>(buffer+6);
     uint8_t minor_version = *reinterpret_cast<uint8_t*>(buffer+7);
@@ -92,6 +98,7 @@ void cnpy::parse_npy_header(unsigned char* buffer,size_t& word_size, std::vector
     loc1 = header.find("descr")+9;
     bool littleEndian = (header[loc1] == '<' || header[loc1] == '|' ? true : false);
     assert(littleEndian);
+    if(type_code) *type_code = header[loc1+1];
 
     //char type = header[loc1+1];
     //assert(type == map_type(T));
@@ -101,7 +108,7 @@ void cnpy::parse_npy_header(unsigned char* buffer,size_t& word_size, std::vector
     word_size = atoi(str_ws.substr(0,loc2).c_str());
 }
 
-void cnpy::parse_npy_header(FILE* fp, size_t& word_size, std::vector<size_t>& shape, bool& fortran_order) {  
+void cnpy::parse_npy_header(FILE* fp, size_t& word_size, std::vector<size_t>& shape, bool& fortran_order, char* type_code) {  
     char buffer[256];
     size_t res = fread(buffer,sizeof(char),11,fp);       
     if(res != 11)
@@ -143,6 +150,7 @@ void cnpy::parse_npy_header(FILE* fp, size_t& word_size, std::vector<size_t>& sh
     loc1 += 9;
     bool littleEndian = (header[loc1] == '<' || header[loc1] == '|' ? true : false);
     assert(littleEndian);
+    if(type_code) *type_code = header[loc1+1];
 
     //char type = header[loc1+1];
     //assert(type == map_type(T));
@@ -179,9 +187,11 @@ cnpy::NpyArray load_the_npy_file(FILE* fp) {
     std::vector<size_t> shape;
     size_t word_size;
     bool fortran_order;
-    cnpy::parse_npy_header(fp,word_size,shape,fortran_order);
+    char type_code;
+    cnpy::parse_npy_header(fp,word_size,shape,fortran_order,&type_code);
 
     cnpy::NpyArray arr(shape, word_size, fortran_order);
+    arr.type_code = type_code;
     size_t nread = fread(arr.data<char>(),1,arr.num_bytes(),fp);
     if(nread != arr.num_bytes())
         throw std::runtime_error("load_the_npy_file: failed fread");
@@ -217,9 +227,11 @@ cnpy::NpyArray load_the_npz_array(FILE* fp, uint32_t compr_bytes, uint32_t uncom
     std::vector<size_t> shape;
     size_t word_size;
     bool fortran_order;
-    cnpy::parse_npy_header(&buffer_uncompr[0],word_size,shape,fortran_order);
+    char type_code;
+    cnpy::parse_npy_header(&buffer_uncompr[0],word_size,shape,fortran_order,&type_code);
 
     cnpy::NpyArray array(shape, word_size, fortran_order);
+    array.type_code = type_code;
 
     size_t offset = uncompr_bytes - array.num_bytes();
     memcpy(array.data<unsigned char>(),&buffer_uncompr[0]+offset,array.num_bytes());
@@ -276,6 +288,223 @@ cnpy::npz_t cnpy::npz_load(std::string fname) {
     return arrays;  
 }
 
+namespace {
+
+struct npz_member {
+    std::string varname;
+    uint16_t compr_method;
+    uint32_t compr_bytes;
+    uint32_t uncompr_bytes;
+    size_t local_header_offset;
+    std::vector<unsigned char> compr;
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+}
+
+//parses the python dict of an npy header (the part after the preamble)
+void parse_npy_dict(const std::string& header, size_t& word_size, std::vector<size_t>& shape, bool& fortran_order, char& type_code) {
+    size_t loc1 = header.find("fortran_order");
+    if (loc1 == std::string::npos)
+        throw std::runtime_error("parse_npy_header: failed to find header keyword: 'fortran_order'");
+    fortran_order = (header.substr(loc1+16,4) == "True" ? true : false);
+
+    loc1 = header.find("(");
+    size_t loc2 = header.find(")");
+    if (loc1 == std::string::npos || loc2 == std::string::npos)
+        throw std::runtime_error("parse_npy_header: failed to find header keyword: '(' or ')'");
+
+    std::regex num_regex("[0-9][0-9]*");
+    std::smatch sm;
+    shape.clear();
+    std::string str_shape = header.substr(loc1+1,loc2-loc1-1);
+    while(std::regex_search(str_shape, sm, num_regex)) {
+        shape.push_back(std::stoul(sm[0].str()));
+        str_shape = sm.suffix().str();
+    }
+
+    loc1 = header.find("descr");
+    if (loc1 == std::string::npos)
+        throw std::runtime_error("parse_npy_header: failed to find header keyword: 'descr'");
+    loc1 += 9;
+    if(header[loc1] != '<' && header[loc1] != '|')
+        throw std::runtime_error("parse_npy_header: big endian arrays are not supported");
+    type_code = header[loc1+1];
+    std::string str_ws = header.substr(loc1+2);
+    word_size = atoi(str_ws.substr(0,str_ws.find("'")).c_str());
+}
+
+//inflates exactly len bytes of the member into dst
+void inflate_some(z_stream& strm, unsigned char* dst, size_t len) {
+    strm.next_out = dst;
+    strm.avail_out = static_cast<uInt>(len);
+    int err = inflate(&strm, Z_SYNC_FLUSH);
+    if((err != Z_OK && err != Z_STREAM_END) || strm.avail_out != 0)
+        throw std::runtime_error("npz_load: corrupted compressed member");
+}
+
+//decodes the npy header, then inflates (or copies) the payload straight into the array buffer
+cnpy::NpyArray decode_npz_member(npz_member& m) {
+    z_stream strm{};
+    bool deflated = m.compr_method != 0;
+    size_t pos = 0; //read position for stored members
+    auto take = [&](unsigned char* dst, size_t len) {
+        if(deflated) { inflate_some(strm, dst, len); return; }
+        if(pos + len > m.compr.size())
+            throw std::runtime_error("npz_load: truncated member "+m.varname);
+        memcpy(dst, &m.compr[pos], len);
+        pos += len;
+    };
+
+    if(deflated) {
+        if(inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+            throw std::runtime_error("npz_load: inflateInit2 failed");
+        strm.next_in = m.compr.data();
+        strm.avail_in = m.compr_bytes;
+    }
+
+    try {
+        unsigned char preamble[12];
+        take(preamble, 10);
+        size_t header_len;
+        if(preamble[6] == 1) {
+            header_len = *reinterpret_cast<uint16_t*>(preamble+8);
+        } else {
+            take(preamble+10, 2);
+            header_len = *reinterpret_cast<uint32_t*>(preamble+8);
+        }
+        std::string header(header_len, ' ');
+        take(reinterpret_cast<unsigned char*>(&header[0]), header_len);
+
+        std::vector<size_t> shape;
+        size_t word_size;
+        bool fortran_order;
+        char type_code;
+        parse_npy_dict(header, word_size, shape, fortran_order, type_code);
+
+        cnpy::NpyArray array(shape, word_size, fortran_order);
+        array.type_code = type_code;
+        if(array.num_bytes() > 0) take(array.data<unsigned char>(), array.num_bytes());
+        if(deflated) inflateEnd(&strm);
+        //the compressed bytes are no longer needed
+        std::vector<unsigned char>().swap(m.compr);
+        return array;
+    } catch(...) {
+        if(deflated) inflateEnd(&strm);
+        throw;
+    }
+}
+
+} // namespace
+
+cnpy::npz_t cnpy::npz_load_selected(std::string fname, const std::vector<std::string>& varnames, unsigned num_threads, npz_load_timings* timings) {
+    auto start = std::chrono::steady_clock::now();
+    FILE* fp = fopen(fname.c_str(),"rb");
+    if(!fp) throw std::runtime_error("npz_load: Unable to open file "+fname);
+
+    std::vector<npz_member> members;
+    npz_load_timings t;
+    try {
+        //central directory: one 46 byte record + name + extra + comment per member
+        uint16_t nrecs;
+        size_t global_header_size, global_header_offset;
+        parse_zip_footer(fp,nrecs,global_header_size,global_header_offset);
+        std::vector<unsigned char> global_header(global_header_size);
+        fseek(fp,global_header_offset,SEEK_SET);
+        if(fread(global_header.data(),1,global_header_size,fp) != global_header_size)
+            throw std::runtime_error("npz_load: failed fread");
+
+        std::set<std::string> wanted(varnames.begin(), varnames.end());
+        const bool load_all = varnames.empty();
+        size_t pos = 0;
+        for(uint16_t i = 0; i < nrecs; i++) {
+            if(pos + 46 > global_header_size || global_header[pos] != 'P' || global_header[pos+1] != 'K' || global_header[pos+2] != 0x01 || global_header[pos+3] != 0x02)
+                throw std::runtime_error("npz_load: corrupted central directory in "+fname);
+            const unsigned char* rec = &global_header[pos];
+            uint16_t name_len = *(uint16_t*)(rec+28);
+            uint16_t extra_len = *(uint16_t*)(rec+30);
+            uint16_t comment_len = *(uint16_t*)(rec+32);
+
+            npz_member m;
+            m.varname.assign(reinterpret_cast<const char*>(rec+46), name_len);
+            if(m.varname.size() > 4 && m.varname.compare(m.varname.size()-4,4,".npy") == 0)
+                m.varname.erase(m.varname.size()-4);
+            m.compr_method = *(uint16_t*)(rec+10);
+            m.compr_bytes = *(uint32_t*)(rec+20);
+            m.uncompr_bytes = *(uint32_t*)(rec+24);
+            m.local_header_offset = *(uint32_t*)(rec+42);
+            pos += 46 + name_len + extra_len + comment_len;
+
+            if(m.compr_method != 0 && m.compr_method != 8)
+                throw std::runtime_error("npz_load: unsupported compression method for "+m.varname);
+            if(load_all || wanted.erase(m.varname)) members.push_back(std::move(m));
+        }
+        if(!wanted.empty())
+            throw std::runtime_error("npz_load: Variable name "+*wanted.begin()+" not found in "+fname);
+        t.directory_ms = elapsed_ms(start);
+
+        //read the selected members in file order, skipping everything else
+        auto read_start = std::chrono::steady_clock::now();
+        std::sort(members.begin(), members.end(), [](const npz_member& a, const npz_member& b) {
+            return a.local_header_offset < b.local_header_offset;
+        });
+        for(auto& m : members) {
+            unsigned char local_header[30];
+            fseek(fp,m.local_header_offset,SEEK_SET);
+            if(fread(local_header,1,30,fp) != 30)
+                throw std::runtime_error("npz_load: failed fread");
+            uint16_t name_len = *(uint16_t*)(local_header+26);
+            uint16_t extra_len = *(uint16_t*)(local_header+28);
+            fseek(fp,name_len+extra_len,SEEK_CUR);
+            m.compr.resize(m.compr_bytes);
+            if(fread(m.compr.data(),1,m.compr_bytes,fp) != m.compr_bytes)
+                throw std::runtime_error("npz_load: failed fread");
+            t.compressed_bytes += m.compr_bytes;
+            t.uncompressed_bytes += m.uncompr_bytes;
+        }
+        t.read_ms = elapsed_ms(read_start);
+    } catch(...) {
+        fclose(fp);
+        throw;
+    }
+    fclose(fp);
+
+    //inflate concurrently, largest members first so they do not end up last on one thread
+    auto inflate_start = std::chrono::steady_clock::now();
+    std::vector<size_t> order(members.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return members[a].uncompr_bytes > members[b].uncompr_bytes;
+    });
+    std::vector<NpyArray> arrays(members.size());
+    std::vector<std::exception_ptr> errors(members.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for(size_t k = next++; k < order.size(); k = next++) {
+            size_t i = order[k];
+            try { arrays[i] = decode_npz_member(members[i]); }
+            catch(...) { errors[i] = std::current_exception(); }
+        }
+    };
+
+    if(num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min<unsigned>(num_threads, members.size());
+    std::vector<std::thread> pool;
+    for(unsigned i = 1; i < num_threads; i++) pool.emplace_back(worker);
+    worker();
+    for(auto& th : pool) th.join();
+    for(auto& e : errors) if(e) std::rethrow_exception(e);
+    t.inflate_ms = elapsed_ms(inflate_start);
+
+    npz_t result;
+    for(size_t i = 0; i < members.size(); i++) result[members[i].varname] = std::move(arrays[i]);
+    t.num_arrays = members.size();
+    t.total_ms = elapsed_ms(start);
+    if(timings) *timings = t;
+    return result;
+}
+
 cnpy::NpyArray cnpy::npz_load(std::string fname, std::string varname) {
     FILE* fp = fopen(fname.c_str(),"rb");
 
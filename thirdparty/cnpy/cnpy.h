@@ -33,6 +33,9 @@ namespace cnpy {
 
         NpyArray() : shape(0), word_size(0), fortran_order(0), num_vals(0) { }
 
+        //numpy kind of the stored elements ('f', 'i', 'u', 'b', 'c' or '?' if unknown)
+        char type_code = '?';
+
         template<typename T>
         T* data() {
             return reinterpret_cast<T*>(&(*data_holder)[0]);
@@ -62,13 +65,28 @@ namespace cnpy {
    
     using npz_t = std::map<std::string, NpyArray>; 
 
+    //wall-clock time (milliseconds) spent in each phase of the selective npz_load
+    struct npz_load_timings {
+        double directory_ms = 0;  //footer + central directory parsing
+        double read_ms = 0;       //reading the compressed members from disk
+        double inflate_ms = 0;    //parallel decompression into the arrays
+        double total_ms = 0;
+        size_t num_arrays = 0;
+        size_t compressed_bytes = 0;
+        size_t uncompressed_bytes = 0;
+    };
+
     char BigEndianTest();
     char map_type(const std::type_info& t);
     template<typename T> std::vector<char> create_npy_header(const std::vector<size_t>& shape);
-    void parse_npy_header(FILE* fp,size_t& word_size, std::vector<size_t>& shape, bool& fortran_order);
-    void parse_npy_header(unsigned char* buffer,size_t& word_size, std::vector<size_t>& shape, bool& fortran_order);
+    void parse_npy_header(FILE* fp,size_t& word_size, std::vector<size_t>& shape, bool& fortran_order, char* type_code = nullptr);
+    void parse_npy_header(unsigned char* buffer,size_t& word_size, std::vector<size_t>& shape, bool& fortran_order, char* type_code = nullptr);
     void parse_zip_footer(FILE* fp, uint16_t& nrecs, size_t& global_header_size, size_t& global_header_offset);
     npz_t npz_load(std::string fname);
+    //like npz_load, but loads only the members listed in varnames (all of them if empty). the central directory is
+    //read first, then the members are inflated concurrently on num_threads threads (0 = one per
+    //core) straight into the NpyArray buffers.
+    npz_t npz_load_selected(std::string fname, const std::vector<std::string>& varnames, unsigned num_threads = 0, npz_load_timings* timings = nullptr);
     NpyArray npz_load(std::string fname, std::string varname);
     NpyArray npy_load(std::string fname);
 